@@ -1,17 +1,19 @@
 #include "accel.h"
 
+#include <cstdio>
+
 #include <pigpiod_if2.h>
 
+#include "timebase.h"
 #include "util.h"
 
 namespace accel {
 namespace {
 // Connection Handles
-int pi = -1;
-int i2c = -1;
+int i2c = -1;  // i2c_bus handle
 
 // Connection Constants
-const uint8_t kBus = 1;
+i2c_bus::Bus bus = i2c_bus::I2C1;
 const uint8_t kAddr = 0x18;  // NOTE: can be changed to 0x19 if needed
 
 // LIS3DH Read Registers
@@ -39,88 +41,137 @@ const uint8_t kRamAddrCtrlReg4 = 0x23;
 //  TEMP_EN: Temperature Enable (NOTE: Runs on 3rd ADC Channel)
 const uint8_t kRamAddrTempCfgReg = 0x1F;
 
+// Circuit breaker state
+health::Health device_health;
+
+// Writes the device configuration, returns false if the write failed
+bool configure() {
+  const uint8_t config[][2] = {
+    // Set speed to 50Hz and enable all axes
+    {kRamAddrCtrlReg1, 0x47},
+    // Enable Block Update, High Res, and set range to +/- 4
+    {kRamAddrCtrlReg4, 0x98},
+    // Enable Temp and ADC
+    {kRamAddrTempCfgReg, 0xC0},
+  };
+
+  // All three register writes go out as one daemon call
+  i2c_bus::Transfer transfer;
+  transfer.device = i2c;
+  transfer.num_segs = 3;
+  for (int i = 0; i < 3; ++i)
+    transfer.segs[i] = {config[i], 2, nullptr, 0};
+
+  return i2c_bus::run(transfer) >= 0;
+}
+
+// Runs a read behind the circuit breaker. A down device is reconfigured as
+// part of its re-probe, since a reconnected LIS3DH powers up with defaults.
+// Failures are only reported when the device goes down or comes back.
+template <typename Read>
+Status guarded(Read read) {
+  uint64_t now = timebase::now_ns();
+  if (!health::should_try(device_health, now))
+    return DEVICE_DOWN;
+
+  Status stat;
+  if (device_health.state == health::DOWN && !configure())
+    stat = DEVICE_DOWN;
+  else
+    stat = read();
+
+  if (health::record(device_health, stat == OK, now)) {
+    if (stat == OK)
+      fprintf(stderr, "\n[%s:%d] Accelerometer recovered\n", __FILE__,
+          __LINE__);
+    else
+      fprintf(stderr, "\n[%s:%d] Error: Accelerometer down after %u failed "
+          "reads (status %d)\n", __FILE__, __LINE__, health::kMaxFailures,
+          stat);
+  }
+
+  return stat;
+}
+
 // Internal I2C Repeated Start read 16-bit words access
 Status i2c_repeated_read_words(uint16_t *buf, uint8_t num_words,
     uint8_t start_addr) {
-  print_assert("Attempting to read from device without a connection to the "
-      "pigpio daemon", pi >= 0);
   print_assert("Attempting to read from device without an I2C connection",
       i2c >= 0);
 
-  char i2c_cmd[] = {
-    0x3,                            // Turn repeated start on
-    0x7, 0x1,                       // Write 1 byte
-    (char) (0x80 | start_addr),     // MSB inidicates multiple read
-    0x6, (char) (num_words << 1),   // Read num_words * 2 bytes
-    0x0                             // End comm
-  };
+  const uint8_t addr = 0x80 | start_addr;  // MSB inidicates multiple read
 
-  int count = assert_success(i2c_zip(pi, i2c, i2c_cmd, sizeof(i2c_cmd),
-        (char *) buf, num_words << 1));
-  print_assert("Wrong number of bytes recieved", count == num_words << 1);
-  if (count != (num_words << 1)) return BAD_RETURN_LENGTH;
+  i2c_bus::Transfer transfer;
+  transfer.device = i2c;
+  transfer.num_segs = 1;
+  // Write 1 byte, then read num_words * 2 bytes
+  transfer.segs[0] = {&addr, 1, (uint8_t *) buf, (unsigned) num_words << 1};
 
-  return OK;
+  return guarded([&]() {
+      // Failures are expected from an unplugged sensor, guarded reports them
+      int count = i2c_bus::run(transfer);
+      if (count != (num_words << 1)) return BAD_RETURN_LENGTH;
+
+      return OK;
+    });
 }
 
 // Internal I2C Repeated Start read byte access
 Status i2c_repeated_read_byte(uint8_t *byte, uint8_t addr) {
-  print_assert("Attempting to read from device without a connection to the "
-      "pigpio daemon", pi >= 0);
   print_assert("Attempting to read from device without an I2C connection",
       i2c >= 0);
 
-  char i2c_cmd[] = {
-    0x2,              // Turn repeated start on
-    0x7, 0x1, addr,   // Write one byte (ram addr)
-    0x6, 0x1,         // Read one byte
-    0x0               // End comm
-  };
+  i2c_bus::Transfer transfer;
+  transfer.device = i2c;
+  transfer.num_segs = 1;
+  transfer.segs[0] = {&addr, 1, byte, 1};  // Write ram addr, read one byte
 
-  int count = assert_success(i2c_zip(pi, i2c, i2c_cmd, sizeof(i2c_cmd),
-        (char *) byte, 1));
-  print_assert("Wrong number of bytes recieved", count == 1);
-  if (count != 1) return BAD_RETURN_LENGTH;
+  return guarded([&]() {
+      int count = i2c_bus::run(transfer);
+      if (count != 1) return BAD_RETURN_LENGTH;
 
-  return OK;
+      return OK;
+    });
 }
 }  // anonymous namespace
 
 void init() {
-  // Only connect if no connection already exists
-  if (pi < 0) {
-    pi = assert_success(pigpio_start(nullptr, nullptr));
-  }
+  i2c_bus::init();
+}
+
+void set_bus(i2c_bus::Bus b) {
+  print_assert("Attempting to move a connected device, call end() first",
+      i2c < 0);
+  bus = b;
 }
 
 void begin() {
-  print_assert("Attempting to connect to i2c without a valid connection to the "
-      "pigpio daemon, must call init() before begin()", pi >= 0);
-  
   if (i2c < 0)
-    i2c = assert_success(i2c_open(pi, kBus, kAddr, 0));
+    i2c = assert_success(i2c_bus::open_device(bus, kAddr));
 
   // Accelerometer Configuration
-  // Set speed to 50Hz and enable all axes
-  assert_success(i2c_write_byte_data(pi, i2c, kRamAddrCtrlReg1, 0x47));
-  // Enable Block Update, High Res, and set range to +/- 4
-  assert_success(i2c_write_byte_data(pi, i2c, kRamAddrCtrlReg4, 0x98));
-  // Enable Temp and ADC
-  assert_success(i2c_write_byte_data(pi, i2c, kRamAddrTempCfgReg, 0xC0));
+  // A missing accelerometer counts as a failed read, and is configured again
+  // when it is re-probed.
+  if (!configure()) {
+    fprintf(stderr, "\n[%s:%d] Error: Failed to configure accelerometer\n",
+        __FILE__, __LINE__);
+    health::record(device_health, false, timebase::now_ns());
+  }
 }
 
 void end() {
   if (i2c >= 0) {
-    i2c_close(pi, i2c);
+    i2c_bus::close_device(i2c);
     i2c = -1;
   }
 }
 
 void close() {
-  if (pi >= 0) {
-    pigpio_stop(pi);
-    pi = -1;
-  }
+  i2c_bus::close();
+}
+
+const health::Health &get_health() {
+  return device_health;
 }
 
 AccReading get_acceleration() {
@@ -4,15 +4,22 @@
 #include <cmath>
 #include <cstdint>
 
+#include "health.h"
+#include "i2c_bus.h"
+
 namespace accel {
 // Read Status
 enum Status {
   OK,
   BAD_RETURN_LENGTH,
+  DEVICE_DOWN,    // Skipped, the device failed too often (see get_health)
 };
 
 // Connect to daemon
 void init();
+// Moves the device to another bus (i2c_bus::I2C1 by default).
+// Must be called before begin().
+void set_bus(i2c_bus::Bus bus);
 // Pin setup and I2C configuration etc.
 void begin();
 // Release pins and I2C
@@ -20,6 +27,9 @@ void end();
 // Disconnect from daemon
 void close();
 
+// Health of the device; reads are skipped while it is down until re-probed
+const health::Health &get_health();
+
 // Acceleration readings for all 3 axes
 struct AccReading { double x, y, z; Status stat; };
 AccReading get_acceleration();
@@ -0,0 +1,373 @@
+#include "acquire.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <vector>
+
+#include "calib.h"
+#include "csv.h"
+#include "display.h"
+#include "log_schema.h"
+#include "raw_log.h"
+#include "sensors.h"
+#include "stats.h"
+#include "timebase.h"
+#include "trace.h"
+
+using namespace std;
+using namespace sensors;
+
+namespace acquire {
+namespace {
+const float kCvtWarnTempF = 200;
+const float kLowBatteryVoltage = 11.1;
+const unsigned kMaxFileNum = 9999;
+const char *kFilenameFormat = "%s/RECORD_%04d.%s";
+const char *kExtensions[] = {"csv", "raw"};  // Both share file numbers
+const char *kEdgesFilenameFormat = "%s/RECORD_%04d_edges.csv";
+// Time base of csv logs, raw logs hold theirs in the header
+const char *kTimeFilenameFormat = "%s/RECORD_%04d_time.csv";
+// Dir + prefix + number + extension + null byte.
+const unsigned kFilenameLen = 256;
+// Column types for raw logs, ADC columns are logged as counts, and cached
+// temperatures with when they were read
+const int kColumnTypes[] = {
+  RawLog::kTime,
+  RawLog::kFloat, RawLog::kFloat, RawLog::kFloat,
+  RawLog::kTimedFloat,
+  RawLog::kTimedFloat,
+  calib::R_HAL,
+  calib::RPM_TACH,
+  calib::BATTERY,
+  calib::FR_HAL,
+  calib::FL_HAL,
+  calib::F_BRAKE,
+  calib::R_BRAKE,
+  calib::STEERING,
+  calib::FR_SUS,
+  calib::FL_SUS,
+  calib::RR_SUS,
+  calib::RL_SUS,
+  RawLog::kTimedFloat, RawLog::kTimedFloat, RawLog::kTimedFloat,
+};
+// ADC columns logged when testing, in column order
+const calib::Channel kTestingAdcs[] = {
+  calib::FR_HAL, calib::FL_HAL, calib::F_BRAKE, calib::R_BRAKE,
+  calib::STEERING, calib::FR_SUS, calib::FL_SUS, calib::RR_SUS, calib::RL_SUS,
+};
+
+// Directory logs are numbered in.
+const char *log_dir = "/home/pi/DAQ";
+
+// When set to true, display updates don't happen, and display stays locked.
+atomic<bool> display_locked(false);
+// Told each file number opened or closed.
+function<void(unsigned)> log_change_callback;
+
+// Latest of each Reading, for other threads.
+atomic<float> readings[NUM_READINGS];
+
+// Holds the open log, a Csv, or a RawLog in raw mode.
+unique_ptr<Csv> csv;
+unique_ptr<RawLog> raw_log;
+// When set, logs hold raw ADC counts, converted later by raw2csv.
+bool raw_mode = false;
+// When set, daq switch and brake edges are logged alongside each log.
+bool log_edges = false;
+
+// Testing is true if the last opened log was in testing mode.
+bool testing = false;
+// File_num is the file_num of the last opened log.
+unsigned file_num = 0;
+// Start is the time base of the last opened log, its times count from here.
+timebase::Anchor start;
+// Maps monotonic times onto the logs' clock, unset on a lone or primary node.
+function<uint64_t(uint64_t)> time_map;
+// Whether time_map can be used yet, unset if always
+function<bool()> time_map_ready;
+// Whether the open log is timed through time_map, fixed when it opens
+bool mapped = false;
+
+// Us since the log was opened of a monotonic time, on the log's clock. Times
+// before its start, e.g. a temperature cached before it opened, read 0.
+uint64_t log_time_us(uint64_t mono_ns) {
+  if (mapped)
+    mono_ns = time_map(mono_ns);
+  return mono_ns > start.mono_ns ? (mono_ns - start.mono_ns) / 1000 : 0;
+}
+
+// Writes a value to the open log.
+template <typename T>
+void log_value(const T &value) {
+  if (raw_log)
+    *raw_log << value;
+  else
+    *csv << value;
+}
+
+// Writes a value read apart from the row, e.g. a cached temperature, to the
+// open log. Raw logs keep when it was read.
+void log_timed(float value, uint64_t time_ns) {
+  if (raw_log)
+    *raw_log << RawLog::Value{value, log_time_us(time_ns)};
+  else
+    *csv << value;
+}
+
+// An ADC channel's reading, count is NAN for channels timed from gpio edges.
+// Time is the monotonic time it was read, the middle of its reads.
+struct Sample {
+  calib::Channel ch;
+  float count;
+  float value;
+  uint64_t time_ns;
+};
+
+Sample read_channel(calib::Channel ch) {
+  STATS_SCOPE("adc");
+  uint64_t before = timebase::now_ns();
+  if (edge_timed(ch))
+    return {ch, NAN, edge_value(ch), before};
+
+  float count = adc_count(ch);
+  uint64_t after = timebase::now_ns();
+  return {ch, count, calib::convert(ch, count), before + (after - before) / 2};
+}
+
+// Writes a channel to the open log, raw logs keep the count (with its
+// fraction, if the channel is oversampled).
+void log_channel(const Sample &sample) {
+  if (raw_log && !edge_timed(sample.ch))
+    *raw_log << RawLog::Count{sample.count, log_time_us(sample.time_ns)};
+  else
+    log_value(sample.value);
+}
+
+// Type of a raw log column, edge timed channels are logged as values.
+int column_type(unsigned col) {
+  int type = kColumnTypes[col];
+  if (type >= 0 && edge_timed((calib::Channel) type))
+    return RawLog::kFloat;
+  return type;
+}
+
+void log_line_break() {
+  STATS_SCOPE("log.write");  // Csv flushes each line
+  TRACE_SCOPE("log.flush");
+  if (raw_log)
+    *raw_log << RawLog::LINE_BREAK;
+  else
+    *csv << Csv::LINE_BREAK;
+}
+
+// Opens a log, optionally in testing mode, with next avail file number.
+// Returns the file number used (if greater than kMaxFileNum,
+//  then no file was opened).
+unsigned open_log(bool testing) {
+  struct stat buffer;
+  char filename[kFilenameLen];
+  unsigned file_num;
+
+  // Try generating filenames until the number is available.
+  for (file_num = 0; file_num <= kMaxFileNum; ++file_num) {
+    bool taken = false;
+    for (const char *ext : kExtensions) {
+      snprintf(filename, kFilenameLen, kFilenameFormat, log_dir, file_num,
+          ext);
+
+      // If an error occurs while stat'ing the file, then it doesn't exist.
+      taken = taken || stat(filename, &buffer) != -1;
+    }
+
+    if (!taken)
+      break;
+  }
+
+  // If no file is available, don't open a file.
+  if (file_num > kMaxFileNum)
+    return file_num;
+
+  // A mapped log's time base is on the primary's monotonic clock, which this
+  // node's wall clock doesn't belong with, so its wall time is left unknown
+  start = sensors::time_anchor();
+  mapped = time_map && (!time_map_ready || time_map_ready());
+  if (mapped) {
+    start.mono_ns = time_map(start.mono_ns);
+    start.wall_ns = 0;
+  }
+  snprintf(filename, kFilenameLen, kFilenameFormat, log_dir, file_num,
+      kExtensions[raw_mode]);
+  // If testing, use all headers.
+  // Otherwise, use only the headers up until the testing headers.
+  unsigned num_cols = testing ? kHeadersLen : kTestingStartPos;
+
+  if (raw_mode) {
+    vector<RawLog::Column> columns;
+    for (unsigned i = 0; i < num_cols; ++i)
+      columns.push_back({kCsvHeaders[i], column_type(i)});
+    raw_log.reset(new RawLog(filename, columns, start));
+  } else {
+    csv.reset(new Csv(filename,
+          vector<const char *>(kCsvHeaders, kCsvHeaders + num_cols)));
+
+    char time_filename[kFilenameLen + 5];
+    snprintf(time_filename, sizeof(time_filename), kTimeFilenameFormat,
+        log_dir, file_num);
+    if (!timebase::write_csv(time_filename, start))
+      fprintf(stderr, "Failed to write %s\n", time_filename);
+  }
+
+  if (log_edges) {
+    char edges_filename[kFilenameLen + 6];
+    snprintf(edges_filename, sizeof(edges_filename), kEdgesFilenameFormat,
+        log_dir, file_num);
+    sensors::log_switch_edges(edges_filename, start.tick);
+  }
+
+  if (log_change_callback)
+    log_change_callback(file_num);
+
+  return file_num;
+}
+}  // anonymous namespace
+
+void set_log_dir(const char *dir) {
+  log_dir = dir;
+}
+
+void set_raw_mode(bool raw) {
+  raw_mode = raw;
+}
+
+void set_log_edges(bool edges) {
+  log_edges = edges;
+}
+
+void set_time_map(const function<uint64_t(uint64_t mono_ns)> &map,
+    const function<bool()> &ready) {
+  time_map = map;
+  time_map_ready = ready;
+}
+
+void on_log_change(const function<void(unsigned file_num)> &callback) {
+  log_change_callback = callback;
+}
+
+void lock_display(bool locked) {
+  display_locked = locked;
+}
+
+bool logging() {
+  return csv || raw_log;
+}
+
+float reading(Reading r) {
+  return readings[r].load(memory_order_relaxed);
+}
+
+void close_log() {
+  if (logging()) {
+    csv.reset();
+    raw_log.reset();
+    sensors::log_switch_edges(nullptr);
+    if (log_change_callback)
+      log_change_callback(file_num);
+  }
+}
+
+void loop() {
+  STATS_SCOPE("loop");
+  TRACE_SCOPE("loop");
+  {
+    STATS_SCOPE("ir_temp.poll");
+    TRACE_SCOPE("ir_temp.poll");
+    sensors::poll();
+  }
+
+  // If daq switch is on, and log is not open, open it.
+  if (is_daq() && !logging()) {
+    // If not nan, then testing sensors are attached (store state in testing).
+    file_num = open_log((testing = !isnan(front_right_rotor_temp())));
+  } else if (!is_daq() && logging()) {
+    close_log();
+  }
+
+  // If logging, these values always get logged.
+  if (logging()) {
+    // Rows are timed by their first reading, the accelerometer's
+    tuple<float, float, float> acc_xyz;
+    uint64_t before = timebase::now_ns();
+    {
+      STATS_SCOPE("accel");
+      TRACE_SCOPE("accel");
+      acc_xyz = accelXYZ();
+    }
+    uint64_t after = timebase::now_ns();
+    log_value(log_time_us(before + (after - before) / 2));
+    log_value(get<0>(acc_xyz));
+    log_value(get<1>(acc_xyz));
+    log_value(get<2>(acc_xyz));
+    uint64_t amb_time;
+    float amb = amb_temp(&amb_time);
+    log_timed(amb, amb_time);
+  }
+
+  // Readings for display (also needed for logging).
+  uint64_t cvt_time;
+  float cvt = cvt_temp(&cvt_time);
+  Sample mph = read_channel(calib::R_HAL);
+  Sample rpm = read_channel(calib::RPM_TACH);
+  Sample bat_voltage = read_channel(calib::BATTERY);
+
+  // Only update display when not locked.
+  if (!display_locked) {
+    unsigned status = display::STATUS_NONE;
+    if (cvt >= kCvtWarnTempF)
+      status |= display::WARNING_TEMP;
+    if (bat_voltage.value <= kLowBatteryVoltage)
+      status |= display::WARNING_BATTERY;
+    if (is_brake())
+      status |= display::INFO_BRAKE;
+    if (logging())
+      status |= display::INFO_DATA_LOGGING;
+
+    STATS_SCOPE("display.update");
+    TRACE_SCOPE("display.update");
+    display::update(rpm.value, mph.value, status);
+  }
+
+  // Log display values, and sometimes more
+  if (logging()) {
+    log_timed(cvt, cvt_time);
+    log_channel(mph);
+    log_channel(rpm);
+    log_channel(bat_voltage);
+    if (testing) {
+      for (calib::Channel ch : kTestingAdcs)
+        log_channel(read_channel(ch));
+      uint64_t time;
+      float temp = front_right_rotor_temp(&time);
+      log_timed(temp, time);
+      temp = front_left_rotor_temp(&time);
+      log_timed(temp, time);
+      temp = rear_rotor_temp(&time);
+      log_timed(temp, time);
+    }
+    log_line_break();
+  }
+
+  // Temps are cache reads, the rest were read above
+  const float latest[NUM_READINGS] = {
+    rpm.value, mph.value, cvt, bat_voltage.value, (float) is_brake(),
+    (float) logging(), amb_temp(), front_right_rotor_temp(),
+    front_left_rotor_temp(), rear_rotor_temp(),
+  };
+  for (unsigned i = 0; i < NUM_READINGS; ++i)
+    readings[i].store(latest[i], memory_order_relaxed);
+}
+}  // namespace acquire
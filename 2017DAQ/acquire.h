@@ -0,0 +1,57 @@
+#ifndef ACQUIRE_H_
+#define ACQUIRE_H_
+
+#include <cstdint>
+#include <functional>
+
+// The acquisition loop. Each pass reads the sensors, posts the display, and
+// while the daq switch is on, logs a row to the open log (opening one when
+// the switch goes on, closing it when it goes off).
+//
+// Everything but lock_display runs on the thread calling loop().
+namespace acquire {
+// Directory logs are numbered in, /home/pi/DAQ by default
+void set_log_dir(const char *dir);
+// Logs hold raw ADC counts, converted later by raw2csv (see raw_log.h)
+void set_raw_mode(bool raw);
+// Daq switch and brake light edges are logged alongside each log
+void set_log_edges(bool log_edges);
+// Maps monotonic times onto the clock logs are timed on, a secondary node's
+// onto the primary's (see clock_sync.h). A log only takes the map if ready()
+// is true (or unset) when it opens, and keeps its clock until it closes, so
+// its times never jump to the other clock. Both must be thread safe.
+void set_time_map(const std::function<uint64_t(uint64_t mono_ns)> &map,
+    const std::function<bool()> &ready = nullptr);
+
+// Called with the file number of each log opened or closed. The driver shows
+// it on the display, see lock_display.
+void on_log_change(const std::function<void(unsigned file_num)> &callback);
+// While locked, loop() leaves the display alone. Thread safe.
+void lock_display(bool locked);
+
+// Latest readings, as of the last loop(), for telemetry. NAN for sensors that
+// are down. Thread safe.
+enum Reading {
+  RPM,
+  MPH,
+  CVT_TEMP,         // F
+  BATTERY,          // V
+  BRAKE,            // 1 while braking
+  LOGGING,          // 1 while logging
+  AMB_TEMP,         // F
+  FR_ROTOR_TEMP,    // F, as are the other rotors
+  FL_ROTOR_TEMP,
+  REAR_ROTOR_TEMP,
+  NUM_READINGS,
+};
+float reading(Reading r);
+
+// One pass of acquisition
+void loop();
+// True while a log is open
+bool logging();
+// Closes the log if it's open
+void close_log();
+}  // namespace acquire
+
+#endif  // ACQUIRE_H_
@@ -0,0 +1,154 @@
+#include "acquire.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gpio_capture.h"
+#include "sensors.h"
+#include "sim_devices.h"
+#include "sim_pigpio.h"
+#include "stats.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [seconds per run] [round trip in us]...\n";
+
+const unsigned kFrRotor = 3;  // Index in sim::Car::ir_temps
+
+double cpu_seconds() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+    usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// Runs acquisition until testing mode is (or isn't) detected, with the log
+// closed. The rotor sensor it hinges on is polled every 0.1s, and comes back
+// from its circuit breaker's backoff.
+bool settle(bool testing) {
+  for (int i = 0; i < 100; ++i) {
+    acquire::loop();
+    if (isnan(sensors::front_right_rotor_temp()) != testing)
+      return true;
+    usleep(50000);
+  }
+  return false;
+}
+
+// Logs for seconds with the daq switch on, and prints the run as a line of
+// JSON
+void run(sim::Car &car, double seconds, bool raw, double round_trip_us,
+    const char *dir) {
+  sim::Timing timing;
+  timing.round_trip_us = round_trip_us;
+  sim::set_timing(timing);
+  acquire::set_raw_mode(raw);
+
+  unsigned file_num = 0;
+  acquire::on_log_change([&](unsigned num) { file_num = num; });
+  car.set_daq(true);
+  while (!acquire::logging())
+    acquire::loop();  // Until the reader thread has the switch
+  bool testing = !isnan(sensors::front_right_rotor_temp());
+
+  stats::Histogram loop_ns;
+  unsigned long rows = 0;
+  sim::reset_counters();
+  double cpu_start = cpu_seconds();
+  uint64_t start = stats::now_ns(), now = start;
+  while (now - start < seconds * 1e9) {
+    acquire::loop();
+    uint64_t end = stats::now_ns();
+    loop_ns.record(end - now);
+    now = end;
+    ++rows;
+  }
+  double elapsed = (now - start) / 1e9;
+  double cpu = cpu_seconds() - cpu_start;
+  unsigned long calls = sim::counters().calls;
+
+  car.set_daq(false);
+  while (acquire::logging())
+    acquire::loop();
+
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/RECORD_%04u.%s", dir, file_num,
+      raw ? "raw" : "csv");
+  struct stat st;
+  long bytes = stat(filename, &st) == 0 ? st.st_size : -1;
+  unlink(filename);
+  // Csv logs' time base
+  snprintf(filename, sizeof(filename), "%s/RECORD_%04u_time.csv", dir,
+      file_num);
+  unlink(filename);
+
+  printf("{\"bench\":\"acquire\",\"columns\":%d,\"log\":\"%s\","
+      "\"round_trip_us\":%g,\"seconds\":%.3f,\"rows\":%lu,"
+      "\"rows_per_s\":%.1f,\"bytes_per_s\":%.1f,\"cpu_pct\":%.1f,"
+      "\"loop_p50_us\":%.1f,\"loop_p99_us\":%.1f,\"loop_max_us\":%.1f,"
+      "\"daemon_calls_per_row\":%.2f}\n", testing ? 21 : 9,
+      raw ? "raw" : "csv", round_trip_us, elapsed, rows, rows / elapsed,
+      bytes / elapsed, 100 * cpu / elapsed, loop_ns.quantile(0.5) / 1e3,
+      loop_ns.quantile(0.99) / 1e3, loop_ns.max() / 1e3,
+      (double) calls / rows);
+  fflush(stdout);
+}
+
+// The real acquisition loop, on simulated devices, writing real logs. Prints
+// a line of JSON per run: testing (21 columns) then normal (9 columns)
+// logging, as csv and raw, at each daemon round trip.
+int main(int argc, char **argv) {
+  double seconds = argc > 1 ? strtod(argv[1], nullptr) : 2;
+  vector<double> round_trips;
+  for (int i = 2; i < argc; ++i)
+    round_trips.push_back(strtod(argv[i], nullptr));
+  if (round_trips.empty())
+    round_trips = {0, 50, 150};
+  if (seconds <= 0) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  sim::Car car;
+  for (int cs = 0; cs < 2; ++cs) {
+    for (unsigned ch = 0; ch < 8; ++ch)
+      car.adcs[cs].set_input(ch, 300 + 50 * ch);
+  }
+  car.accel.set_g(0.1, -0.2, 1);
+
+  char dir[] = "/tmp/acquire_bench_XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  acquire::set_log_dir(dir);
+  gpio_capture::set_pipe_format(sim::pipe_path_format());
+  sensors::init();
+  sensors::begin();
+
+  // Testing mode hinges on the front right rotor sensor answering
+  for (bool testing : {true, false}) {
+    if (!testing)
+      car.attach_ir_temp(kFrRotor, false);
+    if (!settle(testing)) {
+      fprintf(stderr, "Rotor sensor never %s\n", testing ? "up" : "down");
+      return 1;
+    }
+    for (double round_trip_us : round_trips) {
+      run(car, seconds, false, round_trip_us, dir);
+      run(car, seconds, true, round_trip_us, dir);
+    }
+  }
+
+  sensors::end();
+  sensors::close();
+  rmdir(dir);
+  return 0;
+}
@@ -2,9 +2,11 @@
 
 #include <cstdio>
 #include <cassert>
+#include <cstdint>
 
 #include <pigpiod_if2.h>
 
+#include "trace.h"
 #include "util.h"
 
 namespace adc {
@@ -73,6 +75,7 @@ int get(ChipSelect cs, char ch) {
   // printf("\nBefore: %02X.%02X.%02X\n", buf[0], buf[1], buf[2]);
 
   // Rest of buf will store answer
+  TRACE_SCOPE("spi_xfer");
   int count = spi_xfer(pi, spi_handle, buf, buf, 3);
   print_assert("SPI tranfser failed", count == 3);
 
@@ -81,8 +84,9 @@ int get(ChipSelect cs, char ch) {
 
   print_assert("Null bit not set by adc!", (buf[1] & 0x4) == 0);
 
-  int result = buf[1] << 8;  // 2 LSB of buf[1] are the 2 MSB of result
-  result |= buf[2];  // buf[2] are 8 LSB of result (total 10 bit)
+  // Unsigned, so a low byte >= 0x80 doesn't sign extend into the MSBs
+  int result = (uint8_t) buf[1] << 8;  // 2 LSB of buf[1] are the 2 MSB
+  result |= (uint8_t) buf[2];  // buf[2] are 8 LSB of result (total 10 bit)
 
   return result & 0x3FF;  // truncate to last 10 bits
 }
@@ -0,0 +1,68 @@
+#include "alloc_hooks.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_hooks {
+namespace {
+thread_local unsigned long thread_allocs = 0;
+std::atomic<unsigned long> total_allocs(0);
+std::atomic<unsigned long> total_alloc_bytes(0);
+
+void *counted(size_t size) {
+  ++thread_allocs;
+  total_allocs.fetch_add(1, std::memory_order_relaxed);
+  total_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+}  // anonymous namespace
+
+unsigned long thread_count() {
+  return thread_allocs;
+}
+
+unsigned long total_count() {
+  return total_allocs.load(std::memory_order_relaxed);
+}
+
+unsigned long total_bytes() {
+  return total_alloc_bytes.load(std::memory_order_relaxed);
+}
+}  // namespace alloc_hooks
+
+// Every other form of new and delete forwards to these
+void *operator new(size_t size) {
+  void *p = alloc_hooks::counted(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return alloc_hooks::counted(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return alloc_hooks::counted(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  free(p);
+}
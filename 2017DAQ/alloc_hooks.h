@@ -0,0 +1,16 @@
+#ifndef ALLOC_HOOKS_H_
+#define ALLOC_HOOKS_H_
+
+// Heap allocation counts, from replacements of the global operator new in
+// alloc_hooks.cpp. Linking alloc_hooks.o is what turns counting on (make
+// ALLOCS=1 links it into the driver). Counting is a thread-local increment
+// and a relaxed atomic add per allocation.
+namespace alloc_hooks {
+// Allocations made by the calling thread
+unsigned long thread_count();
+// Allocations made by every thread, and their bytes
+unsigned long total_count();
+unsigned long total_bytes();
+}  // namespace alloc_hooks
+
+#endif  // ALLOC_HOOKS_H_
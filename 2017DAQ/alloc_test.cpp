@@ -0,0 +1,91 @@
+#include "alloc_hooks.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+#include "acquire.h"
+#include "gpio_capture.h"
+#include "sensors.h"
+#include "sim_devices.h"
+#include "sim_pigpio.h"
+#include "test.h"
+
+using namespace std;
+
+const int kWarmupLoops = 200;
+const int kCountedLoops = 2000;
+const unsigned kFrRotor = 3;  // Index in sim::Car::ir_temps
+
+// Allocations by the calling thread, and every thread, over kCountedLoops
+// acquisition loops after kWarmupLoops, which must be none. Doesn't need the
+// daemon.
+void check(const char *name) {
+  for (int i = 0; i < kWarmupLoops; ++i)
+    acquire::loop();
+
+  unsigned long thread_start = alloc_hooks::thread_count();
+  unsigned long total_start = alloc_hooks::total_count();
+  for (int i = 0; i < kCountedLoops; ++i)
+    acquire::loop();
+  unsigned long thread_allocs = alloc_hooks::thread_count() - thread_start;
+  unsigned long total_allocs = alloc_hooks::total_count() - total_start;
+
+  printf("  %lu allocations in the loop, %lu in all threads\n", thread_allocs,
+      total_allocs);
+  test::check((string("No allocations ") + name).c_str(),
+      thread_allocs == 0 && total_allocs == 0);
+}
+
+// Runs with the daq switch on, once the log is open. Opening it allocates,
+// which shows the hooks are linked.
+void check_logging(sim::Car &car, const char *name, bool raw) {
+  acquire::set_raw_mode(raw);
+  car.set_daq(true);
+  unsigned long open_start = alloc_hooks::thread_count();
+  while (!acquire::logging())
+    acquire::loop();
+  if (test::check((string("Hooks count opening a ") + name + " log").c_str(),
+          alloc_hooks::thread_count() != open_start))
+    check(name);
+  car.set_daq(false);
+  while (acquire::logging())
+    acquire::loop();
+}
+
+int main(int argc, char **argv) {
+  sim::Car car;
+
+  char dir[] = "/tmp/alloc_test_XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  acquire::set_log_dir(dir);
+  gpio_capture::set_pipe_format(sim::pipe_path_format());
+  sensors::init();
+  sensors::begin();
+
+  // Testing mode comes from the front right rotor sensor answering
+  while (isnan(sensors::front_right_rotor_temp()))
+    acquire::loop();
+
+  check("idle");
+  check_logging(car, "testing csv", false);
+  check_logging(car, "testing raw", true);
+
+  car.attach_ir_temp(kFrRotor, false);
+  while (!isnan(sensors::front_right_rotor_temp()))
+    acquire::loop();
+  check_logging(car, "normal csv", false);
+  check_logging(car, "normal raw", true);
+
+  sensors::end();
+  sensors::close();
+  system((string("rm -rf ") + dir).c_str());
+
+  return test::result();
+}
@@ -0,0 +1,110 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "stats.h"
+
+// Microbenchmark harness. bench::run times an op in batches sized to take
+// about kSampleNs each, and keeps sampling until the samples settle: their
+// median absolute deviation within kStableSpread of the median, or
+// kMaxSamples. It reports the median ns/op, which a preempted batch or two
+// doesn't move, so runs on the Pi and on a desktop compare run to run.
+namespace bench {
+const uint64_t kSampleNs = 2000000;
+const unsigned kMinSamples = 15;
+const unsigned kMaxSamples = 101;
+const double kStableSpread = 0.02;
+
+// Keeps value (and whatever computed it) from being optimized out
+template <typename T>
+inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Makes value opaque to the optimizer, so ops on it aren't folded away
+template <typename T>
+inline void hide(T &value) {
+  asm volatile("" : "+m"(value));
+}
+
+struct Result {
+  double median_ns;  // Per op
+  double min_ns;
+  double spread;     // Median absolute deviation over median
+  unsigned samples;
+  bool stable;
+};
+
+// Only benches whose name contains this run, all if null
+inline const char *&filter() {
+  static const char *filter = nullptr;
+  return filter;
+}
+
+inline double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Times op (one op per call) and prints its line. Returns a zeroed result if
+// name doesn't match the filter.
+template <typename Op>
+Result run(const char *name, Op op) {
+  Result result = {};
+  if (filter() && !strstr(name, filter()))
+    return result;
+
+  // Grows the batch until it takes a good part of a sample, then scales it
+  // up to one (this also warms up caches and the branch predictor)
+  uint64_t batch = 1;
+  for (;;) {
+    uint64_t start = stats::now_ns();
+    for (uint64_t i = 0; i < batch; ++i)
+      op();
+    uint64_t elapsed = stats::now_ns() - start;
+    if (elapsed >= kSampleNs / 8) {
+      batch = std::max<uint64_t>(1, batch * kSampleNs / elapsed);
+      break;
+    }
+    batch *= 2;
+  }
+
+  std::vector<double> samples, deviations;
+  double med = 0;
+  while (samples.size() < kMaxSamples) {
+    uint64_t start = stats::now_ns();
+    for (uint64_t i = 0; i < batch; ++i)
+      op();
+    samples.push_back((double) (stats::now_ns() - start) / batch);
+
+    if (samples.size() < kMinSamples)
+      continue;
+    med = median(samples);
+    deviations.clear();
+    for (double s : samples)
+      deviations.push_back(std::fabs(s - med));
+    result.spread = med > 0 ? median(deviations) / med : 0;
+    if (result.spread <= kStableSpread)
+      break;
+  }
+
+  result.median_ns = med;
+  result.min_ns = *std::min_element(samples.begin(), samples.end());
+  result.samples = samples.size();
+  result.stable = result.spread <= kStableSpread;
+
+  printf("%-32s %10.2f ns/op  min %10.2f  +/-%4.1f%%  %3u samples%s\n", name,
+      result.median_ns, result.min_ns, result.spread * 100, result.samples,
+      result.stable ? "" : "  UNSTABLE");
+  return result;
+}
+}  // namespace bench
+
+#endif  // BENCH_H_
@@ -0,0 +1,144 @@
+#include "calib.h"
+
+#include <cmath>
+
+#include "util.h"
+
+namespace calib {
+namespace {
+const float kPi = atan(1) * 4;
+
+Params params[] = {
+  // FL_HAL, FR_HAL
+  // Min and Max based on freq2voltage reading range, drive train mph/hz
+  {HAL, {0, 5000, 1/6.81}},
+  {HAL, {0, 5000, 1/6.81}},
+  // F_BRAKE, R_BRAKE
+  // Pressure in psi, 0.5V to 4.5V readout
+  {LINEAR, {0, 2000, 0.5 * 1023, 4.5 * 1023}},
+  {LINEAR, {0, 2000, 0.5 * 1023, 4.5 * 1023}},
+  // STEERING
+  // Wheel angle in degrees over the pot's full range
+  {LINEAR, {-90, 90, 0, 1023}},
+  // FL_SUS, FR_SUS
+  // Suspension travel in inches, phi is offset of the pot's 0 position from
+  // the nearest support side
+  {SUSPENSION, {10, 7, (float) 2/3 * kPi}},
+  {SUSPENSION, {10, 7, (float) 2/3 * kPi}},
+  // N.C.
+  {NONE, {}},
+  // R_HAL
+  {HAL, {0, 5000, 1/6.81}},
+  // RPM_TACH
+  // Min and Max based on freq2voltage reading range, not expected output.
+  {LINEAR, {0, 3800, 0, 1023}},
+  // RL_SUS, RR_SUS
+  {SUSPENSION, {10, 7, (float) 2/3 * kPi}},
+  {SUSPENSION, {10, 7, (float) 2/3 * kPi}},
+  // BATTERY
+  // Charged voltage at max readout
+  {LINEAR, {0, 12.5, 0, 976}},
+};
+
+// Gets the suspension travel in the length units of a and b. Phi must be in
+// radians.
+//
+// a is one of the support sides of the suspension.
+// b is one of the support sides of the suspension.
+// phi is the angle offset of the 0 position of the potentiometer from the
+//     nearest support side.
+float sus_travel(int count, float a, float b, float phi) {
+  float theta = util::clamp((float) 0, (float) kPi/3, (float) 0, (float) 1023,
+      (float) count);
+  float travel_sq = a*a + b*b - 2*a*b*std::cos(theta + phi);
+
+  // Outside of sqrt's domain
+  if (travel_sq < 0)
+    return NAN;
+
+  return std::sqrt(travel_sq);
+}
+
+// Converts a hal reading to mph based on the min_hz and max_hz the specified
+// freq2voltage converter can read, and the drive train ratio.
+//
+// min_hz the minimum frequency reading of the freq2voltage converter
+// max_hz the maximum frequency reading of the freq2voltage converter
+// dt_ratio the drive train ratio (mph/hz).
+float hal_to_mph(int count, float min_hz, float max_hz, float dt_ratio) {
+  float freq = util::clamp(min_hz, max_hz, (float) 0, (float) 1023,
+      (float) count);
+  return freq * dt_ratio;
+}
+}  // anonymous namespace
+
+float tables[NUM_CHANNELS][kNumCounts];
+
+float evaluate(const Params &params, int count) {
+  const float *p = params.p;
+
+  switch (params.kind) {
+    case LINEAR:
+      return util::clamp(p[0], p[1], p[2], p[3], (float) count);
+    case HAL:
+      return hal_to_mph(count, p[0], p[1], p[2]);
+    case SUSPENSION:
+      return sus_travel(count, p[0], p[1], p[2]);
+    case NONE:
+    default:
+      return NAN;
+  }
+}
+
+void build(const Params &params, float *table) {
+  for (int count = 0; count < kNumCounts; ++count)
+    table[count] = evaluate(params, count);
+}
+
+void init() {
+  for (int ch = 0; ch < NUM_CHANNELS; ++ch)
+    build(params[ch], tables[ch]);
+}
+
+const Params &get_params(Channel ch) {
+  return params[(int) ch];
+}
+
+float mph_per_hz(Channel ch) {
+  const Params &p = params[(int) ch];
+  return p.kind == HAL ? p.p[2] : NAN;
+}
+
+void set_params(Channel ch, const Params &p) {
+  params[(int) ch] = p;
+  build(p, tables[(int) ch]);
+}
+
+float convert(Channel ch, float count) {
+  const float *table = tables[(int) ch];
+  if (std::isnan(count))
+    return NAN;
+  if (count <= 0)
+    return table[0];
+  if (count >= kNumCounts - 1)
+    return table[kNumCounts - 1];
+
+  int i = (int) count;
+  float frac = count - i;
+  // Whole counts are exact, even next to a NAN entry
+  if (frac == 0)
+    return table[i];
+  return table[i] + frac * (table[i + 1] - table[i]);
+}
+
+void convert(Channel ch, const uint16_t *raw, float *out, size_t n) {
+  const float *table = tables[(int) ch];
+  for (size_t i = 0; i < n; ++i)
+    out[i] = table[raw[i] & (kNumCounts - 1)];
+}
+
+void convert(const uint16_t *raw, float *out) {
+  for (int ch = 0; ch < NUM_CHANNELS; ++ch)
+    out[ch] = tables[ch][raw[ch] & (kNumCounts - 1)];
+}
+}  // namespace calib
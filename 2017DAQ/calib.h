@@ -0,0 +1,83 @@
+#ifndef CALIB_H_
+#define CALIB_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Calibrations from raw 10-bit ADC counts to engineering units.
+// Each channel's calibration is precomputed into a table with an entry per
+// count, so converting a sample is a single load. NAN marks counts outside a
+// calibration's domain.
+namespace calib {
+// Enum mapping names to chip and channel values. 4th-bit is chip.
+enum Channel : char {
+  // Front Dongle
+  FL_HAL    = 0x0,  // CE0, C0
+  FR_HAL    = 0x1,  // CE0, C1
+  F_BRAKE   = 0x2,  // CE0, C2
+  R_BRAKE   = 0x3,  // CE0, C3
+  STEERING  = 0x4,  // CE0, C4
+  FL_SUS    = 0x5,  // CE0, C5
+  FR_SUS    = 0x6,  // CE0, C6
+  // N.C.              CE0, C7
+  // Rear Dongle
+  R_HAL     = 0x8,  // CE1, C0
+  RPM_TACH  = 0x9,  // CE1, C1
+  RL_SUS    = 0xA,  // CE1, C2
+  RR_SUS    = 0xB,  // CE1, C3
+  BATTERY   = 0xC,  // CE1, C4
+  // N.C.              CE2, C5-7
+  NUM_CHANNELS,     // Must be last, channels are indices up to here
+};
+
+const int kNumCounts = 1024;  // 10-bit ADC
+
+// Forms of calibration
+enum Kind {
+  NONE,        // Not connected, every count is NAN
+  LINEAR,      // p = {new_min, new_max, min, max}, see util::clamp
+  HAL,         // p = {min_hz, max_hz, dt_ratio (mph/hz)} of a freq2voltage
+  SUSPENSION,  // p = {side a, side b, phi (radians)} of the linkage
+};
+
+struct Params {
+  Kind kind;
+  float p[4];
+};
+
+// Engineering value of a count, computed from the calibration's formula.
+// This is what the tables hold.
+float evaluate(const Params &params, int count);
+
+// Fills table (kNumCounts entries) with every count's value for params
+void build(const Params &params, float *table);
+
+// Builds every channel's table, call once before converting
+void init();
+
+// Calibration of a channel. set_params rebuilds the channel's table.
+const Params &get_params(Channel ch);
+void set_params(Channel ch, const Params &params);
+// Drive train ratio (mph/hz) of a HAL channel, NAN for other kinds
+float mph_per_hz(Channel ch);
+
+// Tables built by init(), use convert() to read them
+extern float tables[NUM_CHANNELS][kNumCounts];
+
+// Converts a count of a channel
+inline float convert(Channel ch, int count) {
+  return tables[(int) ch][count & (kNumCounts - 1)];
+}
+
+// Converts a fractional count, e.g. an average from decimate::read, by
+// interpolating between the table entries around it. NAN for a NAN count.
+float convert(Channel ch, float count);
+
+// Converts n counts from one channel
+void convert(Channel ch, const uint16_t *raw, float *out, size_t n);
+
+// Converts a count from every channel, raw and out are indexed by Channel
+void convert(const uint16_t *raw, float *out);
+}  // namespace calib
+
+#endif  // CALIB_H_
@@ -0,0 +1,130 @@
+#include "calib.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "util.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [repeats]\n";
+
+const float kPi = atan(1) * 4;
+
+// The conversions as sensors.cpp computed them on every call before the
+// tables, kept here as the baseline.
+float sus_travel(int count, float a, float b, float phi) {
+  errno = 0;  // For sqrt domain check
+
+  float theta = util::clamp((float) 0, (float) kPi/3, (float) 0, (float) 1023,
+      count);
+  float travel = sqrt(a*a + b*b - 2*a*b*cos(theta + phi));
+
+  if (errno == EDOM)
+    return NAN;
+
+  return travel;
+}
+
+float hal_to_mph(int count, int min_hz, int max_hz, float dt_ratio) {
+  float freq = util::clamp((float) min_hz, (float) max_hz, (float) 0,
+      (float) 1023, count);
+  return freq * dt_ratio;
+}
+
+float baseline(calib::Channel ch, int count) {
+  switch (ch) {
+    case calib::FL_HAL:
+    case calib::FR_HAL:
+    case calib::R_HAL:
+      return hal_to_mph(count, 0, 5000, 1/6.81);
+    case calib::F_BRAKE:
+    case calib::R_BRAKE:
+      return util::clamp(0, 2000, (float) (0.5 * 1023), (float) (4.5 * 1023),
+          count);
+    case calib::STEERING:
+      return util::clamp((float) -90, (float) 90, (float) 0, (float) 1023,
+          count);
+    case calib::FL_SUS:
+    case calib::FR_SUS:
+    case calib::RL_SUS:
+    case calib::RR_SUS:
+      return sus_travel(count, 10, 7, (float) 2/3 * kPi);
+    case calib::RPM_TACH:
+      return util::clamp((float) 0, (float) 3800, 0, 1023, count);
+    case calib::BATTERY:
+      return util::clamp(0, (float) 12.5, 0, (float) 976, count);
+    default:
+      return NAN;
+  }
+}
+
+double now_ns() {
+  return chrono::duration<double, nano>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    printf(usage, *argv);
+    return -1;
+  }
+  int repeats = argc > 1 ? atoi(argv[1]) : 200;
+
+  calib::init();
+
+  // Tables must hold exactly what the old per-call math returned
+  for (int ch = 0; ch < calib::NUM_CHANNELS; ++ch) {
+    for (int count = 0; count < calib::kNumCounts; ++count) {
+      float want = baseline((calib::Channel) ch, count);
+      float got = calib::convert((calib::Channel) ch, count);
+      if (!(want == got || (isnan(want) && isnan(got)))) {
+        fprintf(stderr, "Channel %d count %d: table %f, formula %f\n", ch,
+            count, got, want);
+        return 1;
+      }
+    }
+  }
+
+  // One row of pseudo random counts per loop, for every channel
+  const int kRows = 4096;
+  static uint16_t raw[kRows][calib::NUM_CHANNELS];
+  static float out[kRows][calib::NUM_CHANNELS];
+  srand(1);
+  for (auto &row : raw)
+    for (auto &count : row)
+      count = rand() % calib::kNumCounts;
+
+  const long samples = (long) repeats * kRows * calib::NUM_CHANNELS;
+  volatile float sink = 0;
+
+  double start = now_ns();
+  for (int r = 0; r < repeats; ++r)
+    for (int i = 0; i < kRows; ++i)
+      for (int ch = 0; ch < calib::NUM_CHANNELS; ++ch)
+        sink = sink + baseline((calib::Channel) ch, raw[i][ch]);
+  double formula_ns = (now_ns() - start) / samples;
+
+  start = now_ns();
+  for (int r = 0; r < repeats; ++r)
+    for (int i = 0; i < kRows; ++i)
+      for (int ch = 0; ch < calib::NUM_CHANNELS; ++ch)
+        sink = sink + calib::convert((calib::Channel) ch, raw[i][ch]);
+  double table_ns = (now_ns() - start) / samples;
+
+  start = now_ns();
+  for (int r = 0; r < repeats; ++r)
+    for (int i = 0; i < kRows; ++i)
+      calib::convert(raw[i], out[i]);
+  double batch_ns = (now_ns() - start) / samples;
+  sink = sink + out[kRows - 1][0];
+
+  printf("Per sample: formula %6.2f ns, table %6.2f ns, batch %6.2f ns "
+      "(%.1fx)\n", formula_ns, table_ns, batch_ns, formula_ns / batch_ns);
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "can_telemetry.h"
+#include "timebase.h"
+
+using namespace std;
+using namespace can_telemetry;
+
+const char *usage =
+  "Usage: %s [-m map] [-n frames] interface\n"
+  "  -m  decode with this ID map instead of the driver's default\n"
+  "  -n  exit after this many frames\n"
+  "Prints a line per frame: seconds since start, id and each signal.\n"
+  "To test without hardware:\n"
+  "  sudo modprobe vcan && sudo ip link add dev vcan0 type vcan &&\n"
+  "  sudo ip link set up vcan0\n";
+
+int main(int argc, char **argv) {
+  vector<Message> map = default_map();
+  long max_frames = -1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "m:n:")) != -1) {
+    switch (opt) {
+      case 'm': {
+        ifstream in(optarg);
+        string error;
+        if (!in) {
+          fprintf(stderr, "Failed to open %s\n", optarg);
+          return -1;
+        }
+        if (!parse_map(in, map, error)) {
+          fprintf(stderr, "Bad map line: %s\n", error.c_str());
+          return -1;
+        }
+        break;
+      }
+      case 'n':
+        max_frames = atol(optarg);
+        break;
+      default:
+        printf(usage, *argv);
+        return -1;
+    }
+  }
+  if (optind != argc - 1) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  int fd = open_socket(argv[optind]);
+  if (fd < 0) {
+    perror(argv[optind]);
+    return -1;
+  }
+
+  uint64_t start = timebase::now_ns();
+  can_frame frame;
+  float values[kMaxSignals];
+  for (long frames = 0; max_frames < 0 || frames < max_frames; ++frames) {
+    if (read(fd, &frame, sizeof(frame)) != sizeof(frame))
+      break;
+
+    double seconds = (timebase::now_ns() - start) / 1e9;
+    const Message *message = nullptr;
+    for (const Message &m : map)
+      if (m.id == frame.can_id)
+        message = &m;
+
+    printf("%10.6f %03X", seconds, frame.can_id & CAN_EFF_MASK);
+    if (message) {
+      unpack(*message, frame.data, frame.can_dlc, values);
+      for (unsigned i = 0; i < message->signals.size(); ++i)
+        printf(isnan(values[i]) ? " %s=-" : " %s=%g",
+            reading_name(message->signals[i].reading), values[i]);
+    } else {
+      for (unsigned i = 0; i < frame.can_dlc; ++i)
+        printf(" %02X", frame.data[i]);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,199 @@
+#include "can_telemetry.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace can_telemetry {
+namespace {
+const char *kReadingNames[] = {
+  "rpm", "mph", "cvt_temp", "battery", "brake", "logging", "amb_temp",
+  "fr_rotor_temp", "fl_rotor_temp", "rear_rotor_temp",
+};
+static_assert(sizeof(kReadingNames) / sizeof(*kReadingNames) ==
+    acquire::NUM_READINGS, "A name for every reading");
+
+bool parse_signal(const string &token, Signal &signal) {
+  size_t star = token.find('*');
+  string name = token.substr(0, star);
+  signal.scale = star == string::npos ? 1 :
+    strtof(token.c_str() + star + 1, nullptr);
+  if (signal.scale == 0 || !isfinite(signal.scale))
+    return false;
+
+  for (int r = 0; r < acquire::NUM_READINGS; ++r) {
+    if (name == kReadingNames[r]) {
+      signal.reading = (acquire::Reading) r;
+      return true;
+    }
+  }
+  return false;
+}
+}  // anonymous namespace
+
+const char *reading_name(acquire::Reading r) {
+  return r >= 0 && r < acquire::NUM_READINGS ? kReadingNames[r] : "?";
+}
+
+vector<Message> default_map() {
+  return {
+    {0x100, 50, {{acquire::RPM, 1}, {acquire::MPH, 0.01},
+                 {acquire::BRAKE, 1}, {acquire::LOGGING, 1}}},
+    {0x101, 5, {{acquire::CVT_TEMP, 0.1}, {acquire::AMB_TEMP, 0.1},
+                {acquire::BATTERY, 0.001}}},
+    {0x102, 5, {{acquire::FR_ROTOR_TEMP, 0.1}, {acquire::FL_ROTOR_TEMP, 0.1},
+                {acquire::REAR_ROTOR_TEMP, 0.1}}},
+  };
+}
+
+bool parse_map(istream &in, vector<Message> &map, string &error) {
+  map.clear();
+  string line;
+  while (getline(in, line)) {
+    string text = line.substr(0, line.find('#'));
+    istringstream fields(text);
+    string id, token;
+    Message message;
+    if (!(fields >> id))
+      continue;  // Blank or a comment
+
+    char *end;
+    unsigned long raw_id = strtoul(id.c_str(), &end, 0);
+    bool ok = *end == '\0' && raw_id <= CAN_EFF_MASK &&
+      (bool) (fields >> message.hz) && message.hz > 0;
+    message.id = raw_id > CAN_SFF_MASK ? raw_id | CAN_EFF_FLAG : raw_id;
+    while (ok && fields >> token) {
+      Signal signal;
+      ok = parse_signal(token, signal) &&
+        message.signals.size() < kMaxSignals;
+      message.signals.push_back(signal);
+    }
+
+    if (!ok || message.signals.empty()) {
+      error = line;
+      return false;
+    }
+    map.push_back(message);
+  }
+  return true;
+}
+
+uint8_t pack(const Message &message, const float *readings, uint8_t *data) {
+  uint8_t len = 0;
+  for (const Signal &signal : message.signals) {
+    float value = readings[signal.reading] / signal.scale;
+    int16_t raw = kNoReading;
+    if (!isnan(value))
+      raw = value >= INT16_MAX ? INT16_MAX :
+        value <= INT16_MIN + 1 ? INT16_MIN + 1 : (int16_t) lroundf(value);
+    data[len++] = raw & 0xFF;
+    data[len++] = (uint16_t) raw >> 8;
+  }
+  return len;
+}
+
+void unpack(const Message &message, const uint8_t *data, uint8_t len,
+    float *values) {
+  for (unsigned i = 0; i < message.signals.size(); ++i) {
+    if (2 * i + 1 >= len) {
+      values[i] = NAN;
+      continue;
+    }
+    int16_t raw = data[2 * i] | data[2 * i + 1] << 8;
+    values[i] = raw == kNoReading ? NAN : raw * message.signals[i].scale;
+  }
+}
+
+int open_socket(const char *interface) {
+  int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (fd < 0)
+    return -1;
+
+  ifreq ifr = {};
+  strncpy(ifr.ifr_name, interface, IFNAMSIZ - 1);
+  sockaddr_can addr = {};
+  addr.can_family = AF_CAN;
+  if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+    close(fd);
+    return -1;
+  }
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if (bind(fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+Publisher::Publisher(const vector<Message> &map)
+    : map_(map), due_ns_(map.size(), 0), frames_(map.size()),
+      iovs_(map.size()), msgs_(map.size()) {
+  for (size_t i = 0; i < map_.size(); ++i) {
+    iovs_[i] = {&frames_[i], sizeof(can_frame)};
+    msgs_[i] = {};
+    msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+    msgs_[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+Publisher::~Publisher() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool Publisher::open(const char *interface) {
+  int fd = open_socket(interface);
+  if (fd < 0)
+    return false;
+
+  // Send only, so nothing piles up unread
+  setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, nullptr, 0);
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = fd;
+  return true;
+}
+
+double Publisher::period_seconds() const {
+  double hz = 0;
+  for (const Message &message : map_)
+    hz = fmax(hz, message.hz);
+  return hz > 0 ? 1 / hz : 1;
+}
+
+void Publisher::publish(uint64_t now_ns, const float *readings) {
+  unsigned batch = 0;
+  for (size_t i = 0; i < map_.size(); ++i) {
+    // Due within half a period, so a timer at the same rate never skips one
+    uint64_t period_ns = 1e9 / map_[i].hz;
+    if (now_ns + period_ns / 2 < due_ns_[i])
+      continue;
+
+    // Stay on the message's rate, unless it's a whole period behind
+    due_ns_[i] += period_ns;
+    if (due_ns_[i] <= now_ns)
+      due_ns_[i] = now_ns + period_ns;
+
+    can_frame &frame = frames_[batch];
+    frame = {};
+    frame.can_id = map_[i].id;
+    frame.can_dlc = pack(map_[i], readings, frame.data);
+    ++batch;
+  }
+  if (!batch || fd_ < 0)
+    return;
+
+  int sent = sendmmsg(fd_, msgs_.data(), batch, MSG_DONTWAIT);
+  sent = sent < 0 ? 0 : sent;
+  sent_ += sent;
+  dropped_ += batch - sent;
+}
+}  // namespace can_telemetry
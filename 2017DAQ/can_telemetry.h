@@ -0,0 +1,92 @@
+#ifndef CAN_TELEMETRY_H_
+#define CAN_TELEMETRY_H_
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <linux/can.h>
+#include <sys/socket.h>
+
+#include "acquire.h"
+
+// Live telemetry for the car's other modules over SocketCAN. An ID map packs
+// readings into frames, each message at its own rate. A signal is a little
+// endian int16 of reading / scale, saturating, with INT16_MIN for NAN (a
+// sensor that's down), so a frame holds up to 4.
+//
+// The map has a message per line, "id hz reading[*scale]...", e.g.
+//   0x101 5 cvt_temp*0.1 battery*0.001
+// with # comments. Scales default to 1.
+namespace can_telemetry {
+const unsigned kMaxSignals = 4;
+const int16_t kNoReading = INT16_MIN;
+
+struct Signal {
+  acquire::Reading reading;
+  float scale;
+};
+
+struct Message {
+  uint32_t id;  // 11-bit, or 29-bit with CAN_EFF_FLAG
+  double hz;
+  std::vector<Signal> signals;
+};
+
+// Reading names, as in maps: "rpm", "cvt_temp", ...
+const char *reading_name(acquire::Reading r);
+
+// The map used without one: rpm and mph at 50Hz, the rest at 5Hz
+std::vector<Message> default_map();
+// Parses a map, false with the line that failed in error
+bool parse_map(std::istream &in, std::vector<Message> &map,
+    std::string &error);
+
+// Packs readings (NUM_READINGS of them) into a frame's data, returns its
+// length
+uint8_t pack(const Message &message, const float *readings, uint8_t *data);
+// Unpacks a frame's signals into values, in signal order
+void unpack(const Message &message, const uint8_t *data, uint8_t len,
+    float *values);
+
+// Opens a raw CAN socket on an interface (e.g. can0, or vcan0 to test),
+// returns it or -1
+int open_socket(const char *interface);
+
+// Sends due messages to a CAN interface. Meant for the control plane: it
+// never blocks, every due frame goes out in one sendmmsg, and frames the
+// interface's queue can't take are dropped (counted), not retried.
+class Publisher {
+ public:
+  explicit Publisher(const std::vector<Message> &map);
+  ~Publisher();
+
+  Publisher(const Publisher &) = delete;
+  Publisher &operator=(const Publisher &) = delete;
+
+  // Opens the interface to send on, false if it can't
+  bool open(const char *interface);
+
+  // Period of the fastest message, publish at least this often
+  double period_seconds() const;
+  // Sends every message due by now_ns, readings as from acquire::reading
+  void publish(uint64_t now_ns, const float *readings);
+
+  unsigned long sent() const { return sent_; }
+  unsigned long dropped() const { return dropped_; }
+
+ private:
+  std::vector<Message> map_;
+  std::vector<uint64_t> due_ns_;  // Per message
+  int fd_ = -1;
+
+  // A batch, a frame per message at most, allocated up front
+  std::vector<can_frame> frames_;
+  std::vector<iovec> iovs_;
+  std::vector<mmsghdr> msgs_;
+  unsigned long sent_ = 0, dropped_ = 0;
+};
+}  // namespace can_telemetry
+
+#endif  // CAN_TELEMETRY_H_
@@ -0,0 +1,122 @@
+#include "can_telemetry.h"
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <sstream>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "timebase.h"
+
+using namespace std;
+using namespace can_telemetry;
+
+// Packing and the map parse everywhere. Publishing needs a virtual CAN
+// interface, and is skipped without one.
+const char *kInterface = "vcan0";
+const double kPublishSeconds = 1;
+
+int main(int argc, char **argv) {
+  float readings[acquire::NUM_READINGS] = {};
+  readings[acquire::RPM] = 3456;
+  readings[acquire::MPH] = 23.456;
+  readings[acquire::BRAKE] = 1;
+  readings[acquire::LOGGING] = NAN;
+  readings[acquire::CVT_TEMP] = 1e6;
+  readings[acquire::AMB_TEMP] = -1e6;
+  readings[acquire::BATTERY] = 12.6;
+
+  vector<Message> map = default_map();
+  uint8_t data[8];
+  float values[kMaxSignals];
+  unpack(map[0], data, pack(map[0], readings, data), values);
+  test::check("Signals round trip at their scale",
+      values[0] == 3456 && fabs(values[1] - 23.46) < 1e-4 && values[2] == 1);
+  test::check("Missing readings stay missing", isnan(values[3]));
+  test::check("Frame holds every signal", pack(map[0], readings, data) == 8);
+
+  unpack(map[1], data, pack(map[1], readings, data), values);
+  test::check("Out of range readings saturate",
+      values[0] == INT16_MAX * 0.1f && values[1] == (INT16_MIN + 1) * 0.1f &&
+      fabs(values[2] - 12.6) < 1e-3);
+  unpack(map[1], data, 4, values);
+  test::check("Short frames leave signals missing", isnan(values[2]));
+
+  istringstream good(
+      "# id hz signals\n"
+      "\n"
+      "0x200 20 rpm mph*0.1  # engine\n"
+      "0x1ABCDE 2 battery*0.001\n");
+  vector<Message> parsed;
+  string error;
+  test::check("Map parses",
+      parse_map(good, parsed, error) && parsed.size() == 2);
+  test::check("Map fields read",
+      parsed.size() == 2 && parsed[0].id == 0x200 && parsed[0].hz == 20 &&
+      parsed[0].signals.size() == 2 &&
+      parsed[0].signals[1].reading == acquire::MPH &&
+      fabs(parsed[0].signals[1].scale - 0.1) < 1e-6);
+  test::check("Wide ids are extended",
+      parsed.size() == 2 && parsed[1].id == (0x1ABCDE | CAN_EFF_FLAG));
+
+  const char *bad[] = {
+    "0x200 20 speed\n", "0x200 0 rpm\n", "0x200 20\n", "0x200 20 rpm*0\n",
+    "0x2000000000 20 rpm\n", "0x200 20 rpm rpm rpm rpm rpm\n",
+  };
+  bool rejected = true;
+  for (const char *text : bad) {
+    istringstream in(text);
+    rejected = rejected && !parse_map(in, parsed, error) &&
+      error + "\n" == text;
+  }
+  test::check("Bad map lines rejected", rejected);
+
+  int reader = open_socket(kInterface);
+  Publisher publisher(map);
+  if (reader < 0 || !publisher.open(kInterface)) {
+    printf("No %s, skipping publishing. To set one up:\n"
+        "  sudo modprobe vcan && sudo ip link add dev vcan0 type vcan &&\n"
+        "  sudo ip link set up vcan0\n", kInterface);
+    if (reader >= 0)
+      close(reader);
+    return test::result();
+  }
+
+  // Publish on a timer at the fastest rate, as the driver does
+  uint64_t begin = timebase::now_ns();
+  uint64_t period = publisher.period_seconds() * 1e9;
+  std::map<uint32_t, unsigned> received;
+  bool decoded = true;
+  pollfd pfd = {reader, POLLIN, 0};
+  for (uint64_t next = begin; next - begin < kPublishSeconds * 1e9;
+      next += period) {
+    publisher.publish(next, readings);
+    uint64_t now;
+    while ((now = timebase::now_ns()) < next + period) {
+      if (poll(&pfd, 1, (next + period - now) / 1000000 + 1) <= 0)
+        continue;
+      can_frame frame;
+      if (read(reader, &frame, sizeof(frame)) != sizeof(frame))
+        continue;
+      ++received[frame.can_id];
+      if (frame.can_id == map[0].id) {
+        unpack(map[0], frame.data, frame.can_dlc, values);
+        decoded = decoded && values[0] == 3456;
+      }
+    }
+  }
+  close(reader);
+
+  printf("  sent %lu, dropped %lu; received %u, %u, %u\n", publisher.sent(),
+      publisher.dropped(), received[0x100], received[0x101], received[0x102]);
+  test::check("Frames decode", decoded && received[0x100] > 0);
+  test::check("Messages at their rates",
+      received[0x100] >= 48 && received[0x100] <= 52 &&
+      received[0x101] >= 4 && received[0x101] <= 6 &&
+      received[0x102] == received[0x101]);
+  test::check("Nothing dropped", publisher.dropped() == 0);
+  return test::result();
+}
@@ -0,0 +1,170 @@
+#include "clock_sync.h"
+
+#include <algorithm>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace clock_sync {
+namespace {
+const uint32_t kMagic = 0x53514144;  // "DAQS"
+// Stretches of the window, the least delayed exchange of each is fitted
+const unsigned kBins = 8;
+// Below this span of exchanges, drift is too noisy to fit
+const uint64_t kMinDriftSpanNs = 1000000000;
+
+// Opens a UDP socket on the first address that works, connecting or binding
+int open_socket(const char *host, const char *port, bool server) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = server ? AI_PASSIVE : 0;
+
+  addrinfo *addrs;
+  if (getaddrinfo(host, port, &hints, &addrs) != 0)
+    return -1;
+
+  int fd = -1;
+  for (addrinfo *a = addrs; a && fd < 0; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0)
+      continue;
+
+    bool ok = server ? bind(fd, a->ai_addr, a->ai_addrlen) == 0 :
+      connect(fd, a->ai_addr, a->ai_addrlen) == 0;
+    if (!ok) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  freeaddrinfo(addrs);
+  return fd;
+}
+}  // anonymous namespace
+
+int serve_on(const char *port) {
+  return open_socket(nullptr, port, true);
+}
+
+void answer(int fd) {
+  Packet packet;
+  sockaddr_storage from;
+  socklen_t from_len = sizeof(from);
+  while (recvfrom(fd, &packet, sizeof(packet), MSG_DONTWAIT,
+        (sockaddr *) &from, &from_len) == sizeof(packet)) {
+    uint64_t arrived = timebase::now_ns();
+    if (packet.magic == kMagic) {
+      packet.t2 = arrived;
+      packet.t3 = timebase::now_ns();
+      sendto(fd, &packet, sizeof(packet), MSG_DONTWAIT, (sockaddr *) &from,
+          from_len);
+    }
+    from_len = sizeof(from);
+  }
+}
+
+const unsigned Client::kWindow;
+const unsigned Client::kMinExchanges;
+
+Client::Client(Clock clock) : clock_(clock) {}
+
+Client::~Client() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool Client::connect(const char *host, const char *port) {
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = open_socket(host, port, false);
+  return fd_ >= 0;
+}
+
+bool Client::request() {
+  Packet packet = {kMagic, seq_++, clock_(), 0, 0};
+  return send(fd_, &packet, sizeof(packet), MSG_DONTWAIT) == sizeof(packet);
+}
+
+void Client::receive() {
+  Packet packet;
+  while (recv(fd_, &packet, sizeof(packet), MSG_DONTWAIT) ==
+      sizeof(packet)) {
+    uint64_t t4 = clock_();
+    // Replies to another client's requests, or from before a clock change
+    if (packet.magic != kMagic || packet.t1 > t4 || packet.t3 < packet.t2)
+      continue;
+
+    Exchange exchange;
+    exchange.time = packet.t1 + (t4 - packet.t1) / 2;
+    exchange.offset = ((int64_t) (packet.t2 - packet.t1) +
+        (int64_t) (packet.t3 - t4)) / 2;
+    uint64_t round_trip = t4 - packet.t1, held = packet.t3 - packet.t2;
+    exchange.delay = round_trip > held ? round_trip - held : 0;
+
+    lock_guard<mutex> lock(mutex_);
+    window_[head_] = exchange;
+    head_ = (head_ + 1) % kWindow;
+    if (count_ < kWindow)
+      ++count_;
+    fit();
+  }
+}
+
+void Client::fit() {
+  uint64_t oldest = UINT64_MAX, newest = 0;
+  for (unsigned i = 0; i < count_; ++i) {
+    oldest = min(oldest, window_[i].time);
+    newest = max(newest, window_[i].time);
+  }
+
+  // The least delayed exchange of each stretch of the window
+  const Exchange *best[kBins] = {};
+  uint64_t span = newest - oldest + 1;
+  for (unsigned i = 0; i < count_; ++i) {
+    const Exchange &e = window_[i];
+    const Exchange *&bin = best[(e.time - oldest) * kBins / span];
+    if (!bin || e.delay < bin->delay)
+      bin = &e;
+  }
+
+  // Least squares through them, about the newest
+  double n = 0, sum_t = 0, sum_o = 0, sum_tt = 0, sum_to = 0;
+  uint64_t worst = 0;
+  for (const Exchange *e : best) {
+    if (!e)
+      continue;
+    double t = -(double) (newest - e->time), o = e->offset;
+    n += 1;
+    sum_t += t;
+    sum_o += o;
+    sum_tt += t * t;
+    sum_to += t * o;
+    worst = max(worst, e->delay);
+  }
+
+  double spread = n * sum_tt - sum_t * sum_t;
+  drift_ = span >= kMinDriftSpanNs && spread > 0 ?
+    (n * sum_to - sum_t * sum_o) / spread : 0;
+  offset_ = (int64_t) ((sum_o - drift_ * sum_t) / n);
+  ref_ = newest;
+  delay_ = worst;
+}
+
+Client::Estimate Client::estimate() const {
+  uint64_t now = clock_();
+  lock_guard<mutex> lock(mutex_);
+  int64_t offset = offset_ + (int64_t) (drift_ * (int64_t) (now - ref_));
+  return {count_, offset, drift_, delay_, delay_ / 2};
+}
+
+uint64_t Client::to_primary(uint64_t local_ns) const {
+  lock_guard<mutex> lock(mutex_);
+  if (!count_)
+    return local_ns;
+  return local_ns + offset_ + (int64_t) (drift_ * (int64_t) (local_ns - ref_));
+}
+}  // namespace clock_sync
@@ -0,0 +1,97 @@
+#ifndef CLOCK_SYNC_H_
+#define CLOCK_SYNC_H_
+
+#include <cstdint>
+#include <mutex>
+
+#include "timebase.h"
+
+// Clock synchronization between DAQ nodes, a PTP-like exchange over UDP. A
+// secondary sends the primary its monotonic time t1, the primary stamps the
+// request's arrival t2 and its reply's departure t3, and the secondary stamps
+// the reply's arrival t4. Over a path as slow both ways,
+//   offset = ((t2 - t1) + (t3 - t4)) / 2   (primary minus secondary)
+//   delay  = (t4 - t1) - (t3 - t2)
+// and however slow each way really was, the offset is within delay / 2.
+// Queueing and scheduling only ever add delay, so the secondary fits the
+// clocks' offset and drift (tens of ppm between crystals) to the least delayed
+// exchanges across a window of them.
+namespace clock_sync {
+const char *const kDefaultPort = "8890";
+
+// Both ways, little endian
+struct Packet {
+  uint32_t magic;
+  uint32_t seq;
+  uint64_t t1, t2, t3;
+};
+
+// Primary: opens a UDP socket on port on every interface, returns it or -1
+int serve_on(const char *port = kDefaultPort);
+// Answers every pending request on a serve_on() socket, call when it's
+// readable
+void answer(int fd);
+
+// Secondary
+class Client {
+ public:
+  typedef uint64_t (*Clock)();
+  static const unsigned kWindow = 64;       // Exchanges fitted
+  static const unsigned kMinExchanges = 8;  // Before it's synced
+
+  // clock is the secondary's monotonic clock
+  explicit Client(Clock clock = timebase::now_ns);
+  ~Client();
+
+  Client(const Client &) = delete;
+  Client &operator=(const Client &) = delete;
+
+  // Opens a UDP socket to the primary, false if host doesn't resolve
+  bool connect(const char *host, const char *port = kDefaultPort);
+  int fd() const { return fd_; }
+
+  // Sends a request, e.g. from a timer a few times a second
+  bool request();
+  // Takes every pending reply into the estimate, call when fd() is readable
+  void receive();
+
+  struct Estimate {
+    unsigned exchanges;  // In the window
+    int64_t offset_ns;   // Primary minus secondary, now
+    double drift;        // Of the offset, e.g. 20e-6 for 20ppm
+    uint64_t delay_ns;   // Worst round trip delay of the exchanges fitted
+    uint64_t error_ns;   // Bound on offset_ns's error, half that delay
+  };
+  Estimate estimate() const;
+  bool synced() const { return estimate().exchanges >= kMinExchanges; }
+
+  // Primary time of a secondary monotonic time. The same time until the
+  // first exchange. Thread safe.
+  uint64_t to_primary(uint64_t local_ns) const;
+
+ private:
+  struct Exchange {
+    uint64_t time;  // Secondary time of the middle of the exchange
+    int64_t offset;
+    uint64_t delay;
+  };
+
+  // Refits the model to the least delayed exchanges of the window
+  void fit();
+
+  const Clock clock_;
+  int fd_ = -1;
+  uint32_t seq_ = 0;
+
+  mutable std::mutex mutex_;  // GUARDS everything below
+  Exchange window_[kWindow];
+  unsigned head_ = 0, count_ = 0;
+  // offset(t) = offset_ + drift_ * (t - ref_)
+  uint64_t ref_ = 0;
+  int64_t offset_ = 0;
+  double drift_ = 0;
+  uint64_t delay_ = 0;
+};
+}  // namespace clock_sync
+
+#endif  // CLOCK_SYNC_H_
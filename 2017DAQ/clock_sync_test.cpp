@@ -0,0 +1,164 @@
+#include "clock_sync.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "csv.h"
+#include "merge.h"
+#include "test.h"
+#include "timebase.h"
+
+using namespace std;
+
+// A primary and a secondary node as two processes over loopback. The
+// secondary's clock runs off by an offset and a drift, as another Pi's would.
+const char *kPort = "28890";
+const int64_t kOffsetNs = 123456789;
+const double kDrift = 50e-6;
+const double kSyncSeconds = 3;
+const double kRequestSeconds = 0.05;  // The window spans ~3s
+// Both nodes log an event every 10ms of real time
+const uint64_t kEventNs = 10000000;
+const int64_t kToleranceNs = 200000;
+
+uint64_t secondary_now() {
+  return timebase::now_ns() * (1 + kDrift) + kOffsetNs;
+}
+
+// Primary's wall clock, less its monotonic clock
+const int64_t kWallNs = 1500000000000000000;
+
+// Writes events at real times [from, to) as a node's log, timed by map. The
+// primary knows its wall time, the secondary, on the primary's clock, doesn't.
+template <typename Map>
+void write_log(const string &name, uint64_t from, uint64_t to, Map map,
+    int64_t wall_ns) {
+  timebase::Anchor start = {wall_ns, map(from), 0, 0};
+  timebase::write_csv(merge::time_filename(name).c_str(), start);
+  Csv csv(name.c_str(), {"Time (us)", "Event"});
+  for (uint64_t event = from / kEventNs + 1; event * kEventNs < to; ++event)
+    csv << (map(event * kEventNs) - start.mono_ns) / 1000 << event
+      << Csv::LINE_BREAK;
+}
+
+int main(int argc, char **argv) {
+  char dir[] = "/tmp/clock_sync_test_XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  string primary_log = string(dir) + "/primary.csv";
+  string secondary_log = string(dir) + "/secondary.csv";
+
+  int fd = clock_sync::serve_on(kPort);
+  if (fd < 0) {
+    perror("serve_on");
+    return 1;
+  }
+
+  // The primary answers for longer than the secondary asks, then logs
+  uint64_t begin = timebase::now_ns();
+  pid_t primary = fork();
+  if (primary == 0) {
+    pollfd pfd = {fd, POLLIN, 0};
+    while (timebase::now_ns() - begin < (kSyncSeconds + 1) * 1e9)
+      if (poll(&pfd, 1, 10) > 0)
+        clock_sync::answer(fd);
+    write_log(primary_log, begin, timebase::now_ns(),
+        [](uint64_t t) { return t; }, kWallNs + begin);
+    _exit(0);
+  }
+  close(fd);
+
+  clock_sync::Client client(secondary_now);
+  test::check("Secondary reaches the primary",
+      client.connect("127.0.0.1", kPort));
+  pollfd pfd = {client.fd(), POLLIN, 0};
+  for (uint64_t next = begin; next - begin < kSyncSeconds * 1e9;
+      next += kRequestSeconds * 1e9) {
+    client.request();
+    uint64_t now;
+    while ((now = timebase::now_ns()) < next)
+      if (poll(&pfd, 1, (next - now) / 1000000 + 1) > 0)
+        client.receive();
+  }
+
+  // Both clocks are really the one monotonic clock, so the error is known
+  clock_sync::Client::Estimate sync = client.estimate();
+  uint64_t now = timebase::now_ns();
+  int64_t error = (int64_t) (client.to_primary(secondary_now()) - now);
+  printf("  %u exchanges, fitted delay %.1fus, drift %.2fppm\n",
+      sync.exchanges, sync.delay_ns / 1e3, sync.drift * 1e6);
+  printf("  offset error %+.1fus (bound +-%.1fus)\n", error / 1e3,
+      sync.error_ns / 1e3);
+  test::check("Synced", client.synced());
+  test::check("Offset within tolerance", llabs(error) < kToleranceNs);
+  test::check("Drift fitted", fabs(sync.drift + kDrift) < 15e-6);
+
+  // The secondary logs the same events on the primary's clock
+  write_log(secondary_log, begin, now, [&](uint64_t t) {
+        return client.to_primary(t * (1 + kDrift) + kOffsetNs);
+      }, 0);
+
+  int status;
+  waitpid(primary, &status, 0);
+  test::check("Primary ran", WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  string merged_log = string(dir) + "/merged.csv";
+  string error_file;
+  long rows = merge::logs({primary_log, secondary_log}, merged_log,
+      error_file);
+  test::check("Logs merged", rows > 0);
+  timebase::Anchor session;
+  test::check("Session wall time from the primary",
+      timebase::read_csv(merge::time_filename(merged_log).c_str(), session) &&
+      session.wall_ns == kWallNs + (int64_t) session.mono_ns);
+
+  // Merged in time order, with each event at the same time on both nodes
+  ifstream merged(merged_log);
+  string line;
+  getline(merged, line);
+  bool ordered = true;
+  uint64_t last = 0;
+  map<long, int64_t> event_times[2];
+  while (getline(merged, line)) {
+    // Time, node, then the primary's event or the secondary's
+    unsigned long long time;
+    unsigned node;
+    int fields;
+    if (sscanf(line.c_str(), "%llu,%u,%n", &time, &node, &fields) < 2 ||
+        node > 1)
+      continue;
+    long event = strtol(line.c_str() + fields + node, nullptr, 10);
+    ordered = ordered && time >= last;
+    last = time;
+    event_times[node][event] = time * 1000;
+  }
+  int64_t worst = 0;
+  unsigned matched = 0;
+  for (const auto &event : event_times[0]) {
+    auto other = event_times[1].find(event.first);
+    if (other == event_times[1].end())
+      continue;
+    int64_t apart = llabs(other->second - event.second);
+    if (apart > worst)
+      worst = apart;
+    ++matched;
+  }
+  printf("  %u events on both nodes, %.1fus apart at worst\n", matched,
+      worst / 1e3);
+  test::check("Merged rows in time order", ordered && rows > 0);
+  test::check("Events line up across nodes",
+      matched > 100 && worst < kToleranceNs + 1000);
+
+  system((string("rm -rf ") + dir).c_str());
+  return test::result();
+}
@@ -0,0 +1,248 @@
+#include "csv_load.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace csv_load {
+namespace {
+// Below this much text a thread, starting one costs more than it saves
+const size_t kMinChunk = 1 << 16;
+// Digits that fit a uint64_t, and the integers a double holds exactly
+const int kMaxDigits = 19;
+const uint64_t kMaxExact = 1ULL << 53;
+// Every power of ten a double holds exactly
+const double kPow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+  1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+const int kMaxPow10 = sizeof(kPow10) / sizeof(*kPow10) - 1;
+
+inline bool is_digit(char c) {
+  return (unsigned char) (c - '0') < 10;
+}
+
+// The field at p as strtod reads it, for what the fast path can't take
+double parse_slow(const char *&p, const char *end) {
+  char field[64];
+  size_t len = 0;
+  while (p + len < end && len < sizeof(field) - 1 && p[len] != ',' &&
+      p[len] != '\n' && p[len] != '\r')
+    ++len;
+  memcpy(field, p, len);
+  field[len] = '\0';
+
+  char *stop;
+  double value = strtod(field, &stop);
+  if (stop == field)
+    return NAN;
+  p += stop - field;
+  return value;
+}
+
+// Calls line(begin, end) for each line with anything on it, without its line
+// ending
+template <typename Line>
+void for_each_line(const char *p, const char *end, Line line) {
+  while (p < end) {
+    const char *eol = (const char *) memchr(p, '\n', end - p);
+    const char *next = eol ? eol + 1 : end;
+    eol = eol ? eol : end;
+    if (eol > p && eol[-1] == '\r')
+      --eol;
+    if (eol > p)
+      line(p, eol);
+    p = next;
+  }
+}
+
+// Runs chunk(i) for each of chunks, one on this thread
+template <typename Chunk>
+void run_chunks(unsigned chunks, Chunk chunk) {
+  vector<thread> threads;
+  for (unsigned i = 1; i < chunks; ++i)
+    threads.emplace_back(chunk, i);
+  chunk(0);
+  for (thread &t : threads)
+    t.join();
+}
+}  // anonymous namespace
+
+double parse_number(const char *&p, const char *end) {
+  const char *s = p;
+  bool negative = s < end && *s == '-';
+  if (s < end && (*s == '-' || *s == '+'))
+    ++s;
+
+  // Significant digits into mantissa, value = mantissa * 10^exponent. Digits
+  // past kMaxDigits only count if they're zeros.
+  uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any = false, exact = true;
+  for (; s < end && is_digit(*s); ++s) {
+    any = true;
+    if (digits < kMaxDigits) {
+      mantissa = mantissa * 10 + (*s - '0');
+      digits += mantissa != 0;
+    } else {
+      ++exponent;
+      exact = exact && *s == '0';
+    }
+  }
+  if (s < end && *s == '.') {
+    for (++s; s < end && is_digit(*s); ++s) {
+      any = true;
+      if (digits < kMaxDigits) {
+        mantissa = mantissa * 10 + (*s - '0');
+        digits += mantissa != 0;
+        --exponent;
+      } else {
+        exact = exact && *s == '0';
+      }
+    }
+  }
+  if (!any)
+    return parse_slow(p, end);  // "nan", "inf", or nothing
+
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    const char *e = s + 1;
+    bool negative_exponent = e < end && *e == '-';
+    if (e < end && (*e == '-' || *e == '+'))
+      ++e;
+    if (e < end && is_digit(*e)) {
+      int value = 0;
+      for (; e < end && is_digit(*e); ++e)
+        value = value < 10000 ? value * 10 + (*e - '0') : value;
+      exponent += negative_exponent ? -value : value;
+      s = e;
+    }
+  }
+
+  if (!exact || mantissa > kMaxExact || exponent < -kMaxPow10 ||
+      exponent > kMaxPow10)
+    return parse_slow(p, end);
+  double value = mantissa;
+  value = exponent < 0 ? value / kPow10[-exponent] : value * kPow10[exponent];
+  p = s;
+  return negative ? -value : value;
+}
+
+long parse(const char *data, size_t size, Table &table, unsigned threads) {
+  const char *end = data + size;
+  const char *body = (const char *) memchr(data, '\n', size);
+  if (!body)
+    return -1;
+
+  table.headers.clear();
+  for_each_line(data, body, [&](const char *p, const char *eol) {
+        for (;;) {
+          const char *comma = (const char *) memchr(p, ',', eol - p);
+          table.headers.emplace_back(p, comma ? comma : eol);
+          if (!comma)
+            break;
+          p = comma + 1;
+        }
+      });
+  ++body;
+
+  if (!threads)
+    threads = max(1u, thread::hardware_concurrency());
+  threads = max<size_t>(1, min<size_t>(threads, (end - body) / kMinChunk));
+
+  // Chunks of about the same size, each starting a line
+  vector<const char *> bounds(threads + 1, end);
+  bounds[0] = body;
+  for (unsigned i = 1; i < threads; ++i) {
+    const char *p = max(body + (end - body) * i / threads, bounds[i - 1]);
+    const char *eol = (const char *) memchr(p - 1, '\n', end - p + 1);
+    bounds[i] = eol ? eol + 1 : end;
+  }
+
+  // Each chunk's rows, then where they start
+  vector<size_t> starts(threads + 1, 0);
+  run_chunks(threads, [&](unsigned i) {
+        size_t rows = 0;
+        for_each_line(bounds[i], bounds[i + 1],
+            [&rows](const char *, const char *) { ++rows; });
+        starts[i + 1] = rows;
+      });
+  for (unsigned i = 0; i < threads; ++i)
+    starts[i + 1] += starts[i];
+  table.rows = starts[threads];
+
+  // Left uninitialized, every cell is written (and first touched) by the
+  // thread parsing its row
+  size_t num_cols = table.headers.size();
+  table.columns.clear();
+  vector<double *> columns;
+  for (size_t c = 0; c < num_cols; ++c) {
+    table.columns.emplace_back(new double[table.rows]);
+    columns.push_back(table.columns.back().get());
+  }
+
+  run_chunks(threads, [&](unsigned i) {
+        size_t row = starts[i];
+        for_each_line(bounds[i], bounds[i + 1],
+            [&](const char *p, const char *eol) {
+              for (size_t c = 0; c < num_cols; ++c) {
+                double value = NAN;
+                if (p < eol && *p != ',')
+                  value = parse_number(p, eol);
+                columns[c][row] = value;
+
+                // Numbers end at their comma, but for junk after one
+                if (p < eol && *p != ',') {
+                  p = (const char *) memchr(p, ',', eol - p);
+                  p = p ? p : eol;
+                }
+                p += p < eol;
+              }
+              ++row;
+            });
+      });
+  return table.rows;
+}
+
+long load(const string &filename, Table &table, string &error,
+    unsigned threads) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    error = filename + ": " + strerror(errno);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    error = filename + ": empty";
+    return -1;
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    error = filename + ": " + strerror(errno);
+    return -1;
+  }
+  // Every chunk is read at once, start reading ahead on all of them
+  madvise(data, st.st_size, MADV_WILLNEED);
+
+  long rows = parse((const char *) data, st.st_size, table, threads);
+  munmap(data, st.st_size);
+  if (rows < 0)
+    error = filename + ": no header";
+  return rows;
+}
+}  // namespace csv_load
@@ -0,0 +1,41 @@
+#ifndef CSV_LOAD_H_
+#define CSV_LOAD_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Loads logs (RECORD_NNNN.csv, of either width) for analysis, into a column of
+// doubles per header. The file is mapped, not read, and split into a chunk per
+// thread on line boundaries. Threads count their chunk's rows, then parse them
+// straight into the columns at their offset, so parsing scales with cores and
+// nothing is copied but the numbers.
+//
+// Fields are parsed as the driver writes them (ostream's %g-like output), in
+// one pass and without strtod: digits accumulate into an integer that's
+// scaled by an exact power of ten, which rounds correctly while both fit in a
+// double. Longer ones, and "nan" and "inf", fall back to strtod.
+namespace csv_load {
+struct Table {
+  std::vector<std::string> headers;
+  size_t rows = 0;
+  // A column per header, rows long, NAN where a row has no value (an empty
+  // field, or a row cut short by a crash)
+  std::vector<std::unique_ptr<double[]>> columns;
+};
+
+// Parses the number at p, up to end, and sets p past it. NAN, with p left
+// alone, if there's none.
+double parse_number(const char *&p, const char *end);
+
+// Parses a log's text, returns its rows, or -1 without a header line. threads
+// 0 is one per core.
+long parse(const char *data, size_t size, Table &table, unsigned threads = 0);
+
+// Maps and parses a log, returns its rows, or -1 with why in error
+long load(const std::string &filename, Table &table, std::string &error,
+    unsigned threads = 0);
+}  // namespace csv_load
+
+#endif  // CSV_LOAD_H_
@@ -0,0 +1,108 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "csv_load.h"
+#include "stats.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [MB of log] [max threads]\n";
+
+const char *kFilename = "/tmp/csv_load_bench.csv";
+const unsigned kColumns = 21;  // A testing mode log
+const int kRuns = 5;           // Best of, per thread count
+
+// A testing mode log of about mb, with values as the sensors give them
+string make_log(double mb) {
+  mt19937 rng(2018);
+  uniform_real_distribution<float> value(-500, 3000);
+  ostringstream log;
+  log << "Time (s)";
+  for (unsigned c = 1; c < kColumns; ++c)
+    log << ",Column " << c;
+  log << '\n';
+  for (unsigned row = 0; log.tellp() < mb * 1e6; ++row) {
+    log << row * 0.0005;
+    for (unsigned c = 1; c < kColumns; ++c)
+      log << ',' << value(rng);
+    log << '\n';
+  }
+  return log.str();
+}
+
+// Best load rate of kRuns, in GB/s
+template <typename Load>
+double best_rate(size_t bytes, Load load) {
+  double best = 0;
+  for (int run = 0; run < kRuns; ++run) {
+    uint64_t start = stats::now_ns();
+    load();
+    best = max(best, bytes / ((stats::now_ns() - start) / 1e9) / 1e9);
+  }
+  return best;
+}
+
+// Parse rate by thread count, from memory and from a mapped file (in the page
+// cache), then the number parser alone. Rates are of log text, GB/s.
+int main(int argc, char **argv) {
+  if (argc > 3) {
+    printf(usage, *argv);
+    return -1;
+  }
+  double mb = argc > 1 ? strtod(argv[1], nullptr) : 64;
+  unsigned max_threads = argc > 2 ? atoi(argv[2]) :
+    max(1u, thread::hardware_concurrency());
+
+  string log = make_log(mb);
+  FILE *file = fopen(kFilename, "w");
+  if (!file || fwrite(log.data(), 1, log.size(), file) != log.size()) {
+    perror(kFilename);
+    return -1;
+  }
+  fclose(file);
+  printf("%.1f MB log, %u columns, up to %u threads\n", log.size() / 1e6,
+      kColumns, max_threads);
+
+  double one_thread = 0;
+  vector<unsigned> counts;
+  for (unsigned threads = 1; threads < max_threads; threads *= 2)
+    counts.push_back(threads);
+  counts.push_back(max_threads);
+  for (unsigned threads : counts) {
+    csv_load::Table table;
+    string error;
+    double parse = best_rate(log.size(), [&]() {
+          csv_load::parse(log.data(), log.size(), table, threads);
+        });
+    double load = best_rate(log.size(), [&]() {
+          csv_load::load(kFilename, table, error, threads);
+        });
+    one_thread = one_thread ? one_thread : parse;
+    printf("%2u threads  parse %6.2f GB/s  load %6.2f GB/s  x%.1f\n", threads,
+        parse, load, parse / one_thread);
+  }
+  remove(kFilename);
+
+  // Fields of the log, one op per field
+  vector<const char *> fields;
+  for (size_t i = log.find('\n') + 1; i < log.size() && fields.size() < 4096;
+      i = log.find_first_of(",\n", i) + 1)
+    fields.push_back(log.data() + i);
+  unsigned i = 0;
+  bench::run("csv_load::parse_number", [&]() {
+      const char *p = fields[++i & 4095];
+      bench::keep(csv_load::parse_number(p, p + 32));
+    });
+  bench::run("strtod", [&]() {
+      bench::keep(strtod(fields[++i & 4095], nullptr));
+    });
+  return 0;
+}
@@ -0,0 +1,171 @@
+#include "csv_load.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "csv.h"
+#include "test.h"
+
+using namespace std;
+
+const char *kFilename = "csv_load_test.csv";
+const unsigned kRows = 20000;  // A few chunks' worth a thread
+
+// What the loader should make of a field, by strtod
+double reference(const string &field) {
+  char *stop;
+  double value = strtod(field.c_str(), &stop);
+  return stop == field.c_str() ? NAN : value;
+}
+
+bool same(double a, double b) {
+  return a == b || (isnan(a) && isnan(b));
+}
+
+// Whether table holds text, field for field, as strtod reads it
+bool matches(const string &text, const csv_load::Table &table) {
+  istringstream lines(text);
+  string line;
+  getline(lines, line);
+  size_t row = 0;
+  while (getline(lines, line)) {
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty())
+      continue;
+    if (row >= table.rows)
+      return false;
+
+    istringstream fields(line);
+    string field;
+    for (size_t c = 0; c < table.headers.size(); ++c) {
+      if (!getline(fields, field, ','))
+        field.clear();
+      if (!same(table.columns[c][row], reference(field)))
+        return false;
+    }
+    ++row;
+  }
+  return row == table.rows;
+}
+
+string read_file(const char *filename) {
+  ifstream in(filename);
+  return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+int main(int argc, char **argv) {
+  // Numbers the fast path takes, and ones it leaves to strtod
+  const char *numbers[] = {
+    "0", "-0", "12.5", "-3.25", "1e-05", "1.23457e+06", "0.000123",
+    "123456789012345678", "9007199254740993", "1e300", "4.9e-324",
+    "0.1000000000000000055511151231257827", "12345678901234567890123",
+    "+7", ".5", "5.", "nan", "-nan", "inf", "-inf", "2E3",
+  };
+  bool parsed = true;
+  for (const char *number : numbers) {
+    const char *p = number;
+    double value = csv_load::parse_number(p, number + strlen(number));
+    parsed = parsed && same(value, reference(number)) && *p == '\0';
+  }
+  test::check("Numbers parse as strtod does", parsed);
+  const char *text = "x,1";
+  const char *p = text;
+  test::check("No number left alone",
+      isnan(csv_load::parse_number(p, text + 3)) && p == text);
+  text = "1.5e";
+  p = text;
+  test::check("Dangling exponent not taken",
+      csv_load::parse_number(p, text + 4) == 1.5 && p == text + 3);
+
+  mt19937 rng(2018);
+  uniform_real_distribution<double> value(-1e4, 1e4);
+  uniform_int_distribution<int> kind(0, 19);
+  bool all_exact = true;
+  for (int i = 0; i < 100000; ++i) {
+    char number[32];
+    snprintf(number, sizeof(number), i % 2 ? "%g" : "%.17g", value(rng));
+    const char *p = number;
+    double parsed = csv_load::parse_number(p, number + strlen(number));
+    all_exact = all_exact && parsed == strtod(number, nullptr);
+  }
+  test::check("Random numbers round as strtod does", all_exact);
+
+  // A log of each width, as the driver writes them, with sensors down and
+  // empty fields
+  for (unsigned width : {9, 21}) {
+    vector<string> names;
+    for (unsigned c = 0; c < width; ++c)
+      names.push_back(c ? "Column " + to_string(c) : "Time (s)");
+    vector<const char *> headers;
+    for (const string &name : names)
+      headers.push_back(name.c_str());
+    {
+      Csv csv(kFilename, headers);
+      for (unsigned row = 0; row < kRows; ++row) {
+        csv << row * 0.001;
+        for (unsigned c = 1; c < width; ++c) {
+          int k = kind(rng);
+          if (k == 0)
+            csv << NAN;
+          else if (k == 1)
+            csv << "";
+          else
+            csv << (float) value(rng);
+        }
+        csv << Csv::LINE_BREAK;
+      }
+    }
+    // Cut short, as by a crash
+    {
+      ofstream out(kFilename, ios::app);
+      out << "20.001,1.5,";
+    }
+
+    string file = read_file(kFilename);
+    bool loaded = true, same_rows = true;
+    for (unsigned threads : {1, 2, 3, 8, 64}) {
+      csv_load::Table table;
+      string error;
+      long rows = csv_load::load(kFilename, table, error, threads);
+      loaded = loaded && rows == kRows + 1 && table.headers == names;
+      same_rows = same_rows && matches(file, table);
+    }
+    string what = to_string(width) +
+      " columns loaded, on any number of threads";
+    test::check(what.c_str(), loaded);
+    what = to_string(width) + " columns match strtod's, field for field";
+    test::check(what.c_str(), same_rows);
+  }
+
+  // Line endings and blank lines don't make rows
+  string crlf = "A,B\r\n1,2\r\n\r\n\n3,\r\n,4";
+  csv_load::Table table;
+  long rows = csv_load::parse(crlf.data(), crlf.size(), table);
+  test::check("CRLF and blank lines",
+      rows == 3 && table.headers == vector<string>({"A", "B"}) &&
+      table.columns[0][0] == 1 && table.columns[1][0] == 2 &&
+      table.columns[0][1] == 3 && isnan(table.columns[1][1]) &&
+      isnan(table.columns[0][2]) && table.columns[1][2] == 4);
+  string header_only = "A,B\n";
+  test::check("Header only",
+      csv_load::parse(header_only.data(), header_only.size(), table) == 0 &&
+      table.headers.size() == 2);
+  string no_header = "A,B";
+  test::check("No header line",
+      csv_load::parse(no_header.data(), no_header.size(), table) < 0);
+
+  string error;
+  test::check("Missing file reported",
+      csv_load::load("/nonexistent.csv", table, error) < 0 && !error.empty());
+
+  remove(kFilename);
+  return test::result();
+}
@@ -0,0 +1,98 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "csv_load.h"
+#include "stats.h"
+
+using namespace std;
+
+const char *usage =
+  "Usage: %s [-j threads] [-v] log.csv...\n"
+  "  -j  threads to parse with, one per core by default\n"
+  "  -v  summarize each column: values, min, mean and max\n"
+  "Loads each log as analysis would, and prints its size and load rate\n";
+
+// Prints a column's values (not NAN), min, mean and max
+void summarize(const string &header, const double *column, size_t rows) {
+  size_t values = 0;
+  double min = INFINITY, max = -INFINITY, sum = 0;
+  for (size_t i = 0; i < rows; ++i) {
+    double value = column[i];
+    if (isnan(value))
+      continue;
+    ++values;
+    sum += value;
+    min = fmin(min, value);
+    max = fmax(max, value);
+  }
+
+  if (values)
+    printf("  %-32s %10zu %12g %12g %12g\n", header.c_str(), values, min,
+        sum / values, max);
+  else
+    printf("  %-32s %10zu\n", header.c_str(), values);
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = 0;
+  bool verbose = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "j:v")) != -1) {
+    switch (opt) {
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        printf(usage, *argv);
+        return -1;
+    }
+  }
+  if (optind == argc) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  int failures = 0;
+  double total_bytes = 0, total_seconds = 0;
+  for (int i = optind; i < argc; ++i) {
+    csv_load::Table table;
+    string error;
+    uint64_t start = stats::now_ns();
+    long rows = csv_load::load(argv[i], table, error, threads);
+    double seconds = (stats::now_ns() - start) / 1e9;
+    if (rows < 0) {
+      fprintf(stderr, "Failed to load %s\n", error.c_str());
+      ++failures;
+      continue;
+    }
+
+    struct stat st;
+    double bytes = stat(argv[i], &st) == 0 ? st.st_size : 0;
+    total_bytes += bytes;
+    total_seconds += seconds;
+
+    printf("%s: %zu columns, %ld rows, %.1f MB in %.3f s (%.2f GB/s)\n",
+        argv[i], table.headers.size(), rows, bytes / 1e6, seconds,
+        bytes / seconds / 1e9);
+    if (verbose) {
+      printf("  %-32s %10s %12s %12s %12s\n", "Column", "Values", "Min",
+          "Mean", "Max");
+      for (size_t c = 0; c < table.headers.size(); ++c)
+        summarize(table.headers[c], table.columns[c].get(), table.rows);
+    }
+  }
+
+  if (argc - optind > 1 && total_seconds > 0)
+    printf("%d logs, %.1f MB in %.3f s (%.2f GB/s)\n", argc - optind - failures,
+        total_bytes / 1e6, total_seconds, total_bytes / total_seconds / 1e9);
+  return failures ? 1 : 0;
+}
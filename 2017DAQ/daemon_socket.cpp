@@ -0,0 +1,114 @@
+#include "daemon_socket.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace daemon_socket {
+namespace {
+// Opens a socket on the first address that works, connecting or binding it
+int open_socket(const char *host, const char *port, bool server) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = server ? AI_PASSIVE : 0;
+
+  addrinfo *addrs;
+  if (getaddrinfo(host, port, &hints, &addrs) != 0)
+    return -1;
+
+  int fd = -1;
+  for (addrinfo *a = addrs; a && fd < 0; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0)
+      continue;
+
+    int one = 1;
+    bool ok;
+    if (server) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      ok = bind(fd, a->ai_addr, a->ai_addrlen) == 0 && listen(fd, 16) == 0;
+    } else {
+      // Commands are small, don't let Nagle hold them back (as the library)
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      ok = connect(fd, a->ai_addr, a->ai_addrlen) == 0;
+    }
+    if (!ok) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  freeaddrinfo(addrs);
+  return fd;
+}
+}  // anonymous namespace
+
+int connect_to(const char *host, const char *port) {
+  return open_socket(host, port, false);
+}
+
+int listen_on(const char *port) {
+  return open_socket(nullptr, port, true);
+}
+
+bool send_all(int fd, const void *buf, size_t len) {
+  const char *p = (const char *) buf;
+  while (len) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool recv_all(int fd, void *buf, size_t len) {
+  char *p = (char *) buf;
+  while (len) {
+    ssize_t n = recv(fd, p, len, 0);
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+int32_t command(int fd, uint32_t cmd, uint32_t p1, uint32_t p2,
+    const void *ext, uint32_t ext_len, void *reply, uint32_t reply_len) {
+  // Header and extension go out together, as one segment
+  char buf[sizeof(Header) + 256];
+  Header header = {cmd, p1, p2, ext_len};
+  if (ext_len > sizeof(buf) - sizeof(header))
+    return INT32_MIN;
+  memcpy(buf, &header, sizeof(header));
+  if (ext_len)
+    memcpy(buf + sizeof(header), ext, ext_len);
+  if (!send_all(fd, buf, sizeof(header) + ext_len) ||
+      !recv_all(fd, &header, sizeof(header)))
+    return INT32_MIN;
+
+  int32_t result = (int32_t) header.p3;
+  if (result <= 0 || !reply)
+    return result;
+
+  // Data follows for the commands that return it
+  uint32_t kept = std::min((uint32_t) result, reply_len);
+  if (!recv_all(fd, reply, kept))
+    return INT32_MIN;
+  for (uint32_t left = result - kept; left; ) {
+    uint32_t n = std::min(left, (uint32_t) sizeof(buf));
+    if (!recv_all(fd, buf, n))
+      return INT32_MIN;
+    left -= n;
+  }
+  return result;
+}
+}  // namespace daemon_socket
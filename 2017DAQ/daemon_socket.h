@@ -0,0 +1,38 @@
+#ifndef DAEMON_SOCKET_H_
+#define DAEMON_SOCKET_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// pigpiod's socket protocol, beneath libpigpiod_if2. A command is four
+// little-endian words: cmd, p1, p2 and p3, where p3 is the length of any
+// extension bytes that follow. The reply is the same four words with the
+// result in place of p3, followed by result bytes of data for commands that
+// return data (e.g. spi_xfer and i2c_zip). Each connection carries one
+// command at a time.
+namespace daemon_socket {
+const char *const kDefaultPort = "8888";
+
+struct Header {
+  uint32_t cmd, p1, p2, p3;
+};
+
+// Connects to a daemon, returns the socket or -1 (with errno set)
+int connect_to(const char *host, const char *port);
+// Listens on port on every interface, returns the socket or -1
+int listen_on(const char *port);
+
+// Blocking full-length send and receive, false if the connection ended
+bool send_all(int fd, const void *buf, size_t len);
+bool recv_all(int fd, void *buf, size_t len);
+
+// One command round trip. Sends ext_len bytes of ext after the header. For
+// commands that return data, pass reply: up to reply_len bytes of the data
+// are read into it, and the rest discarded. Returns the result, or INT32_MIN
+// if the connection failed.
+int32_t command(int fd, uint32_t cmd, uint32_t p1, uint32_t p2,
+    const void *ext = nullptr, uint32_t ext_len = 0, void *reply = nullptr,
+    uint32_t reply_len = 0);
+}  // namespace daemon_socket
+
+#endif  // DAEMON_SOCKET_H_
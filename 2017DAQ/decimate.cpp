@@ -0,0 +1,43 @@
+#include "decimate.h"
+
+#include "adc.h"
+#include "util.h"
+
+namespace decimate {
+namespace {
+// Every channel reads once, the driver's -o oversamples the noisy ones
+unsigned ratios[calib::NUM_CHANNELS] = {
+  1, 1,     // FL_HAL, FR_HAL
+  1, 1,     // F_BRAKE, R_BRAKE
+  1,        // STEERING
+  1, 1,     // FL_SUS, FR_SUS
+  1,        // N.C.
+  1, 1,     // R_HAL, RPM_TACH
+  1, 1,     // RL_SUS, RR_SUS
+  1,        // BATTERY
+};
+}  // anonymous namespace
+
+void set_ratio(calib::Channel ch, unsigned ratio) {
+  print_assert("Decimation ratio outside of [1, kMaxRatio]",
+      ratio >= 1 && ratio <= kMaxRatio);
+  ratios[(int) ch] = ratio < 1 ? 1 : (ratio > kMaxRatio ? kMaxRatio : ratio);
+}
+
+unsigned get_ratio(calib::Channel ch) {
+  return ratios[(int) ch];
+}
+
+float read(calib::Channel ch) {
+  // 4th bit of a channel is its chip
+  adc::ChipSelect cs = (adc::ChipSelect) ((ch & 0x8) >> 3);
+  char adc_ch = ch & 0x7;
+
+  uint16_t counts[kMaxRatio];
+  unsigned ratio = ratios[(int) ch];
+  for (unsigned i = 0; i < ratio; ++i)
+    counts[i] = adc::get(cs, adc_ch);
+
+  return mean(counts, ratio);
+}
+}  // namespace decimate
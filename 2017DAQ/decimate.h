@@ -0,0 +1,33 @@
+#ifndef DECIMATE_H_
+#define DECIMATE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "calib.h"
+
+// Oversampling and decimation of ADC channels. Each output sample is the mean
+// of ratio back to back reads (a boxcar, or first order CIC, filter), so white
+// noise drops by sqrt(ratio), about half a bit of resolution per doubling of
+// the ratio, at the cost of ratio daemon round trips per sample.
+namespace decimate {
+const unsigned kMaxRatio = 64;  // Sums of 10-bit counts stay in 16 bits
+
+// Reads per output sample of a channel, 1 disables oversampling
+void set_ratio(calib::Channel ch, unsigned ratio);
+unsigned get_ratio(calib::Channel ch);
+
+// Reads a channel ratio times and returns the mean count, convert it with
+// calib::convert(ch, float)
+float read(calib::Channel ch);
+
+// Mean of n counts
+inline float mean(const uint16_t *counts, size_t n) {
+  unsigned sum = 0;
+  for (size_t i = 0; i < n; ++i)
+    sum += counts[i];
+  return (float) sum / n;
+}
+}  // namespace decimate
+
+#endif  // DECIMATE_H_
@@ -0,0 +1,116 @@
+#include "decimate.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+
+#include "adc.h"
+#include "calib.h"
+#include "sim_devices.h"
+#include "sim_pigpio.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [noise in counts] [round trip in us] "
+  "[samples per ratio]\n";
+
+const calib::Channel kChannel = calib::F_BRAKE;
+
+double now_us() {
+  return chrono::duration<double, micro>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CPU time of this thread, excludes time blocked on the simulated daemon
+double cpu_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 4) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  double noise = argc > 1 ? strtod(argv[1], nullptr) : 1.5;
+  sim::Timing timing;
+  timing.round_trip_us = argc > 2 ? strtod(argv[2], nullptr) : 100;
+  int samples = argc > 3 ? atoi(argv[3]) : 500;
+
+  sim::Mcp3008 chips[2];
+  sim::attach_spi(0, &chips[0]);
+  sim::attach_spi(1, &chips[1]);
+  calib::init();
+  adc::init();
+  adc::begin();
+
+  // Without noise every count must read back exactly
+  for (int count = 0; count < calib::kNumCounts; ++count) {
+    chips[0].set_input(kChannel & 0x7, count);
+    if (adc::get(adc::CS0, kChannel & 0x7) != count) {
+      fprintf(stderr, "Count %d read back as %d\n", count,
+          adc::get(adc::CS0, kChannel & 0x7));
+      return 1;
+    }
+  }
+
+  sim::set_timing(timing);
+  chips[0].set_noise(noise);
+  printf("Simulated noise %.2f counts rms, round trip %.0f us, %d samples\n",
+      noise, timing.round_trip_us, samples);
+  printf("%5s %10s %8s %14s %14s %16s\n", "ratio", "rms error", "ENOB",
+      "cpu us/sample", "wall us/sample", "daemon calls");
+
+  // Ideal 10-bit quantization has 1/sqrt(12) counts rms error
+  const double kIdealRms = 1 / sqrt(12.0);
+  mt19937 rng(1);
+  uniform_real_distribution<double> input(50, calib::kNumCounts - 50);
+
+  for (unsigned ratio = 1; ratio <= decimate::kMaxRatio; ratio *= 2) {
+    decimate::set_ratio(kChannel, ratio);
+    double sq_err = 0, cpu = 0, wall = 0;
+    sim::reset_counters();
+
+    for (int i = 0; i < samples; ++i) {
+      // A fresh input per sample keeps quantization error uncorrelated
+      double x = input(rng);
+      chips[0].set_input(kChannel & 0x7, x);
+
+      double cpu_start = cpu_us(), wall_start = now_us();
+      float y = decimate::read(kChannel);
+      cpu += cpu_us() - cpu_start;
+      wall += now_us() - wall_start;
+
+      sq_err += (y - x) * (y - x);
+    }
+
+    double rms = sqrt(sq_err / samples);
+    printf("%5u %10.4f %8.2f %14.2f %14.1f %16.1f\n", ratio, rms,
+        10 - log2(rms / kIdealRms), cpu / samples, wall / samples,
+        (double) sim::counters().calls / samples);
+  }
+
+  // The filter and conversion alone, on counts already read
+  const int kReps = 100000;
+  uint16_t counts[decimate::kMaxRatio];
+  for (uint16_t &c : counts)
+    c = 512 + rng() % 7;
+  volatile float sink = 0;
+  double start = now_us();
+  for (int i = 0; i < kReps; ++i) {
+    counts[i % decimate::kMaxRatio] ^= 1;
+    sink = calib::convert(kChannel, decimate::mean(counts, 16));
+  }
+  (void) sink;
+  printf("mean of 16 + interpolated convert: %.1f ns\n",
+      (now_us() - start) * 1e3 / kReps);
+
+  adc::end();
+  adc::close();
+  return 0;
+}
@@ -1,9 +1,14 @@
 #include "display.h"
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <thread>
 
+#include "stats.h"
+#include "trace.h"
 #include "util.h"
 
 namespace {
@@ -63,16 +68,130 @@ const unsigned int dig2seg[] = {
 
 // SPI Constants
 const unsigned BAUD_RATE = 10000000;  // 10MHz
-// 32 bits per word, and using auxillary device (SPI1)
-const unsigned SPI_FLAGS = (32 << 16) | (1 << 8);
+// 32 bits per word, using auxillary device (SPI1), and leaving CE2 (GPIO 16)
+// unreserved for the bit-banged I2C bus (see i2c_bus.h)
+const unsigned SPI_FLAGS = (32 << 16) | (1 << 8) | (1 << 7);
 
 // pigpiod handles
 int pi = -1;
 int spi = -1;
+int script = -1;  // Latch script id
+
+display::Latch latch = display::LATCH_SCRIPT;
+
+// Mailbox for the display thread, holds the latest update packed as
+// mph (bits [0, 32)), rpm (clamped, [32, 48)) and status ([48, 63)).
+// The MSB marks a post, nothing is shown until the first one.
+const uint64_t kPosted = 1ull << 63;
+std::atomic<uint64_t> mailbox(0);
+
+std::atomic<double> refresh_hz(display::kDefaultRefreshHz);
+std::atomic<bool> running(false);
+std::thread display_thread;
+std::atomic<unsigned long> written(0), skipped(0);
+
+// Stores the latch sequence (LE pulse, then OE low) as a daemon script.
+// Script parameters can't be fed to an SPI write as bytes, so the frame itself
+// still goes out with spi_write. Returns false if the daemon refused it.
+bool store_latch_script() {
+  char text[64];
+  snprintf(text, sizeof(text), "w %u 1 w %u 0 w %u 0", LE, LE, OE);
+  script = store_script(pi, text);
+  if (script < 0)
+    return false;
+
+  // The script is usable once the daemon has finished initing it
+  uint32_t params[10];
+  int status;
+  while ((status = script_status(pi, script, params)) == PI_SCRIPT_INITING)
+    time_sleep(0.001);
+  return status >= 0;
+}
+
+// Latches a channels word onto the display
+void write(uint32_t channels) {
+  STATS_SCOPE("display.frame");
+  TRACE_SCOPE("display.frame");
+  // Turn off display before update
+  if (latch == display::LATCH_GPIO)
+    assert_success(gpio_write(pi, OE, PI_HIGH));
+  else
+    assert_success(set_bank_1(pi, 1 << OE));
+
+  // DEBUG
+  // fprintf(stdout, "Channels: 0x%08X\n", channels);
+  assert_success(spi_write(pi, spi, (char *) &channels, 4));
+
+  switch (latch) {
+    case display::LATCH_GPIO:
+      assert_success(gpio_write(pi, LE, PI_HIGH));  // Signal end of comm
+      assert_success(gpio_write(pi, LE, PI_LOW));
+      assert_success(gpio_write(pi, OE, PI_LOW));  // Turn display back on
+      break;
+    case display::LATCH_BANK:
+      assert_success(set_bank_1(pi, 1 << LE));  // Signal end of comm
+      // End comm and turn display back on together
+      assert_success(clear_bank_1(pi, 1 << LE | 1 << OE));
+      break;
+    case display::LATCH_SCRIPT:
+      // Runs in the daemon after this returns, it's done long before the next
+      // frame
+      assert_success(run_script(pi, script, 0, nullptr));
+      break;
+  }
+}
+
+// Display thread, shows the latest post once per refresh period, and only
+// writes when the channels change
+void refresh() {
+  TRACE_THREAD("display");
+  using clock = std::chrono::steady_clock;
+  auto next = clock::now();
+  uint32_t last = 0;
+  bool shown = false;
+
+  while (running) {
+    next += std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1 / refresh_hz));
+    std::this_thread::sleep_until(next);
+
+    uint64_t post = mailbox;
+    if (!(post & kPosted))
+      continue;
+
+    uint32_t channels = display::encode((post >> 32) & 0xFFFF,
+        post & 0xFFFFFFFF, (post >> 48) & 0x7FFF);
+    if (shown && channels == last) {
+      ++skipped;
+      continue;
+    }
+
+    write(channels);
+    last = channels;
+    shown = true;
+    ++written;
+  }
+}
 }  // anonynous namespace
 
 namespace display {
 
+void set_latch(Latch l) {
+  print_assert("Attempting to change latch while the display is running, "
+      "call end() first", !running);
+  latch = l;
+}
+
+Latch get_latch() {
+  return latch;
+}
+
+void set_refresh_hz(double hz) {
+  print_assert("Display refresh rate must be positive", hz > 0);
+  if (hz > 0)
+    refresh_hz = hz;
+}
+
 void init() {
   // Only make a connection if one does not already exist
   if (pi <= 0) {
@@ -89,12 +208,31 @@ void begin() {
 
   // Turn display off by default
   assert_success(gpio_write(pi, OE, PI_HIGH));
+
+  if (latch == LATCH_SCRIPT && script < 0 && !store_latch_script()) {
+    fprintf(stderr, "\n[%s:%d] Error: Daemon refused the display latch "
+        "script, using bank writes\n", __FILE__, __LINE__);
+    latch = LATCH_BANK;
+  }
+
+  if (!running) {
+    running = true;
+    display_thread = std::thread(&refresh);
+  }
 }
 
 void update(unsigned int rpm, unsigned int mph, unsigned int status_flags) {
   print_assert("Warning Flags out of acceptable range",
         status_flags < STATUS_UNKNOWN);
 
+  // Past the 12th led rpm makes no difference, so it fits in 16 bits
+  uint64_t clamped_rpm = rpm > 0xFFFF ? 0xFFFF : rpm;
+  mailbox = kPosted | (uint64_t) (status_flags & 0x7FFF) << 48 |
+    clamped_rpm << 32 | mph;
+}
+
+uint32_t encode(unsigned int rpm, unsigned int mph,
+    unsigned int status_flags) {
   // BUILD BIT REPRESENTATION OF CHANNELS
   uint32_t channels;
 
@@ -118,21 +256,27 @@ void update(unsigned int rpm, unsigned int mph, unsigned int status_flags) {
     channels |= dig2seg[divmod.quot] << SHIFT_7SEG10;
   channels |= dig2seg[divmod.rem] << SHIFT_7SEG1;
 
-  // UPDATE DISPLAY
-  // Turn off display before update
-  assert_success(gpio_write(pi, OE, PI_HIGH));
-
-  // DEBUG
-  // fprintf(stdout, "Channels: 0x%08X\n", channels);
-  assert_success(spi_write(pi, spi, (char *) &channels, 4));
+  return channels;
+}
 
-  assert_success(gpio_write(pi, LE, PI_HIGH));  // Signal end of comm
-  assert_success(gpio_write(pi, LE, PI_LOW));
+unsigned long frames_written() {
+  return written;
+}
 
-  assert_success(gpio_write(pi, OE, PI_LOW));  // Turn display back on
+unsigned long frames_skipped() {
+  return skipped;
 }
 
 void end() {
+  if (running) {
+    running = false;
+    display_thread.join();
+  }
+  if (script >= 0) {
+    assert_success(delete_script(pi, script));
+    script = -1;
+  }
+
   assert_success(gpio_write(pi, OE, PI_HIGH));
   if (spi >= 0) {
     assert_success(spi_close(pi, spi));
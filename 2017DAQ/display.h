@@ -1,6 +1,7 @@
 #ifndef DISPLAY_H_
 #define DISPLAY_H_
 
+#include <cstdint>
 #include <mutex>
 
 namespace display {
@@ -16,18 +17,46 @@ const unsigned int STATUS_UNKNOWN     = 1 << 4;
 // Should be called once before begin
 void init();
 
-// Sets up pins and turns display state off
+// How a frame is latched after its SPI write
+enum Latch {
+  LATCH_GPIO,    // A gpio_write per pin change, 5 daemon calls per frame
+  LATCH_BANK,    // Pin changes combined into bank writes, 4 calls per frame
+  LATCH_SCRIPT,  // Latch sequence in a stored daemon script, 3 per frame
+};
+
+// Sets how frames are latched, call before begin(). Defaults to LATCH_SCRIPT,
+// which falls back to LATCH_BANK if the daemon won't store the script.
+void set_latch(Latch latch);
+Latch get_latch();
+
+// Default rate the display thread refreshes at, faster than anyone can read
+const double kDefaultRefreshHz = 30;
+
+// Sets the display thread's refresh rate, takes effect on the next frame
+void set_refresh_hz(double hz);
+
+// Sets up pins, turns display state off, and starts the display thread
 // Should be called once before update
 void begin();
 
-// Update method updates the display with new information
+// Update method posts new information for the display thread to show on its
+// next refresh. Only the latest post is shown, so it never blocks on the
+// display's I/O.
 // rpm the rpm to update, must be positive
 // mph the mph to update, must be positive
 // status_flags use combination of constants defined above such as
 //               WARNING_TEMP | INFO_BRAKE
 void update(unsigned int rpm, unsigned int mph, unsigned int status_flags);
 
-// Ensures display state is off
+// Bit representation of the display's channels (see channel map in
+// display.cpp) for the given information
+uint32_t encode(unsigned int rpm, unsigned int mph, unsigned int status_flags);
+
+// Frames the display thread wrote, and skipped for being unchanged
+unsigned long frames_written();
+unsigned long frames_skipped();
+
+// Stops the display thread and ensures display state is off
 // Should be called before close
 void end();
 
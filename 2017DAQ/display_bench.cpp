@@ -0,0 +1,107 @@
+#include "display.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "sim_pigpio.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [round trip in us] [frames]\n";
+
+// Pins from display.cpp
+const unsigned kLE = 13, kOE = 6;
+
+// Captures the frame shifted into the display's drivers
+class Capture : public sim::SpiDevice {
+ public:
+  void xfer(uint8_t *buf, unsigned len) override {
+    if (len == 4)
+      memcpy(&word, buf, 4);
+  }
+  uint32_t word = 0;
+};
+
+double now_us() {
+  return chrono::duration<double, micro>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Waits for the display thread to write a frame past written
+void wait_written(unsigned long written) {
+  while (display::frames_written() <= written)
+    sim::wait_us(10);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 3) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  sim::Timing timing;
+  timing.round_trip_us = argc > 1 ? strtod(argv[1], nullptr) : 150;
+  int frames = argc > 2 ? atoi(argv[2]) : 200;
+  sim::set_timing(timing);
+
+  Capture capture;
+  sim::attach_spi(0, &capture);
+
+  // Fast enough that the thread is never what's waited on
+  display::set_refresh_hz(1e5);
+  display::init();
+
+  printf("Simulated round trip %.0f us, %d frames\n", timing.round_trip_us,
+      frames);
+
+  const struct { display::Latch latch; const char *name; } kModes[] = {
+    {display::LATCH_GPIO, "gpio writes"},
+    {display::LATCH_BANK, "bank writes"},
+    {display::LATCH_SCRIPT, "latch script"},
+  };
+
+  for (const auto &mode : kModes) {
+    display::set_latch(mode.latch);
+    display::begin();
+
+    double elapsed = 0;
+    sim::reset_counters();
+    for (int i = 0; i < frames; ++i) {
+      unsigned long written = display::frames_written();
+      unsigned rpm = i % 3800, mph = i % 100;
+      double start = now_us();
+      display::update(rpm, mph, display::STATUS_NONE);
+      wait_written(written);
+      elapsed += now_us() - start;
+
+      uint32_t levels = sim::levels();
+      if (capture.word != display::encode(rpm, mph, display::STATUS_NONE) ||
+          (levels >> kLE & 1) || (levels >> kOE & 1)) {
+        fprintf(stderr, "%s: frame %d not latched\n", mode.name, i);
+        return 1;
+      }
+    }
+
+    printf("%-14s %6.2f daemon calls/frame %8.1f us/frame\n", mode.name,
+        (double) sim::counters().calls / frames, elapsed / frames);
+    display::end();
+  }
+
+  // Unchanged frames are skipped entirely
+  display::set_latch(display::LATCH_SCRIPT);
+  display::begin();
+  display::update(1000, 42, display::INFO_BRAKE);
+  wait_written(display::frames_written());
+  sim::reset_counters();
+  unsigned long skipped = display::frames_skipped();
+  display::set_refresh_hz(1000);
+  sim::wait_us(100000);
+  printf("Same frame for 100ms at 1kHz: %lu skipped, %lu daemon calls\n",
+      display::frames_skipped() - skipped, sim::counters().calls);
+
+  display::end();
+  display::close();
+  return 0;
+}
@@ -1,212 +1,102 @@
 #include <atomic>
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <csignal>
+#include <fstream>
 #include <iostream>
-#include <memory>
-#include <sys/time.h>
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <thread>
-#include <tuple>
 #include <unistd.h>
-#include <vector>
 
 #include <pigpiod_if2.h>
 
-#include "csv.h"
+#include "acquire.h"
+#include "alloc_hooks.h"
+#include "calib.h"
+#include "can_telemetry.h"
+#include "clock_sync.h"
+#include "decimate.h"
 #include "display.h"
+#include "event_loop.h"
+#include "rt.h"
 #include "sensors.h"
+#include "stats.h"
+#include "timebase.h"
+#include "trace.h"
 
 using namespace std;
-using namespace sensors;
-
-const float kCvtWarnTempF = 200;
-const float kLowBatteryVoltage = 11.1;
-const unsigned kMaxFileNum = 9999;
-const char *kFilenameFormat = "/home/pi/DAQ/RECORD_%04d.csv";
-// Path and prefix + number + extension + null byte.
-const unsigned kFilenameLen = 20 + 4 + 4 + 1;
-const char *kCsvHeaders[] = {
-  "Time (s)",
-  "Accelerometer X",
-  "Accelerometer Y",
-  "Acceleroemter Z",
-  "Ambient Temp",
-  // Sensors needed for Display.
-  "CVT Temp",
-  "Rear HAL",
-  "Tachometer",
-  "Battery Voltage",
-  // Testing Only from this point forward [9-21).
-  "Front Right HAL",
-  "Front Left HAL",
-  "Front Breakline Pressure",
-  "Rear Breakline Pressure",
-  "Steering Angle",
-  "Front Right Suspension Travel",
-  "Front Left Suspension Travel",
-  "Rear Right Suspension Travel",
-  "Rear Left Suspension Travel",
-  "Front Right Rotor Temp",
-  "Front Left Rotor Temp",
-  "Rear Rotor Temp",
-};
-const unsigned kTestingStartPos = 9;
-const unsigned kHeadersLen = 21;
-
-// When set to true, display updates don't happen, and display stays locked.
-atomic<bool> display_locked(false);
-// Thread pointer for thread that unlocks display after a timeout.
-pthread_t *display_unlock_thread = nullptr;
+
+// Timeline written by make TRACE=1 builds, on exit and on SIGUSR1
+const char *kTraceFilename = "/home/pi/DAQ/trace.json";
+
+// Control plane: timers, signals and requests from other threads are all
+// handled by this loop on the main thread.
+EventLoop events;
+// Unlocks the display after a timeout.
+int display_unlock_timer = -1;
 
 // Displays a file number instead of mph for timeout_seconds
 void display_file_num(unsigned file_num, double timeout_seconds) {
   // Lock display, and update with file num.
-  display_locked = true;
+  acquire::lock_display(true);
   display::update(0, file_num, display::INFO_DATA_LOGGING);
 
-  stop_thread(display_unlock_thread);  // Stops thread if already active.
-
-  // Allocate storage for timeout on heap
-  double *timeout = new double;
-  *timeout = timeout_seconds;
-  
-  // Passes timeout into the thread, which takes ownership of the pointer.
-  display_unlock_thread = start_thread([](void *data) -> void * {
-        unique_ptr<double> timeout((double *) data);  // Takes ownership.
-
-        time_sleep(*timeout);    // Wait for timeout.
-        display_locked = false;  // Unlock display.
-
-        return nullptr;
-      }, (void *) timeout);
+  // Restarts the timeout if one is already pending.
+  events.arm(display_unlock_timer, timeout_seconds);
 }
 
-// Holds Csv object.
-unique_ptr<Csv> csv;
-
-// Opens a CSV, optionally in testing mode, with next avail file number.
-// Returns the file number used (if greater than kMaxFileNum,
-//  then no file was opened).
-unsigned OpenCsv(bool testing) {
-  struct stat buffer;
-  char filename[kFilenameLen];
-  unsigned file_num;
-
-  // Try generating filenames until the file is available.
-  for (file_num = 0; file_num <= kMaxFileNum; ++file_num) {
-    snprintf(filename, kFilenameLen, kFilenameFormat, file_num);
-
-    // If an error occurs while stat'ing the file, then it doesn't exist.
-    if (stat(filename, &buffer) == -1)
-      break;
-  }
-
-  // If no file is available, don't open a file.
-  if (file_num > kMaxFileNum)
-    return file_num;
-
-  csv.reset(new Csv(filename,
-        testing ?
-        // If testing, use all headers.
-        vector<const char *>(kCsvHeaders, kCsvHeaders + kHeadersLen) :
-        // Otherwise, use only the headers up until the testing headers.
-        vector<const char *>(kCsvHeaders, kCsvHeaders + kTestingStartPos)));
+// While true, acquisition loop runs.
+atomic<bool> run(true);
+// Minimum time between loop starts.
+const double kPeriodSeconds = 0;
 
-  display_file_num(file_num, 1.5);
+// Real-time mode, off by default.
+int rt_priority = 0;       // SCHED_FIFO priority of the acquisition thread.
+int rt_cpu = rt::kNoCpu;   // Core for the acquisition thread alone.
+bool rt_lock = false;      // Lock and prefault memory.
 
-  return file_num;
+// Reports a refused real-time setting, the driver runs on without it.
+void check_rt(const char *what, int err) {
+  if (err)
+    cerr << "Real-time: " << what << " refused: " << strerror(err) << endl;
 }
 
-// Closes the csv if its open.
-void CloseCsv(unsigned file_num) {
-  if (csv) {
-    csv.reset();
-    display_file_num(file_num, 1.5);
-  }
-}
-
-// Testing is true if the last opened csv was in testing mode.
-// File_num is the file_num of the last opened csv.
-// Tv_start is the time the csv was last opened.
-void loop(bool &testing, int &file_num, struct timeval &tv_start) {
-  // If daq switch is on, and csv is not open, open it.
-  if (is_daq() && !csv) {
-    // If not nan, then testing sensors are attached (store state in testing).
-    file_num = OpenCsv((testing = !isnan(front_right_rotor_temp())));
-    gettimeofday(&tv_start, nullptr);
-  } else if (!is_daq() && csv) {
-    CloseCsv(file_num);
-  }
-
-  // If logging, these values always get logged.
-  if (csv) {
-    struct timeval tv_now;
-    gettimeofday(&tv_now, nullptr);
-    uint64_t time_usec = (tv_now.tv_sec - tv_start.tv_sec) * 1000000 +
-                          tv_now.tv_usec - tv_start.tv_usec;
-
-    auto acc_xyz = accelXYZ();
-    (*csv) << time_usec << get<0>(acc_xyz) << get<1>(acc_xyz)
-      << get<2>(acc_xyz) << amb_temp();
-  }
-
-  // Readings for display (also needed for logging).
-  float cvt = cvt_temp();
-  float mph = rear_hal();
-  float rpm = rpm_tach();
-  float bat_voltage = battery_voltage();
-
-  // Only update display when not locked.
-  if (!display_locked) {
-    unsigned status = display::STATUS_NONE;
-    if (cvt >= kCvtWarnTempF)
-      status |= display::WARNING_TEMP;
-    if (bat_voltage <= kLowBatteryVoltage)
-      status |= display::WARNING_BATTERY;
-    if (is_brake())
-      status |= display::INFO_BRAKE;
-    if (csv)
-      status |= display::INFO_DATA_LOGGING;
-
-    display::update(rpm, mph, status);
-  }
-
-  // Log display values, and sometimes more
-  if (csv) {
-    (*csv) << cvt << mph << rpm << bat_voltage;
-    if (testing) {
-      (*csv) << front_right_hal() << front_left_hal()
-        << front_brake_line_pressure() << rear_brake_line_pressure()
-        << steering_angle()
-        << front_right_suspension() << front_left_suspension()
-        << rear_right_suspension() << rear_left_suspension()
-        << front_right_rotor_temp() << front_left_rotor_temp()
-        << rear_rotor_temp();
-    }
-    (*csv) << Csv::LINE_BREAK;
-  }
+// Multiple nodes: a primary answers clock sync requests, a secondary syncs to
+// it and times its logs on the primary's clock, so merge_logs can merge them.
+bool sync_primary = false;
+const char *sync_primary_host = nullptr;  // Set on a secondary
+clock_sync::Client sync_client;
+const double kSyncSeconds = 0.2;       // Between requests
+const double kSyncWaitSeconds = 10;    // For the first sync, before logging
+
+// Live telemetry to the car's other modules over a CAN interface, off without
+// one.
+const char *can_interface = nullptr;
+const char *can_map_filename = nullptr;  // The default ID map without one
+
+// Loops run, for the periodic rate report.
+atomic<unsigned long> loops(0);
+// Heap allocations by those loops, counted in make ALLOCS=1 builds.
+atomic<unsigned long> loop_allocs(0);
+const double kReportSeconds = 60;
+
+// Writes the trace timeline, reporting how much went out.
+void dump_trace() {
+  long spans = trace::dump(kTraceFilename);
+  if (spans < 0)
+    cerr << "Failed to write " << kTraceFilename << endl;
+  else
+    cout << "Trace: " << spans << " spans written to " << kTraceFilename
+      << endl;
 }
 
-// States for shutdown procedures.
-atomic<bool> run(true);             // While true, main loop runs.
-atomic<bool> done(false);           // Set to true when main loop exits.
-atomic<bool> wait_on_done(false);   // True if main loop should wait on exit.
-
 // Logic for shutting down the pi. Replaces this process with sudo executing
-// shutdown.
+// shutdown, so only returns on failure.
 const char *shutdown_args[] = {"/usr/bin/sudo", "shutdown", "now", nullptr};
 void shutdown() {
-  // Indiciate to main thread to wait when finished, instead of exiting.
-  // Allows shutdown command to execute before process exits.
-  wait_on_done = true;
-
-  // Stop the main loop, and wait for it to finish.
-  run = false;
-  while (!done)
-    this_thread::yield();
+  // sudo and shutdown inherit the mask, SIGINT and SIGTERM must reach them
+  events.restore_signals();
 
   // NOTE: This const cast is generally considered acceptable seeing as
   //       execv predates const and doesn't actually edit it's arguments.
@@ -215,9 +105,6 @@ void shutdown() {
 
   // If execv returns, there was a failure.
   cerr << "Failed to shutdown Pi" << endl;
-
-  // On failure, allow program to exit properly.
-  wait_on_done = false;
 }
 
 int main(int argc, char **argv) {
@@ -225,48 +112,219 @@ int main(int argc, char **argv) {
   cout << "Driver Started" << endl;
   cerr << "Driver Started" << endl;
 
-  const double kPeriodSeconds = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "regd:o:p:c:mSs:C:M:")) != -1) {
+    switch (opt) {
+      case 'r':  // Log raw ADC counts, convert with raw2csv
+        acquire::set_raw_mode(true);
+        break;
+      case 'e':  // Time hal and tach pulses on gpios
+        sensors::set_edge_timing(true);
+        break;
+      case 'g':  // Log brake and daq switch edges with each log
+        acquire::set_log_edges(true);
+        break;
+      case 'd':  // Display refresh rate in Hz
+        display::set_refresh_hz(strtod(optarg, nullptr));
+        break;
+      case 'o':  // Reads per brake and steering sample (see decimate.h)
+        for (calib::Channel ch : {calib::F_BRAKE, calib::R_BRAKE,
+            calib::STEERING})
+          decimate::set_ratio(ch, atoi(optarg));
+        break;
+      case 'p':  // SCHED_FIFO priority (1-99) for acquisition
+        rt_priority = atoi(optarg);
+        break;
+      case 'c':  // Core reserved for acquisition
+        rt_cpu = atoi(optarg);
+        break;
+      case 'm':  // Lock and prefault memory
+        rt_lock = true;
+        break;
+      case 'S':  // Primary node, serves clock sync
+        sync_primary = true;
+        break;
+      case 's':  // Secondary node, syncs to the primary at host
+        sync_primary_host = optarg;
+        break;
+      case 'C':  // CAN interface for live telemetry, e.g. can0
+        can_interface = optarg;
+        break;
+      case 'M':  // Its ID map (see can_telemetry.h)
+        can_map_filename = optarg;
+        break;
+      default:
+        cerr << "Usage: " << argv[0] << " [-r] [-e] [-g] [-d refresh_hz] "
+          "[-o oversampling] [-p priority] [-c cpu] [-m] "
+          "[-S | -s primary_host] [-C can_interface [-M can_map]]" << endl;
+        return 1;
+    }
+  }
+
+  // SIGINT and SIGTERM just stop, and close cleanly. Must come before any
+  // thread starts (including the daemon's), so they all inherit the mask.
+  events.signals({SIGINT, SIGTERM}, [](int) { events.stop(); });
+#ifdef DAQ_TRACE
+  events.signals({SIGUSR1}, [](int) { dump_trace(); });
+#endif  // DAQ_TRACE
+
+  display_unlock_timer = events.timer([]() {
+        acquire::lock_display(false);
+      });
+  acquire::on_log_change([](unsigned file_num) {
+        display_file_num(file_num, 1.5);
+      });
+
+  // The shutdown button stops, and shuts down once everything is closed.
+  bool shutdown_requested = false;
+  int shutdown_event = events.event([&shutdown_requested]() {
+        shutdown_requested = true;
+        events.stop();
+      });
+
+  if (sync_primary) {
+    int fd = clock_sync::serve_on();
+    if (fd < 0) {
+      cerr << "Failed to serve clock sync on port " << clock_sync::kDefaultPort
+        << endl;
+      return 1;
+    }
+    events.watch(fd, [fd]() { clock_sync::answer(fd); });
+  }
+  if (sync_primary_host) {
+    if (!sync_client.connect(sync_primary_host)) {
+      cerr << "Failed to reach primary " << sync_primary_host << endl;
+      return 1;
+    }
+    events.watch(sync_client.fd(), []() { sync_client.receive(); });
+    int sync_timer = events.timer([]() { sync_client.request(); });
+    events.arm(sync_timer, kSyncSeconds / 10, kSyncSeconds);
+    acquire::set_time_map([](uint64_t mono_ns) {
+          return sync_client.to_primary(mono_ns);
+        }, []() { return sync_client.synced(); });
+  }
 
-  // Catch SIGINT, and just exit the mainloop and close cleanly.
-  struct sigaction sig_int_handler;
-  sig_int_handler.sa_handler = [](int) { run = false; };  // Exit main loop.
-  sigemptyset(&sig_int_handler.sa_mask);
-  sig_int_handler.sa_flags = 0;
+  vector<can_telemetry::Message> can_map = can_telemetry::default_map();
+  if (can_map_filename) {
+    ifstream in(can_map_filename);
+    string error;
+    if (!in || !can_telemetry::parse_map(in, can_map, error)) {
+      cerr << "Bad CAN map " << can_map_filename << ": " << error << endl;
+      return 1;
+    }
+  }
+  // Acquisition only stores its readings, they go out from here
+  can_telemetry::Publisher can_publisher(can_map);
+  if (can_interface) {
+    if (!can_publisher.open(can_interface)) {
+      cerr << "Failed to open CAN interface " << can_interface << ": "
+        << strerror(errno) << endl;
+      return 1;
+    }
+    int can_timer = events.timer([&can_publisher]() {
+          float readings[acquire::NUM_READINGS];
+          for (int r = 0; r < acquire::NUM_READINGS; ++r)
+            readings[r] = acquire::reading((acquire::Reading) r);
+          can_publisher.publish(timebase::now_ns(), readings);
+        });
+    events.arm(can_timer, can_publisher.period_seconds(),
+        can_publisher.period_seconds());
+  }
 
-  sigaction(SIGINT, &sig_int_handler, nullptr);
+  int report_timer = events.timer([&can_publisher]() {
+        cout << "Loop rate: " << loops.exchange(0) / kReportSeconds << " Hz"
+          << endl;
+        if (sync_primary_host) {
+          clock_sync::Client::Estimate sync = sync_client.estimate();
+          cout << "Clock sync: offset " << sync.offset_ns / 1e3 << " us +-"
+            << sync.error_ns / 1e3 << " us, drift " << sync.drift * 1e6
+            << " ppm, " << sync.exchanges << " exchanges" << endl;
+        }
+        if (can_interface)
+          cout << "CAN: " << can_publisher.sent() << " frames sent, "
+            << can_publisher.dropped() << " dropped" << endl;
+#ifdef DAQ_STATS
+        stats::report(stderr);
+#endif  // DAQ_STATS
+#ifdef DAQ_ALLOCS
+        cout << "Allocations: " << loop_allocs.exchange(0) << " in loops, "
+          << alloc_hooks::total_count() << " since start" << endl;
+#endif  // DAQ_ALLOCS
+      });
+  events.arm(report_timer, kReportSeconds, kReportSeconds);
+
+  // Every thread from here on, but acquisition, stays off its core.
+  if (rt_cpu != rt::kNoCpu)
+    check_rt("keeping other threads off the acquisition cpu",
+        rt::avoid_cpu(rt_cpu));
+  if (rt_lock)
+    check_rt("locking memory", rt::lock_memory());
 
   display::init();
   sensors::init();
   display::begin();
   sensors::begin();
 
-  sensors::on_shutdown(&shutdown);
-
-  // For passing to loop by reference (can be edited).
-  bool testing;
-  int file_num;
-  struct timeval tv_start;
+  sensors::on_shutdown([shutdown_event]() { events.notify(shutdown_event); });
+
+  // Acquisition runs on its own thread, the control plane on this one.
+  thread acquisition([]() {
+        if (rt_priority > 0)
+          check_rt("SCHED_FIFO", rt::set_fifo(rt_priority));
+        if (rt_cpu != rt::kNoCpu)
+          check_rt("pinning acquisition", rt::pin_to_cpu(rt_cpu));
+        if (rt_lock)
+          rt::prefault_stack();
+        rt::report("Acquisition");
+        TRACE_THREAD("acquisition");
+
+        // Logs opened before the first sync would start on the wrong clock
+        if (sync_primary_host) {
+          double wait_start = time_time();
+          while (run && !sync_client.synced() &&
+              time_time() - wait_start < kSyncWaitSeconds)
+            time_sleep(0.01);
+          if (!sync_client.synced())
+            cerr << "No clock sync from " << sync_primary_host
+              << ", logs opened before it syncs stay on this node's clock"
+              << endl;
+        }
+
+        while (run) {
+          double loop_start = time_time();
+#ifdef DAQ_ALLOCS
+          unsigned long allocs = alloc_hooks::thread_count();
+          acquire::loop();
+          loop_allocs += alloc_hooks::thread_count() - allocs;
+#else
+          acquire::loop();
+#endif  // DAQ_ALLOCS
+          ++loops;
+          double loop_elapsed = time_time() - loop_start;
+
+          if (loop_elapsed < kPeriodSeconds)
+            time_sleep(kPeriodSeconds - loop_elapsed);
+        }
+
+        acquire::close_log();  // Close if open.
+      });
+
+  rt::report("Control");
+  events.run();
 
-  while (run) {
-    double loop_start = time_time();
-    loop(testing, file_num, tv_start);
-    double loop_elapsed = time_time() - loop_start;
-
-    if (loop_elapsed < kPeriodSeconds)
-      time_sleep(kPeriodSeconds - loop_elapsed);
-  }
-
-  CloseCsv(file_num);  // Close if open.
+  run = false;
+  acquisition.join();
+#ifdef DAQ_TRACE
+  dump_trace();
+#endif  // DAQ_TRACE
 
   display::end();
   sensors::end();
   display::close();
   sensors::close();
 
-  done = true;
-
-  while (wait_on_done)
-    this_thread::yield();
+  if (shutdown_requested)
+    shutdown();
 
   return 0;
 }
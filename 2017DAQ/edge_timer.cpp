@@ -0,0 +1,90 @@
+#include "edge_timer.h"
+
+#include <algorithm>
+
+#include <pigpiod_if2.h>
+
+#include "util.h"
+
+using namespace std;
+
+const unsigned EdgeTimer::kMaxWindow;
+
+EdgeTimer::EdgeTimer(unsigned gpio, unsigned window, uint32_t timeout_us)
+    : gpio_(gpio), window_(min(max(window, 2u), kMaxWindow)),
+      timeout_us_(timeout_us) {
+  print_assert("EdgeTimer window outside of [2, kMaxWindow]",
+      window >= 2 && window <= kMaxWindow);
+}
+
+EdgeTimer::~EdgeTimer() {
+  end();
+}
+
+void EdgeTimer::begin(int pi) {
+  if (cb_ >= 0)
+    return;
+
+  pi_ = pi;
+  assert_success(set_mode(pi_, gpio_, PI_INPUT));
+  assert_success(set_pull_up_down(pi_, gpio_, PI_PUD_DOWN));
+  cb_ = assert_success(callback_ex(pi_, gpio_, RISING_EDGE, &on_edge, this));
+}
+
+void EdgeTimer::end() {
+  if (cb_ >= 0) {
+    assert_success(callback_cancel(cb_));
+    assert_success(set_pull_up_down(pi_, gpio_, PI_PUD_OFF));
+    cb_ = -1;
+  }
+}
+
+void EdgeTimer::on_edge(int, unsigned, unsigned level, uint32_t tick,
+    void *self) {
+  // Levels other than high are watchdog timeouts
+  if (level == PI_HIGH)
+    static_cast<EdgeTimer *>(self)->edge(tick);
+}
+
+void EdgeTimer::edge(uint32_t tick) {
+  lock_guard<mutex> lock(mutex_);
+
+  // After a stop the old edges would stretch the first period, drop them
+  if (count_ > 0 &&
+      tick - ticks_[(head_ + window_ - 1) % window_] > timeout_us_)
+    count_ = 0;
+
+  ticks_[head_] = tick;
+  head_ = (head_ + 1) % window_;
+  if (count_ < window_)
+    ++count_;
+}
+
+double EdgeTimer::hz(uint32_t now) const {
+  lock_guard<mutex> lock(mutex_);
+  if (count_ == 0)
+    return 0;
+
+  uint32_t newest = ticks_[(head_ + window_ - 1) % window_];
+  uint32_t since = now - newest;
+  // An edge delivered after now was sampled would wrap to a huge since
+  if (since > (uint32_t) INT32_MAX)
+    since = 0;
+  if (since >= timeout_us_ || count_ < 2)
+    return 0;
+
+  uint32_t oldest = ticks_[(head_ + window_ - count_) % window_];
+  uint32_t span = newest - oldest;
+  if (span == 0)
+    return 0;
+  double res = (count_ - 1) * 1e6 / span;
+
+  // Still waiting on the next edge, so the period is at least since
+  if (since > 0)
+    res = min(res, 1e6 / since);
+  return res;
+}
+
+double EdgeTimer::hz() const {
+  return hz(get_current_tick(pi_));
+}
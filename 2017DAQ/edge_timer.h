@@ -0,0 +1,57 @@
+#ifndef EDGE_TIMER_H_
+#define EDGE_TIMER_H_
+
+#include <cstdint>
+#include <mutex>
+
+// Measures the frequency of pulses on a gpio from the daemon's edge callbacks,
+// timestamped with its 1us tick. The frequency is taken over a sliding window
+// of the last rising edges, so it updates on every pulse rather than after a
+// freq to voltage converter's smoothing, and resolves far finer than a 10-bit
+// ADC count.
+//
+// Tick differences are taken in uint32_t, so they stay correct across the
+// tick's wrap every ~71.6 minutes as long as no span is longer than that.
+class EdgeTimer {
+ public:
+  static const unsigned kMaxWindow = 32;
+
+  // window is the number of edges (at most kMaxWindow) the frequency spans.
+  // No edge for timeout_us reads as 0Hz.
+  explicit EdgeTimer(unsigned gpio, unsigned window = 8,
+      uint32_t timeout_us = 500000);
+  ~EdgeTimer();
+
+  EdgeTimer(const EdgeTimer &) = delete;
+  EdgeTimer &operator=(const EdgeTimer &) = delete;
+
+  // Attaches to the gpio's rising edges through the daemon connection pi
+  void begin(int pi);
+  void end();
+
+  // Records a rising edge, the callback calls this
+  void edge(uint32_t tick);
+
+  // Frequency in Hz as of tick now. Between edges it is bounded by the time
+  // since the last one, so it falls off promptly when the pulses stop.
+  double hz(uint32_t now) const;
+  // Frequency in Hz as of the daemon's current tick
+  double hz() const;
+
+  unsigned gpio() const { return gpio_; }
+
+ private:
+  static void on_edge(int pi, unsigned gpio, unsigned level, uint32_t tick,
+      void *self);
+
+  const unsigned gpio_, window_;
+  const uint32_t timeout_us_;
+  int pi_ = -1, cb_ = -1;
+
+  mutable std::mutex mutex_;  // GUARDS everything below
+  uint32_t ticks_[kMaxWindow];
+  unsigned head_ = 0;   // Next slot of ticks_
+  unsigned count_ = 0;  // Edges in ticks_, up to window_
+};
+
+#endif  // EDGE_TIMER_H_
@@ -0,0 +1,77 @@
+#include "edge_timer.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include <pigpiod_if2.h>
+
+#include "sim_devices.h"
+#include "sim_pigpio.h"
+#include "test.h"
+#include "util.h"
+
+// Runs against sim_pigpio, with a simulated edge generator on the gpio
+const unsigned kGpio = 26;
+const uint32_t kTimeoutUs = 500000;
+
+bool near(double a, double b, double tolerance) {
+  return fabs(a - b) <= tolerance * b;
+}
+
+int main(int argc, char **argv) {
+  // Edges fed directly, across the tick's wrap
+  {
+    EdgeTimer timer(kGpio, 8, kTimeoutUs);
+    uint32_t tick = 0xFFFFFF00;
+    for (int i = 0; i < 20; ++i, tick += 200)
+      timer.edge(tick);
+    uint32_t last = tick - 200;
+
+    test::check("5kHz across the wrap", timer.hz(last + 10) == 5000);
+    test::check("Bounded by the time since the last edge",
+        near(timer.hz(last + 1000), 1000, 1e-9));
+    test::check("Zero speed after the timeout",
+        timer.hz(last + kTimeoutUs) == 0);
+
+    // Restarting after a stop ignores the edges from before it
+    tick = last + 2 * kTimeoutUs;
+    timer.edge(tick);
+    test::check("One edge after a stop reads 0", timer.hz(tick) == 0);
+    timer.edge(tick + 10000);
+    test::check("Restart uses only new edges", timer.hz(tick + 10000) == 100);
+  }
+
+  // Simulated pulses through the daemon callbacks, wrapping 0.5s in
+  sim::set_tick_offset(-sim::tick() - 500000);
+  int pi = pigpio_start(nullptr, nullptr);
+  EdgeTimer timer(kGpio, 8, kTimeoutUs);
+  sim::EdgeGenerator generator(kGpio);
+  timer.begin(pi);
+
+  const double kHz = 123.4;
+  generator.set_hz(kHz);
+  time_sleep(1);
+  double hz = timer.hz();
+  printf("  %.4f Hz for %.1f Hz (one ADC count is %.2f Hz)\n", hz, kHz,
+      5000.0 / 1023);
+  test::check("Generated frequency across the wrap", near(hz, kHz, 1e-3));
+
+  // Time to settle after a step down, window/hz for the window to refill
+  generator.set_hz(40);
+  double start = time_time(), settled = -1;
+  while (time_time() - start < 1 && settled < 0) {
+    if (near(timer.hz(), 40, 0.01))
+      settled = time_time() - start;
+    time_sleep(0.001);
+  }
+  printf("  Settled on a step to 40Hz in %.0f ms\n", settled * 1e3);
+  test::check("Follows a step", settled >= 0 && settled < 0.3);
+
+  generator.set_hz(0);
+  time_sleep(kTimeoutUs / 1e6 + 0.05);
+  test::check("Stopped pulses read 0", timer.hz() == 0);
+
+  timer.end();
+  pigpio_stop(pi);
+  return test::result();
+}
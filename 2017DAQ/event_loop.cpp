@@ -0,0 +1,137 @@
+#include "event_loop.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "util.h"
+
+using namespace std;
+
+namespace {
+const int kMaxEvents = 8;  // Ready fds handled per epoll_wait
+
+// Reads a counter fd (timerfd or eventfd) to clear it
+void drain(int fd) {
+  uint64_t count;
+  ssize_t n = read(fd, &count, sizeof(count));
+  (void) n;  // EAGAIN just means another read got there first
+}
+
+timespec to_timespec(double seconds) {
+  timespec ts;
+  ts.tv_sec = (time_t) seconds;
+  ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+  return ts;
+}
+}  // anonymous namespace
+
+EventLoop::EventLoop() {
+  epfd_ = epoll_create1(EPOLL_CLOEXEC);
+  print_assert("Failed to create epoll instance", epfd_ >= 0);
+  owned_.push_back(epfd_);
+
+  stop_event_ = event([this]() { running_ = false; });
+}
+
+EventLoop::~EventLoop() {
+  for (int fd : owned_)
+    close(fd);
+}
+
+void EventLoop::watch(int fd, const Handler &handler) {
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  int ret = epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+  print_assert("Failed to watch fd", ret == 0);
+  handlers_[fd] = handler;
+}
+
+int EventLoop::timer(const Handler &handler) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  print_assert("Failed to create timer", fd >= 0);
+  owned_.push_back(fd);
+  watch(fd, [fd, handler]() {
+      drain(fd);
+      handler();
+    });
+  return fd;
+}
+
+void EventLoop::arm(int timer, double seconds, double interval) {
+  itimerspec spec;
+  spec.it_value = to_timespec(seconds);
+  spec.it_interval = to_timespec(interval);
+  timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+int EventLoop::event(const Handler &handler) {
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  print_assert("Failed to create event", fd >= 0);
+  owned_.push_back(fd);
+  watch(fd, [fd, handler]() {
+      drain(fd);
+      handler();
+    });
+  return fd;
+}
+
+void EventLoop::notify(int event) {
+  uint64_t one = 1;
+  ssize_t n = write(event, &one, sizeof(one));
+  (void) n;  // Only fails if the counter would overflow, it's pending anyway
+}
+
+void EventLoop::signals(initializer_list<int> signals,
+    const function<void(int)> &handler) {
+  sigset_t mask;
+  sigemptyset(&mask);
+  for (int sig : signals)
+    sigaddset(&mask, sig);
+  pthread_sigmask(SIG_BLOCK, &mask, masked_ ? nullptr : &old_mask_);
+  masked_ = true;
+
+  int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  print_assert("Failed to create signalfd", fd >= 0);
+  owned_.push_back(fd);
+  watch(fd, [fd, handler]() {
+      signalfd_siginfo info;
+      while (read(fd, &info, sizeof(info)) == sizeof(info))
+        handler(info.ssi_signo);
+    });
+}
+
+void EventLoop::restore_signals() {
+  if (masked_)
+    pthread_sigmask(SIG_SETMASK, &old_mask_, nullptr);
+}
+
+void EventLoop::run() {
+  epoll_event events[kMaxEvents];
+  running_ = true;
+
+  while (running_) {
+    int n = epoll_wait(epfd_, events, kMaxEvents, -1);
+    if (n < 0 && errno != EINTR) {
+      print_assert("epoll_wait failed", false);
+      break;
+    }
+
+    for (int i = 0; i < n && running_; ++i) {
+      auto it = handlers_.find(events[i].data.fd);
+      if (it != handlers_.end())
+        it->second();
+    }
+  }
+}
+
+void EventLoop::stop() {
+  notify(stop_event_);
+}
@@ -0,0 +1,64 @@
+#ifndef EVENT_LOOP_H_
+#define EVENT_LOOP_H_
+
+#include <atomic>
+#include <csignal>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <vector>
+
+// Single threaded epoll loop over timers (timerfd), signals (signalfd) and
+// events from other threads (eventfd). Handlers all run on the thread calling
+// run(), so they never race each other.
+//
+// Set up every source before run(). arm(), notify() and stop() may be called
+// from any thread.
+class EventLoop {
+ public:
+  typedef std::function<void()> Handler;
+
+  EventLoop();
+  ~EventLoop();  // Closes the fds it created
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  // Runs handler whenever fd is readable, handler must drain it
+  void watch(int fd, const Handler &handler);
+
+  // Adds a timer, disarmed until arm(). Returns its id.
+  int timer(const Handler &handler);
+  // Fires timer after seconds, then every interval seconds (0 for once).
+  // Rearming replaces the previous schedule, 0 seconds disarms.
+  void arm(int timer, double seconds, double interval = 0);
+
+  // Adds an event for other threads to trigger with notify(). Triggers that
+  // arrive before the handler runs are coalesced. Returns its id.
+  int event(const Handler &handler);
+  // Async signal safe
+  void notify(int event);
+
+  // Blocks signals in the calling thread and handles them here instead.
+  // Call before starting other threads so they inherit the mask.
+  void signals(std::initializer_list<int> signals,
+      const std::function<void(int)> &handler);
+  // Restores the calling thread's mask from before the first signals(), e.g.
+  // before exec, which would otherwise pass the blocked mask on
+  void restore_signals();
+
+  // Dispatches handlers until stop()
+  void run();
+  void stop();
+
+ private:
+  int epfd_;
+  int stop_event_;
+  std::atomic<bool> running_{false};
+  std::map<int, Handler> handlers_;  // By fd
+  std::vector<int> owned_;           // fds to close
+  bool masked_ = false;              // Whether old_mask_ was saved
+  sigset_t old_mask_;
+};
+
+#endif  // EVENT_LOOP_H_
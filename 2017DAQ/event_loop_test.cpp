@@ -0,0 +1,52 @@
+#include "event_loop.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+
+// Exercises each kind of source, doesn't need the daemon
+int main(int argc, char **argv) {
+  EventLoop events;
+  int signals = 0, ticks = 0, notified = 0;
+
+  events.signals({SIGUSR1}, [&](int sig) { signals += (sig == SIGUSR1); });
+
+  // Notifications are coalesced, so the handler may see fewer than sent
+  int event = events.event([&]() { ++notified; });
+
+  int periodic = events.timer([&]() { ++ticks; });
+  events.arm(periodic, 0.01, 0.01);
+
+  int done = events.timer([&]() { events.stop(); });
+  events.arm(done, 0.2);
+
+  // Another thread notifies and raises a signal while the loop runs
+  thread other([&]() {
+      this_thread::sleep_for(chrono::milliseconds(50));
+      for (int i = 0; i < 3; ++i)
+        events.notify(event);
+      kill(getpid(), SIGUSR1);
+    });
+
+  auto start = chrono::steady_clock::now();
+  events.run();
+  double elapsed = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+  other.join();
+
+  printf("Ran %.3fs: %d ticks, %d notifications handled, %d signals\n",
+      elapsed, ticks, notified, signals);
+
+  // Unblocked again once restored
+  events.restore_signals();
+  sigset_t mask;
+  pthread_sigmask(SIG_BLOCK, nullptr, &mask);
+
+  bool ok = elapsed >= 0.19 && elapsed < 0.3 && ticks >= 15 && ticks <= 20 &&
+    notified >= 1 && signals == 1 && !sigismember(&mask, SIGUSR1);
+  printf(ok ? "ok\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
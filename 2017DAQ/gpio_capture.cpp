@@ -0,0 +1,171 @@
+#include "gpio_capture.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <pigpiod_if2.h>
+
+#include "csv.h"
+#include "timebase.h"
+#include "util.h"
+
+using namespace std;
+
+namespace gpio_capture {
+namespace {
+const char *pipe_format = "/dev/pigpio%d";
+const unsigned kBatchReports = 64;  // Reports drained per read
+
+int pi = -1;
+int handle = -1;  // Notification handle
+int fd = -1;      // Read end of its pipe
+thread reader;
+
+uint32_t pins = 0;
+atomic<uint32_t> cached_levels(0);
+atomic<uint32_t> edge_ticks[32];
+atomic<unsigned long> dropped_reports(0);
+
+unique_ptr<Csv> edge_log;
+timebase::TickUnwrapper edge_log_ticks(0);
+mutex edge_log_mutex;  // GUARDS edge_log and edge_log_ticks
+
+// Applies a report, logging the edges it carries
+void apply(const gpioReport_t &report) {
+  uint32_t prev = cached_levels;
+  uint32_t level = report.level & pins;
+  uint32_t changed = prev ^ level;
+  if (!changed)
+    return;
+
+  cached_levels = level;
+
+  lock_guard<mutex> lock(edge_log_mutex);
+  for (unsigned gpio = 0; gpio < 32; ++gpio) {
+    if (!((changed >> gpio) & 1))
+      continue;
+    edge_ticks[gpio] = report.tick;
+    if (edge_log)
+      *edge_log << report.tick << edge_log_ticks.unwrap(report.tick) << gpio
+        << ((level >> gpio) & 1) << Csv::LINE_BREAK;
+  }
+}
+
+// Drains the pipe until it closes
+void read_reports() {
+  gpioReport_t reports[kBatchReports];
+  size_t have = 0;  // Bytes in reports, a read can end mid report
+  bool first = true;
+  uint16_t seqno = 0;
+
+  for (;;) {
+    ssize_t n = read(fd, (char *) reports + have, sizeof(reports) - have);
+    if (n <= 0)
+      break;  // notify_close closed the pipe
+    have += n;
+
+    size_t count = have / sizeof(gpioReport_t);
+    for (size_t i = 0; i < count; ++i) {
+      const gpioReport_t &report = reports[i];
+      if (!first && (uint16_t) (report.seqno - seqno) != 1)
+        dropped_reports += (uint16_t) (report.seqno - seqno - 1);
+      seqno = report.seqno;
+      first = false;
+
+      // Watchdog and keep alive reports aren't level changes
+      if (report.flags == 0)
+        apply(report);
+    }
+
+    // Keep the partial report for the next read
+    size_t used = count * sizeof(gpioReport_t);
+    memmove(reports, (char *) reports + used, have - used);
+    have -= used;
+  }
+}
+}  // anonymous namespace
+
+void set_pins(uint32_t bits) {
+  print_assert("Attempting to change captured pins while capturing, call "
+      "end() first", handle < 0);
+  pins = bits;
+}
+
+void set_pipe_format(const char *format) {
+  pipe_format = format;
+}
+
+void init() {
+  if (pi < 0)
+    pi = assert_success(pigpio_start(nullptr, nullptr));
+}
+
+void begin() {
+  print_assert("Attempted to capture gpios without an open connection, "
+        "make sure to call init!", pi >= 0);
+  if (handle >= 0)
+    return;
+
+  handle = assert_success(notify_open(pi));
+
+  char path[80];
+  snprintf(path, sizeof(path), pipe_format, handle);
+  fd = open(path, O_RDONLY);
+  print_assert("Failed to open gpio notification pipe", fd >= 0);
+
+  // Seed the levels, reports only arrive on changes
+  cached_levels = read_bank_1(pi) & pins;
+  for (atomic<uint32_t> &tick : edge_ticks)
+    tick = 0;
+
+  reader = thread(&read_reports);
+  assert_success(notify_begin(pi, handle, pins));
+}
+
+void end() {
+  if (handle >= 0) {
+    // Closing the notification closes the pipe, ending the reader
+    assert_success(notify_close(pi, handle));
+    reader.join();
+    ::close(fd);
+    handle = fd = -1;
+  }
+}
+
+void close() {
+  if (pi >= 0) {
+    pigpio_stop(pi);
+    pi = -1;
+  }
+}
+
+uint32_t levels() {
+  return cached_levels;
+}
+
+uint32_t last_edge(unsigned gpio) {
+  return edge_ticks[gpio & 31];
+}
+
+unsigned long dropped() {
+  return dropped_reports;
+}
+
+void log_edges(const char *filename, uint32_t start_tick) {
+  lock_guard<mutex> lock(edge_log_mutex);
+  if (filename) {
+    edge_log.reset(new Csv(filename,
+          {"Tick (us)", "Time (us)", "GPIO", "Level"}));
+    edge_log_ticks = timebase::TickUnwrapper(start_tick);
+  } else {
+    edge_log.reset();
+  }
+}
+}  // namespace gpio_capture
@@ -0,0 +1,44 @@
+#ifndef GPIO_CAPTURE_H_
+#define GPIO_CAPTURE_H_
+
+#include <cstdint>
+
+// Captures level changes of a set of gpios through the daemon's notification
+// pipe (/dev/pigpioN). The daemon writes a report with the bank's levels and
+// its tick on every change, which a reader thread drains in batches into a
+// cached copy of the levels, so reading a pin is a memory load instead of a
+// daemon call. Every edge can also be logged with its tick.
+//
+// Glitch filters set on a pin apply to its reports.
+namespace gpio_capture {
+// Pins to capture, a bit per gpio (0-31). Call before begin().
+void set_pins(uint32_t bits);
+
+// Path format of the daemon's notification pipes, with a %d for the handle.
+// /dev/pigpio%d unless the daemon is simulated. Call before begin().
+void set_pipe_format(const char *format);
+
+// Forwards to setup and tear down of the daemon connection and pipe
+void init();
+void begin();
+void end();
+void close();
+
+// Cached levels of the captured pins, as of the last report
+uint32_t levels();
+inline bool level(unsigned gpio) { return (levels() >> gpio) & 1; }
+
+// Tick of a captured pin's last edge, 0 if it hasn't changed since begin()
+uint32_t last_edge(unsigned gpio);
+
+// Reports lost to a full pipe (seen as gaps in their sequence numbers)
+unsigned long dropped();
+
+// Logs every edge of the captured pins to a CSV of tick, gpio and level,
+// replacing any previous log. nullptr stops logging. Each edge's time is also
+// logged in us since start_tick, unwrapped across the tick's wrap (see
+// timebase.h).
+void log_edges(const char *filename, uint32_t start_tick = 0);
+}  // namespace gpio_capture
+
+#endif  // GPIO_CAPTURE_H_
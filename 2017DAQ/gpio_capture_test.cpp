@@ -0,0 +1,55 @@
+#include "gpio_capture.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <pigpiod_if2.h>
+
+using namespace std;
+
+const char *usage = "Usage: %s gpio...\n";
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  uint32_t pins = 0;
+  for (int i = 1; i < argc; ++i)
+    pins |= 1 << atoi(argv[i]);
+
+  printf("Capturing gpios (Press <Enter> to terminate)\n"
+      "Edges are logged to gpio_capture_test.csv\n");
+
+  gpio_capture::set_pins(pins);
+  gpio_capture::init();
+  gpio_capture::begin();
+  gpio_capture::log_edges("gpio_capture_test.csv");
+
+  auto *thread = start_thread([](void *) -> void * {
+      uint32_t last = gpio_capture::levels();
+      printf("Levels: %08X\n", last);
+      while (true) {
+        uint32_t levels = gpio_capture::levels();
+        if (levels != last)
+          printf("Levels: %08X\n", levels);
+        last = levels;
+        time_sleep(0.01);
+      }
+
+      return nullptr;
+    }, nullptr);
+
+  char c;
+  while ((c = getchar()) != '\n' && c != EOF);  // Wait for <Enter> or EOF
+
+  stop_thread(thread);
+
+  printf("Dropped reports: %lu\n", gpio_capture::dropped());
+
+  gpio_capture::log_edges(nullptr);
+  gpio_capture::end();
+  gpio_capture::close();
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef HEALTH_H_
+#define HEALTH_H_
+
+#include <algorithm>
+#include <cstdint>
+
+// Health tracking (circuit breaker) for sensors that may be absent or failing.
+// After kMaxFailures consecutive failed reads a device is marked down and its
+// reads are skipped, except for a re-probe on an exponential backoff schedule.
+// Times are timebase::now_ns() ns, so backoffs don't step with the wall clock.
+namespace health {
+enum State { UP, DOWN };
+
+// Consecutive failures before a device is marked down
+const unsigned kMaxFailures = 3;
+// Wait before re-probing a down device, doubled after every failed probe
+const uint64_t kInitialBackoffNs = 500000000;
+const uint64_t kMaxBackoffNs = 30000000000;
+
+struct Health {
+  State state = UP;
+  unsigned consecutive_failures = 0;
+  unsigned long successes = 0;
+  unsigned long failures = 0;
+  unsigned long skipped = 0;    // Reads not attempted while down
+  unsigned long trips = 0;      // Times the device was marked down
+  uint64_t backoff_ns = 0;      // Current wait between probes while down
+  uint64_t next_probe_ns = 0;   // When a down device is next tried
+};
+
+// True if a read should be attempted at time now_ns: always while up, and once
+// the backoff has elapsed while down. Counts the skip otherwise.
+inline bool should_try(Health &h, uint64_t now_ns) {
+  if (h.state == UP || now_ns >= h.next_probe_ns)
+    return true;
+
+  ++h.skipped;
+  return false;
+}
+
+// Records the outcome of an attempted read at time now_ns.
+// Returns true if the device changed state, so callers can log only then.
+inline bool record(Health &h, bool ok, uint64_t now_ns) {
+  if (ok) {
+    ++h.successes;
+    h.consecutive_failures = 0;
+    if (h.state == UP)
+      return false;
+
+    h.state = UP;
+    h.backoff_ns = 0;
+    return true;
+  }
+
+  ++h.failures;
+  ++h.consecutive_failures;
+  if (h.state == DOWN) {  // Failed probe, wait longer next time
+    h.backoff_ns = std::min(h.backoff_ns * 2, kMaxBackoffNs);
+    h.next_probe_ns = now_ns + h.backoff_ns;
+    return false;
+  }
+
+  if (h.consecutive_failures < kMaxFailures)
+    return false;
+
+  h.state = DOWN;
+  ++h.trips;
+  h.backoff_ns = kInitialBackoffNs;
+  h.next_probe_ns = now_ns + h.backoff_ns;
+  return true;
+}
+}  // namespace health
+
+#endif  // HEALTH_H_
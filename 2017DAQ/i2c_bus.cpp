@@ -0,0 +1,283 @@
+#include "i2c_bus.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <pigpiod_if2.h>
+
+#include "trace.h"
+#include "util.h"
+
+using namespace std;
+
+namespace i2c_bus {
+namespace {
+Config configs[] = {
+  {HARDWARE, 1, 0, 0, 100000},      // I2C1
+  {HARDWARE, 0, 0, 0, 100000},      // I2C0
+  {BIT_BANGED, 0, 22, 27, 100000},  // BB_A
+  {BIT_BANGED, 0, 16, 12, 100000},  // BB_B
+};
+
+// Transfers queued per bus before submit() runs them inline instead
+const unsigned kQueueLen = 8;
+// Largest zip command and reply handled
+const unsigned kMaxCmdLen = 64;
+const unsigned kMaxReadLen = 32;
+const int kMaxDevices = 16;
+
+struct BusState {
+  int pi = -1;              // Connection used by this bus only
+  int num_devices = 0;      // Open devices on this bus
+
+  mutex io_mutex;           // GUARDS use of pi
+
+  mutex queue_mutex;        // GUARDS everything below
+  condition_variable queue_cv;
+  Transfer *queue[kQueueLen];
+  unsigned queue_head = 0, queue_count = 0;
+  bool stop = false;
+  thread worker;
+};
+BusState buses[NUM_BUSES];
+
+struct DeviceState { Bus bus; unsigned addr; int handle; bool open; };
+DeviceState devices[kMaxDevices];
+mutex devices_mutex;  // GUARDS devices (open and close only)
+
+// Builds the zip command for a transfer. The hardware and bit-banged zip
+// command sets differ: hardware addresses by handle and uses the combined flag
+// for repeated starts, bit-banged gives the address and every start itself.
+unsigned build_cmd(const Config &config, const DeviceState &dev,
+    const Transfer &t, char *cmd) {
+  unsigned len = 0;
+
+  if (config.type == HARDWARE) {
+    cmd[len++] = 0x2;                       // Combined flag on
+    for (unsigned i = 0; i < t.num_segs; ++i) {
+      const Segment &seg = t.segs[i];
+      if (seg.write_len) {
+        cmd[len++] = 0x7;                   // Write
+        cmd[len++] = seg.write_len;
+        memcpy(cmd + len, seg.write, seg.write_len);
+        len += seg.write_len;
+      }
+      if (seg.read_len) {
+        cmd[len++] = 0x6;                   // Read
+        cmd[len++] = seg.read_len;
+      }
+    }
+  } else {
+    cmd[len++] = 0x4;                       // Address
+    cmd[len++] = dev.addr;
+    for (unsigned i = 0; i < t.num_segs; ++i) {
+      const Segment &seg = t.segs[i];
+      if (seg.write_len) {
+        cmd[len++] = 0x2;                   // (Repeated) start
+        cmd[len++] = 0x7;                   // Write
+        cmd[len++] = seg.write_len;
+        memcpy(cmd + len, seg.write, seg.write_len);
+        len += seg.write_len;
+      }
+      if (seg.read_len) {
+        cmd[len++] = 0x2;                   // (Repeated) start
+        cmd[len++] = 0x6;                   // Read
+        cmd[len++] = seg.read_len;
+      }
+    }
+    cmd[len++] = 0x3;                       // Stop
+  }
+  cmd[len++] = 0x0;                         // End cmd sequence
+
+  return len;
+}
+
+// Performs a transfer, caller must hold the bus's io_mutex
+void execute(BusState &bus, const Config &config, Transfer &t) {
+  const DeviceState &dev = devices[t.device];
+  char cmd[kMaxCmdLen];
+  char buf[kMaxReadLen];
+  unsigned read_len = 0;
+
+  for (unsigned i = 0; i < t.num_segs; ++i)
+    read_len += t.segs[i].read_len;
+  print_assert("Transfer too long", read_len <= kMaxReadLen);
+
+  unsigned cmd_len = build_cmd(config, dev, t, cmd);
+  print_assert("Transfer too long", cmd_len <= kMaxCmdLen);
+
+  // Failures are left for the caller to report (devices may be unplugged)
+  TRACE_SCOPE("i2c_zip");
+  if (config.type == HARDWARE)
+    t.result = i2c_zip(bus.pi, dev.handle, cmd, cmd_len, buf, read_len);
+  else
+    t.result = bb_i2c_zip(bus.pi, config.sda, cmd, cmd_len, buf, read_len);
+
+  // Scatter reply into the segments' read buffers
+  if (t.result == (int) read_len) {
+    unsigned pos = 0;
+    for (unsigned i = 0; i < t.num_segs; ++i) {
+      memcpy(t.segs[i].read, buf + pos, t.segs[i].read_len);
+      pos += t.segs[i].read_len;
+    }
+  }
+}
+
+void work(Bus b) {
+  TRACE_THREAD("i2c_bus");
+  BusState &bus = buses[b];
+  unique_lock<mutex> lock(bus.queue_mutex);
+
+  while (true) {
+    bus.queue_cv.wait(lock, [&]() { return bus.stop || bus.queue_count; });
+    if (bus.stop)
+      return;
+
+    Transfer *t = bus.queue[bus.queue_head];
+    lock.unlock();
+    {
+      lock_guard<mutex> io_lock(bus.io_mutex);
+      execute(bus, configs[b], *t);
+    }
+    lock.lock();
+
+    // Only dequeue once done, so a full queue waits for the worker
+    bus.queue_head = (bus.queue_head + 1) % kQueueLen;
+    --bus.queue_count;
+    t->done = true;
+    bus.queue_cv.notify_all();
+  }
+}
+}  // anonymous namespace
+
+void set_config(Bus b, const Config &config) {
+  print_assert("Bus configuration changed with devices open",
+      buses[b].num_devices == 0);
+  configs[b] = config;
+}
+
+const Config &get_config(Bus b) {
+  return configs[b];
+}
+
+void init() {
+  for (int b = 0; b < NUM_BUSES; ++b) {
+    BusState &bus = buses[b];
+
+    // Only connect if no connection already exists
+    if (bus.pi < 0) {
+      bus.pi = assert_success(pigpio_start(nullptr, nullptr));
+      bus.stop = false;
+      bus.worker = thread(&work, (Bus) b);
+    }
+  }
+}
+
+void close() {
+  for (BusState &bus : buses) {
+    if (bus.pi < 0)
+      continue;
+
+    {
+      lock_guard<mutex> lock(bus.queue_mutex);
+      bus.stop = true;
+    }
+    bus.queue_cv.notify_all();
+    bus.worker.join();
+
+    pigpio_stop(bus.pi);
+    bus.pi = -1;
+  }
+}
+
+int open_device(Bus b, unsigned addr) {
+  BusState &bus = buses[b];
+  const Config &config = configs[b];
+  print_assert("Attempting to open an i2c device without a valid connection to "
+      "the pigpio daemon, must call init() first", bus.pi >= 0);
+
+  lock_guard<mutex> lock(devices_mutex);
+
+  int d;
+  for (d = 0; d < kMaxDevices && devices[d].open; ++d) {}
+  print_assert("Too many open i2c devices", d < kMaxDevices);
+  if (d == kMaxDevices)
+    return PI_BAD_HANDLE;
+
+  int handle = -1;
+  lock_guard<mutex> io_lock(bus.io_mutex);
+  if (config.type == HARDWARE) {
+    handle = assert_success(i2c_open(bus.pi, config.bus, addr, 0));
+    if (handle < 0)
+      return handle;
+  } else if (bus.num_devices == 0) {  // First device opens the bus itself
+    int ret = assert_success(bb_i2c_open(bus.pi, config.sda, config.scl,
+          config.baud));
+    if (ret < 0)
+      return ret;
+  }
+  ++bus.num_devices;
+
+  devices[d] = {b, addr, handle, true};
+  return d;
+}
+
+void close_device(int device) {
+  lock_guard<mutex> lock(devices_mutex);
+  DeviceState &dev = devices[device];
+  if (!dev.open)
+    return;
+
+  BusState &bus = buses[dev.bus];
+  const Config &config = configs[dev.bus];
+
+  lock_guard<mutex> io_lock(bus.io_mutex);
+  --bus.num_devices;
+  if (config.type == HARDWARE)
+    assert_success(i2c_close(bus.pi, dev.handle));
+  else if (bus.num_devices == 0)  // Last device closes the bus
+    assert_success(bb_i2c_close(bus.pi, config.sda));
+
+  dev.open = false;
+}
+
+Bus device_bus(int device) {
+  return devices[device].bus;
+}
+
+int run(Transfer &t) {
+  BusState &bus = buses[devices[t.device].bus];
+
+  lock_guard<mutex> io_lock(bus.io_mutex);
+  execute(bus, configs[devices[t.device].bus], t);
+  t.done = true;
+  return t.result;
+}
+
+void submit(Transfer &t) {
+  BusState &bus = buses[devices[t.device].bus];
+  t.done = false;
+
+  {
+    lock_guard<mutex> lock(bus.queue_mutex);
+    if (bus.queue_count < kQueueLen) {
+      bus.queue[(bus.queue_head + bus.queue_count) % kQueueLen] = &t;
+      ++bus.queue_count;
+      bus.queue_cv.notify_all();
+      return;
+    }
+  }
+
+  run(t);  // Queue full, no point waiting on the worker
+}
+
+int wait(Transfer &t) {
+  BusState &bus = buses[devices[t.device].bus];
+
+  unique_lock<mutex> lock(bus.queue_mutex);
+  bus.queue_cv.wait(lock, [&]() { return t.done; });
+  return t.result;
+}
+}  // namespace i2c_bus
@@ -0,0 +1,76 @@
+#ifndef I2C_BUS_H_
+#define I2C_BUS_H_
+
+#include <cstdint>
+
+// I2C buses shared by the sensor modules. Each bus has its own connection to
+// the pigpio daemon and its own worker thread, so transfers on different buses
+// overlap instead of queueing behind each other.
+namespace i2c_bus {
+enum Bus {
+  I2C1,       // Hardware bus 1 (GPIO 2/3), all sensors by default
+  I2C0,       // Hardware bus 0 (GPIO 0/1), needs dtparam=i2c_vc=on
+  BB_A,       // Bit-banged by pigpio (SDA GPIO 22, SCL GPIO 27)
+  BB_B,       // Bit-banged by pigpio (SDA GPIO 16, SCL GPIO 12). GPIO 16
+              // is SPI1's CE2, the display leaves it unreserved.
+  NUM_BUSES,  // Must be the last bus in the list
+};
+
+enum Type { HARDWARE, BIT_BANGED };
+
+struct Config {
+  Type type;
+  unsigned bus;       // HARDWARE: bus number, i.e. /dev/i2c-<bus>
+  unsigned sda, scl;  // BIT_BANGED: gpio pins
+  // Clock in Hz. pigpio clocks bit-banged buses at this rate. Hardware bus
+  // clocks are set by the kernel (dtparam=i2c_arm_baudrate in
+  // /boot/config.txt), so for those this only documents the expected rate.
+  unsigned baud;
+};
+
+// Replaces the configuration of a bus. Must be called before any device is
+// opened on it.
+void set_config(Bus b, const Config &config);
+const Config &get_config(Bus b);
+
+// Connect to daemon (one connection per bus) and start the bus workers
+void init();
+// Stop the bus workers and disconnect from daemon
+void close();
+
+// Opens the device at addr on a bus.
+// Returns a device handle, or a negative pigpio error.
+int open_device(Bus b, unsigned addr);
+void close_device(int device);
+Bus device_bus(int device);
+
+// One write then read with a device, with a repeated start in between (e.g.
+// an SMBus register read). Either part may be empty.
+struct Segment {
+  const uint8_t *write;
+  unsigned write_len;
+  uint8_t *read;
+  unsigned read_len;
+};
+
+// Segments to a single device, performed as one daemon call
+const unsigned kMaxSegments = 4;
+struct Transfer {
+  int device;
+  Segment segs[kMaxSegments];
+  unsigned num_segs = 0;
+  int result = 0;     // Bytes read or a negative pigpio error, once done
+  bool done = false;  // Set by the bus worker, read it through wait()
+};
+
+// Performs a transfer on the calling thread. Returns t.result.
+int run(Transfer &t);
+
+// Queues a transfer on its bus's worker and returns immediately, so transfers
+// on other buses can be started. t must stay alive until wait(t) returns.
+void submit(Transfer &t);
+// Blocks until a submitted transfer is done. Returns t.result.
+int wait(Transfer &t);
+}  // namespace i2c_bus
+
+#endif  // I2C_BUS_H_
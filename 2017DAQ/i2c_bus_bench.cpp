@@ -0,0 +1,84 @@
+#include "i2c_bus.h"
+#include "ir_temp.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <pigpiod_if2.h>
+
+#include "sim_devices.h"
+#include "sim_pigpio.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [round trip in us] [seconds per run]\n";
+
+const uint8_t kAddrs[] = {0x5A, 0x5B, 0x5C, 0x5D};
+
+// Simulated bus number for a configured bus
+unsigned sim_bus(i2c_bus::Bus b) {
+  const i2c_bus::Config &config = i2c_bus::get_config(b);
+  return config.type == i2c_bus::HARDWARE ?
+    config.bus : sim::kBitBangedBus + config.sda;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 3) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  sim::Timing timing;
+  timing.round_trip_us = argc > 1 ? strtod(argv[1], nullptr) : 150;
+  double seconds = argc > 2 ? strtod(argv[2], nullptr) : 1;
+  sim::set_timing(timing);
+
+  sim::Mlx90614 devices[] = {{kAddrs[0]}, {kAddrs[1]}, {kAddrs[2]},
+    {kAddrs[3]}};
+  for (auto &dev : devices)
+    dev.set_temps_K(300, 350, 350);
+
+  ir_temp::init();
+
+  printf("Simulated round trip %.0f us, every bus at 100 kHz, %d MLX90614s\n",
+      timing.round_trip_us, ir_temp::NUM_DEVICES);
+
+  const int kBusCounts[] = {1, 2, 4};
+  double base_rate = 0;
+  for (int num_buses : kBusCounts) {
+    // Deal the devices out over the first num_buses buses
+    for (int i = 0; i < ir_temp::NUM_DEVICES; ++i) {
+      auto bus = (i2c_bus::Bus) (i % num_buses);
+      for (int b = 0; b < i2c_bus::NUM_BUSES; ++b)
+        sim::attach_i2c(sim_bus((i2c_bus::Bus) b), kAddrs[i], nullptr);
+      sim::attach_i2c(sim_bus(bus), kAddrs[i], &devices[i]);
+      ir_temp::set_bus((ir_temp::Device) i, bus);
+      ir_temp::set_refresh_interval((ir_temp::Device) i, 0);  // Always due
+    }
+    ir_temp::begin();
+
+    sim::reset_counters();
+    long reads = 0;
+    double start = time_time(), elapsed;
+    while ((elapsed = time_time() - start) < seconds)
+      reads += ir_temp::poll();
+
+    for (int i = 0; i < ir_temp::NUM_DEVICES; ++i) {
+      if (ir_temp::cached((ir_temp::Device) i).stat != ir_temp::OK) {
+        fprintf(stderr, "Device %d failed on %d buses\n", i, num_buses);
+        return 1;
+      }
+    }
+    ir_temp::end();
+
+    double rate = reads / elapsed;
+    if (!base_rate)
+      base_rate = rate;
+    printf("%d bus(es): %8.0f device reads/s (%.2fx), %lu transactions\n",
+        num_buses, rate, rate / base_rate, sim::counters().i2c_transactions);
+  }
+
+  ir_temp::close();
+
+  return 0;
+}
@@ -2,99 +2,194 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstdio>
 
 #include <pigpiod_if2.h>
 
+#include "timebase.h"
 #include "util.h"
 
 namespace ir_temp {
 namespace {
-int pi = -1;                    // Handle for connecting to pigpio daemon
-int i2c[] = {-1, -1, -1, -1};   // Handles for connecting to i2c devices
+int i2c[] = {-1, -1, -1, -1};   // i2c_bus handles for the devices
 
 // Connection Constants
-const uint8_t kBus = 1;
+i2c_bus::Bus buses[] = {i2c_bus::I2C1, i2c_bus::I2C1, i2c_bus::I2C1,
+  i2c_bus::I2C1};
 const uint8_t kAddrs[] = {0x5A, 0x5B, 0x5C, 0x5D};
+// True for dual-zone parts (MLX90614xBx/xCx), which also have a TObj2 sensor
+const bool kDualZone[] = {false, false, false, false};
 
 // MLX90614 Constants
 const uint8_t kRamAddrTA    = 0x06;
 const uint8_t kRamAddrTObj1 = 0x07;
+const uint8_t kRamAddrTObj2 = 0x08;
 
-// Internal get temperature in Fahrenheit
-template <const uint8_t RAM_ADDR>
-Reading get_temp_F(Device d) {
-  print_assert("Attempting to read from a device without a valid connection to "
-      "the pigpio daemon", pi >= 0);
+// Most RAM registers fetched by a single transaction (TA, TObj1, TObj2)
+const unsigned kMaxRegs = 3;
 
-  // Return val
-  Reading result;
+// Names for logging
+const char *kNames[] = {"CVT belt", "rear rotor", "front left rotor",
+  "front right rotor"};
+
+// Circuit breaker state for each device
+health::Health device_health[NUM_DEVICES];
+
+// Cache state for each device
+Temps cache[NUM_DEVICES];
+const uint64_t kDefaultRefreshNs = kDefaultRefreshInterval * 1e9;
+uint64_t refresh_interval_ns[] = {kDefaultRefreshNs, kDefaultRefreshNs,
+  kDefaultRefreshNs, kDefaultRefreshNs};
+uint64_t last_refresh_ns[] = {0, 0, 0, 0};  // Last read attempt, 0 if none
+int next_poll = 0;                     // Device poll() checks first
+
+// A read of RAM registers from one device, in flight on its bus
+struct RamRead {
+  Device d;
+  const uint8_t *regs;
+  unsigned num_regs;
+  uint8_t buf[3 * kMaxRegs];
+  i2c_bus::Transfer transfer;
+};
 
-  if (i2c[d] < 0) {
-    result.stat = BAD_HANDLE;
-    return result;
+// Sets up a read of num_regs RAM registers from a device as one transfer.
+// Each register is its own SMBus read word (repeated start between command and
+// data, then LSB, MSB and PEC), chained so the whole sequence is one daemon
+// call.
+void build_read(Device d, const uint8_t *regs, unsigned num_regs,
+    RamRead &read) {
+  print_assert("Too many registers for one transaction", num_regs <= kMaxRegs);
+
+  read.d = d;
+  read.regs = regs;
+  read.num_regs = num_regs;
+  read.transfer.device = i2c[d];
+  read.transfer.num_segs = num_regs;
+  for (unsigned i = 0; i < num_regs; ++i)
+    read.transfer.segs[i] = {&regs[i], 1, read.buf + 3 * i, 3};
+}
+
+// Checks a finished read, writing the verified words to words
+Status decode_read(const RamRead &read, uint16_t *words) {
+  if (read.transfer.result != (int) (3 * read.num_regs))
+    return BAD_RETURN_LEN;
+
+  for (unsigned i = 0; i < read.num_regs; ++i) {
+    Status stat = decode_word(read.d, read.regs[i], read.buf + 3 * i,
+        &words[i]);
+    if (stat != OK)
+      return stat;
   }
 
-  // I2C Command String
-  // This allows commands to be sequences w/o end bits, so repeated start!
-  char i2c_cmd[] = {
-    0x2,                  // Switch Combined Flag On
-    0x7, 0x1, RAM_ADDR,   // Write 1 byte (RAM_ADDR)
-    0x6, 0x3,             // Read 3 bytes (DATA_LOW, DATA_HIGH, PEC)
-    0x0,                  // End cmd sequence
+  return OK;
+}
+
+// Records a read with the device's circuit breaker. Failures are only reported
+// when the device goes down or comes back, so a missing sensor does not flood
+// the log every loop.
+void record(Device d, Status stat, uint64_t now_ns) {
+  if (!health::record(device_health[d], stat == OK, now_ns))
+    return;
+
+  if (stat == OK)
+    fprintf(stderr, "\n[%s:%d] %s IR temp sensor (0x%02X) recovered\n",
+        __FILE__, __LINE__, kNames[d], kAddrs[d]);
+  else
+    fprintf(stderr, "\n[%s:%d] Error: %s IR temp sensor (0x%02X) down after "
+        "%u failed reads (status %d)\n", __FILE__, __LINE__, kNames[d],
+        kAddrs[d], health::kMaxFailures, stat);
+}
+
+// Internal read of RAM registers behind the device's circuit breaker. Sets
+// time_ns to the middle of the read.
+Status read_ram(Device d, const uint8_t *regs, unsigned num_regs,
+    uint16_t *words, uint64_t &time_ns) {
+  uint64_t now = timebase::now_ns();
+  time_ns = now;
+  if (i2c[d] < 0)
+    return BAD_HANDLE;
+  if (!health::should_try(device_health[d], now))
+    return DEVICE_DOWN;
+
+  RamRead read;
+  build_read(d, regs, num_regs, read);
+  i2c_bus::run(read.transfer);
+  time_ns = now + (timebase::now_ns() - now) / 2;
+
+  Status stat = decode_read(read, words);
+  record(d, stat, now);
+  return stat;
+}
+
+// Internal get temperature in Fahrenheit
+Reading get_temp_F(Device d, uint8_t ram_addr) {
+  Reading result;
+  uint16_t word;
+
+  result.stat = read_ram(d, &ram_addr, 1, &word, result.time_ns);
+  if (result.stat == OK)
+    result.val = word_to_F(word);
+
+  return result;
+}
+
+// Registers read_all fetches
+const uint8_t kAllRegs[] = {kRamAddrTA, kRamAddrTObj1, kRamAddrTObj2};
+
+unsigned num_all_regs(Device d) {
+  return kDualZone[d] ? 3 : 2;
+}
+
+// Fills temps from the words read for read_all
+void words_to_temps(Device d, const uint16_t *words, Temps &temps) {
+  temps.amb = word_to_F(words[0]);
+  temps.obj1 = word_to_F(words[1]);
+  if (kDualZone[d])
+    temps.obj2 = word_to_F(words[2]);
+}
+}  // anonymous namespace
+
+Status decode_word(Device d, uint8_t reg, const uint8_t *frame,
+    uint16_t *word) {
+  // PEC covers the entire transaction excluding S, Sr, A, Na, P and PEC
+  const uint8_t header[] = {
+    (uint8_t) ((kAddrs[d] << 1) | 0),  // SA_Wr
+    reg,                               // Command
+    (uint8_t) ((kAddrs[d] << 1) | 1),  // SA_R
   };
-  char i2c_buf[3];
-
-  int count = assert_success(i2c_zip(pi, i2c[d],
-        i2c_cmd, sizeof(i2c_cmd),
-        i2c_buf, sizeof(i2c_buf)));
-  print_assert("Wrong number of bytes recieved", count == sizeof(i2c_buf));
-  if (count != sizeof(i2c_buf)) {
-    result.stat = BAD_RETURN_LEN;
-    return result;
-  }
+  uint8_t crc8 = util::crc8(frame, 2, util::crc8(header, sizeof(header)));
 
-  uint16_t word = i2c_buf[0] | (i2c_buf[1] << 8);
-
-  // Entire transaction excluding S, Sr, A, Na, P and PEC
-  // Needs to be constructed bc PEC calculation includes all of these bits
-  uint64_t data = (uint64_t) ((kAddrs[d] << 1) | 0)  << 32 |  // SA_Wr
-                  (uint64_t) RAM_ADDR                << 24 |  // Command
-                  (uint64_t) ((kAddrs[d] << 1) | 1)  << 16 |  // SA_R
-                  (uint64_t) i2c_buf[0]              <<  8 |  // LSB
-                  (uint64_t) i2c_buf[1];                      // MSB
-  uint8_t crc8 = util::crc8(data);
-
-  uint8_t pec = i2c_buf[2];  // Packet Error Code
-  print_assert("Packet Error Code does not match CRC-8 (0x07 MSB) polynomial "
-        "remainder", pec == crc8);
-  if (pec != crc8) {
-    result.stat = CRC8_MISMATCH;
-    return result;
-  }
+  uint8_t pec = frame[2];  // Packet Error Code
+  if (pec != crc8)  // PEC does not match CRC-8 (0x07 MSB) remainder
+    return CRC8_MISMATCH;
 
   // DEBUG
   // fprintf(stderr, "Values: 0x%02x 0x%02x\n", pec, crc8);
 
+  *word = frame[0] | (frame[1] << 8);
+  return OK;
+}
+
+double word_to_F(uint16_t word) {
   // word * resolution is temp in K
-  result.val = (word * 0.02 - 273.15) * 9 / 5 + 32;
-  return result;
+  return (word * 0.02 - 273.15) * 9 / 5 + 32;
 }
-}  // anonymous namespace
 
 void init() {
-  // Only connect if no connection already exists
-  if (pi < 0) {
-    pi = assert_success(pigpio_start(nullptr, nullptr));
-  }
+  i2c_bus::init();
 }
 
-void begin() {
-  print_assert("Attempting to connect to i2c without a valid connection to the "
-      "pigpio daemon, must call init() before begin()", pi >= 0);
+void set_bus(Device d, i2c_bus::Bus bus) {
+  print_assert("Attempting to move a connected device, call end() first",
+      i2c[d] < 0);
+  buses[d] = bus;
+}
 
+void begin() {
   for (int i = 0; i < NUM_DEVICES; ++i) {
     // Only connect if a valid connection does not already exist
-    if (i2c[i] < 0) i2c[i] = assert_success(i2c_open(pi, kBus, kAddrs[i], 0));
+    if (i2c[i] < 0)
+      i2c[i] = assert_success(i2c_bus::open_device(buses[i], kAddrs[i]));
   }
 }
 
@@ -102,24 +197,127 @@ void end() {
   // Looping by reference to allow reassign to -1 when needed
   for (int &handle : i2c) {
     if (handle >= 0) {
-      assert_success(i2c_close(pi, handle));
+      i2c_bus::close_device(handle);
       handle = -1;
     }
   }
 }
 
 void close() {
-  if (pi >= 0) {
-    pigpio_stop(pi);
-    pi = -1;
-  }
+  i2c_bus::close();
 }
 
 Reading get_obj(Device d) {
-  return get_temp_F<kRamAddrTObj1>(d);
+  return get_temp_F(d, kRamAddrTObj1);
 }
 
 Reading get_amb(Device d) {
-  return get_temp_F<kRamAddrTA>(d);
+  return get_temp_F(d, kRamAddrTA);
+}
+
+Temps read_all(Device d) {
+  uint16_t words[kMaxRegs];
+  Temps result;
+
+  result.stat = read_ram(d, kAllRegs, num_all_regs(d), words,
+      result.time_ns);
+  if (result.stat == OK)
+    words_to_temps(d, words, result);
+
+  return result;
+}
+
+const health::Health &get_health(Device d) {
+  return device_health[d];
+}
+
+void set_refresh_interval(Device d, double seconds) {
+  refresh_interval_ns[d] = seconds * 1e9;
+}
+
+int poll() {
+  uint64_t now = timebase::now_ns();
+
+  // Pick the next due device on each bus, round robin
+  int picked[i2c_bus::NUM_BUSES];
+  int num_picked = 0;
+  bool bus_used[i2c_bus::NUM_BUSES] = {};
+
+  for (int i = 0; i < NUM_DEVICES; ++i) {
+    int d = (next_poll + i) % NUM_DEVICES;
+    if (i2c[d] < 0 || bus_used[buses[d]] ||
+        now - last_refresh_ns[d] < refresh_interval_ns[d])
+      continue;
+
+    bus_used[buses[d]] = true;
+    picked[num_picked++] = d;
+  }
+  if (num_picked == 0)
+    return 0;
+  next_poll = (picked[num_picked - 1] + 1) % NUM_DEVICES;
+
+  // Start every read before waiting on any, so the buses work in parallel
+  RamRead reads[i2c_bus::NUM_BUSES];
+  bool started[i2c_bus::NUM_BUSES];
+  for (int i = 0; i < num_picked; ++i) {
+    Device d = (Device) picked[i];
+    last_refresh_ns[d] = now;
+    cache[d] = Temps();
+    cache[d].time_ns = now;
+
+    started[i] = health::should_try(device_health[d], now);
+    if (!started[i]) {
+      cache[d].stat = DEVICE_DOWN;
+      continue;
+    }
+
+    build_read(d, kAllRegs, num_all_regs(d), reads[i]);
+    i2c_bus::submit(reads[i].transfer);
+  }
+
+  for (int i = 0; i < num_picked; ++i) {
+    if (!started[i])
+      continue;
+
+    Device d = reads[i].d;
+    uint16_t words[kMaxRegs];
+    i2c_bus::wait(reads[i].transfer);
+    cache[d].time_ns = now + (timebase::now_ns() - now) / 2;
+
+    cache[d].stat = decode_read(reads[i], words);
+    record(d, cache[d].stat, now);
+    if (cache[d].stat == OK)
+      words_to_temps(d, words, cache[d]);
+  }
+
+  return num_picked;
+}
+
+Temps cached(Device d) {
+  // Prime the cache so callers never see a device that was not yet polled
+  if (last_refresh_ns[d] == 0) {
+    cache[d] = read_all(d);
+    last_refresh_ns[d] = cache[d].time_ns;
+  }
+
+  return cache[d];
+}
+
+Reading cached_obj(Device d) {
+  Temps temps = cached(d);
+  Reading result;
+  result.val = temps.obj1;
+  result.stat = temps.stat;
+  result.time_ns = temps.time_ns;
+  return result;
+}
+
+Reading cached_amb(Device d) {
+  Temps temps = cached(d);
+  Reading result;
+  result.val = temps.amb;
+  result.stat = temps.stat;
+  result.time_ns = temps.time_ns;
+  return result;
 }
 }  // namespace ir_temp
@@ -2,6 +2,10 @@
 #define IR_TEMP_
 
 #include <cmath>
+#include <cstdint>
+
+#include "health.h"
+#include "i2c_bus.h"
 
 namespace ir_temp {
 enum Device {
@@ -17,10 +21,14 @@ enum Status {
   BAD_RETURN_LEN,
   CRC8_MISMATCH,
   BAD_HANDLE,
+  DEVICE_DOWN,    // Skipped, the device failed too often (see get_health)
 };
 
 // Connect to pigpio daemon
 void init();
+// Moves a device to another bus (all are on i2c_bus::I2C1 by default).
+// Must be called before begin().
+void set_bus(Device d, i2c_bus::Bus bus);
 // Pin setup and other settings
 void begin();
 // Release pins
@@ -29,9 +37,51 @@ void end();
 void close();
 
 // Get temperatures from a device
-struct Reading { double val; Status stat = OK; };
+// time_ns is when the value was acquired, the middle of its read, in
+// timebase::now_ns() ns.
+struct Reading { double val; Status stat = OK; uint64_t time_ns = 0; };
 Reading get_obj(Device d);
 Reading get_amb(Device d);
+
+// All temperatures of a device, fetched in a single bus transaction.
+// obj2 is only read on dual-zone parts, and is NAN otherwise.
+struct Temps {
+  double amb, obj1, obj2 = NAN;
+  Status stat = OK;
+  uint64_t time_ns = 0;
+};
+Temps read_all(Device d);
+
+// Health of a device; reads of a down device are skipped until re-probed
+const health::Health &get_health(Device d);
+
+// Cached temperatures
+// The object temperature only changes at the sensor's filter update rate, so
+// the driver reads the cache and refreshes it with poll() once per loop.
+
+// Default time between refreshes of a device, in seconds
+const double kDefaultRefreshInterval = 0.1;
+void set_refresh_interval(Device d, double seconds);
+
+// Refreshes the next device (round robin) whose cache is older than its
+// refresh interval. At most one device per bus is read per call, with the
+// buses working in parallel.
+// Returns the number of devices refreshed.
+int poll();
+
+// Latest cached temperatures, read_all() on first use of a device.
+// time_ns in the result tells how stale the values are.
+Temps cached(Device d);
+Reading cached_obj(Device d);
+Reading cached_amb(Device d);
+
+// Decoding of a RAM read, as read_all does it (exposed for micro_bench).
+// Checks one read word frame (LSB, MSB, PEC) of RAM register reg from d
+// against its PEC, and writes the word if it matches.
+Status decode_word(Device d, uint8_t reg, const uint8_t *frame,
+    uint16_t *word);
+// Converts a RAM temperature word to Fahrenheit
+double word_to_F(uint16_t word);
 }  // namespace ir_temp
 
 #endif  // IR_TEMP_
@@ -0,0 +1,140 @@
+#include "ir_temp.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "sim_devices.h"
+#include "sim_pigpio.h"
+#include "util.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [round trip in us] [iterations]\n";
+
+const uint8_t kAddrs[] = {0x5A, 0x5B, 0x5C, 0x5D};
+const double kAmbK = 300.15, kObjK = 350.15;
+
+double now_us() {
+  return chrono::duration<double, micro>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Times iterations sweeps over every device, reporting per sweep costs
+template <typename F>
+void run(const char *name, int iterations, F sweep) {
+  sim::reset_counters();
+  double start = now_us();
+  for (int i = 0; i < iterations; ++i)
+    sweep();
+  double elapsed = now_us() - start;
+  auto c = sim::counters();
+
+  printf("%-22s %10.1f us/sweep %6.2f transactions/sweep %6.1f bytes/sweep\n",
+      name, elapsed / iterations, (double) c.i2c_transactions / iterations,
+      (double) c.i2c_bytes / iterations);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 3) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  sim::Timing timing;
+  timing.round_trip_us = argc > 1 ? strtod(argv[1], nullptr) : 150;
+  int iterations = argc > 2 ? atoi(argv[2]) : 200;
+  sim::set_timing(timing);
+
+  sim::Mlx90614 devices[] = {{kAddrs[0]}, {kAddrs[1]}, {kAddrs[2]},
+    {kAddrs[3]}};
+  for (int i = 0; i < ir_temp::NUM_DEVICES; ++i) {
+    devices[i].set_temps_K(kAmbK, kObjK + i, kObjK - i);
+    sim::attach_i2c(1, kAddrs[i], &devices[i]);
+  }
+
+  ir_temp::init();
+  ir_temp::begin();
+
+  // Both paths must agree with the simulated temperatures
+  for (int i = 0; i < ir_temp::NUM_DEVICES; ++i) {
+    auto d = (ir_temp::Device) i;
+    auto temps = ir_temp::read_all(d);
+    double obj_F = (kObjK + i - 273.15) * 9 / 5 + 32;
+    if (temps.stat != ir_temp::OK || ir_temp::get_obj(d).stat != ir_temp::OK ||
+        fabs(temps.obj1 - obj_F) > 0.05 ||
+        fabs(temps.obj1 - ir_temp::get_obj(d).val) > 1e-9 ||
+        fabs(temps.amb - ir_temp::get_amb(d).val) > 1e-9) {
+      fprintf(stderr, "Device %d read back wrong temperatures\n", i);
+      return 1;
+    }
+  }
+
+  printf("Simulated round trip %.0f us, %u Hz bus, %d sweeps of %d devices\n",
+      timing.round_trip_us, timing.i2c_hz, iterations, ir_temp::NUM_DEVICES);
+
+  run("get_amb + get_obj", iterations, []() {
+      for (int d = 0; d < ir_temp::NUM_DEVICES; ++d) {
+        ir_temp::get_amb((ir_temp::Device) d);
+        ir_temp::get_obj((ir_temp::Device) d);
+      }
+    });
+  run("read_all", iterations, []() {
+      for (int d = 0; d < ir_temp::NUM_DEVICES; ++d)
+        ir_temp::read_all((ir_temp::Device) d);
+    });
+
+  // What loop() pays per spin with the cache: one poll, then cached reads
+  run("poll + cached", iterations, []() {
+      ir_temp::poll();
+      for (int d = 0; d < ir_temp::NUM_DEVICES; ++d)
+        ir_temp::cached((ir_temp::Device) d);
+    });
+
+  // Unplugged rotor sensors trip their circuit breakers after a few failed
+  // reads, then cost nothing until they are re-probed
+  for (int i = ir_temp::R_ROTOR; i < ir_temp::NUM_DEVICES; ++i)
+    sim::attach_i2c(1, kAddrs[i], nullptr);
+  run("read_all, rotors out", iterations, []() {
+      for (int d = 0; d < ir_temp::NUM_DEVICES; ++d)
+        ir_temp::read_all((ir_temp::Device) d);
+    });
+  for (int i = ir_temp::R_ROTOR; i < ir_temp::NUM_DEVICES; ++i) {
+    auto h = ir_temp::get_health((ir_temp::Device) i);
+    printf("  device %d: %s, %lu failures, %lu skipped\n", i,
+        h.state == health::UP ? "up" : "down", h.failures, h.skipped);
+  }
+
+  // PEC cost alone, bit loop vs table, over every possible data word
+  const int kWords = 1 << 16;
+  const int kRepeats = 20;
+  volatile uint8_t sink = 0;
+
+  double start = now_us();
+  for (int r = 0; r < kRepeats; ++r) {
+    for (uint32_t w = 0; w < kWords; ++w) {
+      sink = sink + util::crc8((uint64_t) 0xB4 << 32 | (uint64_t) 0x07 << 24 |
+          (uint64_t) 0xB5 << 16 | (uint64_t) (w & 0xFF) << 8 | (w >> 8));
+    }
+  }
+  double bit_ns = (now_us() - start) * 1e3 / (kRepeats * kWords);
+
+  start = now_us();
+  for (int r = 0; r < kRepeats; ++r) {
+    for (uint32_t w = 0; w < kWords; ++w) {
+      const uint8_t frame[] = {0xB4, 0x07, 0xB5, (uint8_t) w,
+        (uint8_t) (w >> 8)};
+      sink = sink + util::crc8(frame, sizeof(frame));
+    }
+  }
+  double table_ns = (now_us() - start) * 1e3 / (kRepeats * kWords);
+
+  printf("PEC bit loop %6.1f ns/word, table %6.1f ns/word\n", bit_ns,
+      table_ns);
+
+  ir_temp::end();
+  ir_temp::close();
+
+  return 0;
+}
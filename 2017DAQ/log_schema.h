@@ -0,0 +1,36 @@
+#ifndef LOG_SCHEMA_H_
+#define LOG_SCHEMA_H_
+
+// Columns of a log, shared by the driver and the tools that read its logs.
+// Outside testing mode a log has only the first kTestingStartPos.
+namespace acquire {
+const char *const kCsvHeaders[] = {
+  "Time (s)",
+  "Accelerometer X",
+  "Accelerometer Y",
+  "Acceleroemter Z",
+  "Ambient Temp",
+  // Sensors needed for Display.
+  "CVT Temp",
+  "Rear HAL",
+  "Tachometer",
+  "Battery Voltage",
+  // Testing Only from this point forward [9-21).
+  "Front Right HAL",
+  "Front Left HAL",
+  "Front Breakline Pressure",
+  "Rear Breakline Pressure",
+  "Steering Angle",
+  "Front Right Suspension Travel",
+  "Front Left Suspension Travel",
+  "Rear Right Suspension Travel",
+  "Rear Left Suspension Travel",
+  "Front Right Rotor Temp",
+  "Front Left Rotor Temp",
+  "Rear Rotor Temp",
+};
+const unsigned kTestingStartPos = 9;
+const unsigned kHeadersLen = sizeof(kCsvHeaders) / sizeof(*kCsvHeaders);
+}  // namespace acquire
+
+#endif  // LOG_SCHEMA_H_
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "csv_load.h"
+#include "session_cache.h"
+
+using namespace std;
+
+const char *usage =
+  "Usage: %s [-f] [-j threads] log.csv...\n"
+  "  -f  convert even if the cache is newer than the log\n"
+  "  -j  threads to parse with, one per core by default\n"
+  "Converts each log once into a cache beside it (see session_cache.h),\n"
+  "RECORD_0001.csv into RECORD_0001.cache\n";
+
+// Whether the cache is at least as new as the log it's of
+bool up_to_date(const string &log, const string &cache) {
+  struct stat log_st, cache_st;
+  return stat(log.c_str(), &log_st) == 0 &&
+    stat(cache.c_str(), &cache_st) == 0 &&
+    cache_st.st_mtime >= log_st.st_mtime;
+}
+
+int main(int argc, char **argv) {
+  bool force = false;
+  unsigned threads = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "fj:")) != -1) {
+    switch (opt) {
+      case 'f':
+        force = true;
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      default:
+        printf(usage, *argv);
+        return -1;
+    }
+  }
+  if (optind == argc) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  int failures = 0;
+  for (int i = optind; i < argc; ++i) {
+    string log = argv[i];
+    string cache = session_cache::cache_filename(log);
+    if (!force && up_to_date(log, cache)) {
+      printf("%s: up to date\n", cache.c_str());
+      continue;
+    }
+
+    csv_load::Table table;
+    string error;
+    long rows = csv_load::load(log, table, error, threads);
+    if (rows < 0 || !session_cache::write(table, cache, error)) {
+      fprintf(stderr, "Failed to convert %s\n", error.c_str());
+      ++failures;
+      continue;
+    }
+
+    session_cache::Reader reader;
+    if (!reader.open(cache, error)) {
+      fprintf(stderr, "Failed to read back %s\n", error.c_str());
+      ++failures;
+      continue;
+    }
+    printf("%s: %zu columns, %zu rows%s\n", cache.c_str(), reader.columns(),
+        reader.rows(), reader.layout() ? "" : " (not a driver log)");
+    if (reader.rows() < (size_t) rows)
+      printf("  %zu rows without a time dropped\n", rows - reader.rows());
+  }
+  return failures ? 1 : 0;
+}
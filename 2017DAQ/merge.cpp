@@ -0,0 +1,134 @@
+#include "merge.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+
+#include "csv.h"
+#include "timebase.h"
+
+using namespace std;
+
+namespace merge {
+namespace {
+// A node's log, read a row at a time
+struct Node {
+  ifstream ifs;
+  timebase::Anchor start;
+  vector<string> columns;  // After the time
+  uint64_t time_ns;        // Of the current row, on the shared clock
+  string values;           // Of the current row, after the time
+
+  // Reads the next row, false at the end of the log
+  bool next() {
+    string line;
+    while (getline(ifs, line)) {
+      size_t comma = line.find(',');
+      if (line.empty() || comma == string::npos)
+        continue;
+      time_ns = start.mono_ns + strtoull(line.c_str(), nullptr, 10) * 1000;
+      values = line.substr(comma + 1);
+      return true;
+    }
+    return false;
+  }
+};
+
+vector<string> split(const string &line) {
+  vector<string> fields;
+  size_t begin = 0, comma;
+  while ((comma = line.find(',', begin)) != string::npos) {
+    fields.push_back(line.substr(begin, comma - begin));
+    begin = comma + 1;
+  }
+  fields.push_back(line.substr(begin));
+  return fields;
+}
+}  // anonymous namespace
+
+string time_filename(const string &log) {
+  return log.substr(0, log.rfind('.')) + "_time.csv";
+}
+
+long logs(const vector<string> &inputs, const string &out, string &error) {
+  vector<unique_ptr<Node>> nodes;
+  for (const string &input : inputs) {
+    unique_ptr<Node> node(new Node);
+    string header;
+    node->ifs.open(input);
+    if (!node->ifs || !getline(node->ifs, header)) {
+      error = input;
+      return -1;
+    }
+    if (!timebase::read_csv(time_filename(input).c_str(), node->start)) {
+      error = time_filename(input);
+      return -1;
+    }
+
+    vector<string> columns = split(header);
+    node->columns.assign(columns.begin() + 1, columns.end());
+    nodes.push_back(move(node));
+  }
+  if (nodes.empty())
+    return 0;
+
+  // The session starts with the earliest node
+  const timebase::Anchor *start = &nodes[0]->start;
+  for (const unique_ptr<Node> &node : nodes)
+    if (node->start.mono_ns < start->mono_ns)
+      start = &node->start;
+  // A secondary's wall time is unknown (its monotonic times are the
+  // primary's), take the session's from a node that has one
+  timebase::Anchor session_start = *start;
+  for (const unique_ptr<Node> &node : nodes)
+    if (!session_start.wall_ns && node->start.wall_ns)
+      session_start.wall_ns = timebase::wall_ns(node->start, start->mono_ns);
+  if (!timebase::write_csv(time_filename(out).c_str(), session_start)) {
+    error = time_filename(out);
+    return -1;
+  }
+
+  vector<string> names = {"Time (us)", "Node"};
+  for (unsigned i = 0; i < nodes.size(); ++i)
+    for (const string &column : nodes[i]->columns)
+      names.push_back(to_string(i) + ": " + column);
+  vector<const char *> headers;
+  for (const string &name : names)
+    headers.push_back(name.c_str());
+  Csv csv(out.c_str(), headers);
+
+  // Nodes by the time of their current row, earliest on top
+  typedef pair<uint64_t, unsigned> Head;
+  priority_queue<Head, vector<Head>, greater<Head>> heads;
+  for (unsigned i = 0; i < nodes.size(); ++i)
+    if (nodes[i]->next())
+      heads.push({nodes[i]->time_ns, i});
+
+  long rows = 0;
+  while (!heads.empty()) {
+    unsigned i = heads.top().second;
+    heads.pop();
+    Node &node = *nodes[i];
+
+    csv << (node.time_ns - start->mono_ns) / 1000 << i;
+    for (unsigned j = 0; j < nodes.size(); ++j) {
+      if (j == i) {
+        csv << node.values;
+      } else {
+        for (size_t k = 0; k < nodes[j]->columns.size(); ++k)
+          csv << "";
+      }
+    }
+    csv << Csv::LINE_BREAK;
+    ++rows;
+
+    if (node.next())
+      heads.push({node.time_ns, i});
+  }
+
+  return rows;
+}
+}  // namespace merge
@@ -0,0 +1,26 @@
+#ifndef MERGE_H_
+#define MERGE_H_
+
+#include <string>
+#include <vector>
+
+// Merges node logs into one session. Each node logs on its own, secondaries
+// with their times on the primary's clock (clock_sync.h), as a CSV with its
+// _time.csv time base beside it (convert raw logs with raw2csv first).
+//
+// The session has a row per node row, in time order: its time in us since the
+// earliest node started, its node (index in the inputs), then every node's
+// columns, as "<node>: <column>", with only its node's filled. Logs are
+// k-way merged, reading each once, so memory doesn't grow with their length.
+namespace merge {
+// Time base of a log, "RECORD_0001.csv" has "RECORD_0001_time.csv"
+std::string time_filename(const std::string &log);
+
+// Merges logs into out (and its time base, the earliest node's, with a wall
+// time from a node that has one if it has none). Returns the rows written, or
+// -1 if a log or its time base couldn't be read, with what couldn't in error.
+long logs(const std::vector<std::string> &inputs, const std::string &out,
+    std::string &error);
+}  // namespace merge
+
+#endif  // MERGE_H_
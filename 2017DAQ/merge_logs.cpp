@@ -0,0 +1,31 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "merge.h"
+
+using namespace std;
+
+const char *usage =
+  "Usage: %s out.csv primary.csv secondary.csv...\n"
+  "Merges node logs, each with its _time.csv beside it, into one session.\n"
+  "Raw logs convert with raw2csv first.\n";
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  vector<string> inputs(argv + 2, argv + argc);
+  string error;
+  long rows = merge::logs(inputs, argv[1], error);
+  if (rows < 0) {
+    fprintf(stderr, "Failed to read or write %s\n", error.c_str());
+    return -1;
+  }
+
+  printf("Merged %zu nodes into %ld rows in %s\n", inputs.size(), rows,
+      argv[1]);
+  return 0;
+}
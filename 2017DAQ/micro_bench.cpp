@@ -0,0 +1,146 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+#include "calib.h"
+#include "csv.h"
+#include "display.h"
+#include "ir_temp.h"
+#include "resample.h"
+#include "util.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [name filter]\n";
+
+// Hot path building blocks, one op per call. Inputs walk a range, so results
+// don't hinge on one lucky (or unlucky) value. Runs anywhere, nothing here
+// talks to the daemon.
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    printf(usage, *argv);
+    return -1;
+  }
+  if (argc > 1)
+    bench::filter() = argv[1];
+
+  unsigned i = 0;
+  bench::run("loop overhead", [&]() { bench::keep(++i); });
+
+  // PEC of an MLX90614 read, bit loop and table
+  uint64_t data = 0xB407B5000000;
+  bench::run("util::crc8 (uint64_t)", [&]() {
+      bench::hide(data);
+      bench::keep(util::crc8(data + (++i & 0xFFFF)));
+    });
+  uint8_t frame[] = {0xB4, 0x07, 0xB5, 0x00, 0x00};
+  bench::run("util::crc8 (5 bytes)", [&]() {
+      frame[3] = ++i;
+      bench::keep(util::crc8(frame, sizeof(frame)));
+    });
+
+  float count = 0;
+  bench::run("util::clamp (float)", [&]() {
+      bench::hide(count);
+      bench::keep(util::clamp((float) 0, (float) 3800, 0, 1023, count));
+    });
+  double dcount = 0;
+  bench::run("util::clamp (double)", [&]() {
+      bench::hide(dcount);
+      bench::keep(util::clamp(0.0, 3800.0, 0.0, 1023.0, dcount));
+    });
+
+  // The formulas (what building a table costs per count), then the tables
+  calib::init();
+  const calib::Params hal = calib::get_params(calib::R_HAL);
+  const calib::Params sus = calib::get_params(calib::FL_SUS);
+  bench::run("hal_to_mph (calib::evaluate)", [&]() {
+      bench::keep(calib::evaluate(hal, ++i & 1023));
+    });
+  bench::run("sus_travel (calib::evaluate)", [&]() {
+      bench::keep(calib::evaluate(sus, ++i & 1023));
+    });
+  bench::run("calib::convert (count)", [&]() {
+      bench::keep(calib::convert(calib::FL_SUS, (int) (++i & 1023)));
+    });
+  bench::run("calib::convert (fractional)", [&]() {
+      bench::keep(calib::convert(calib::FL_SUS, (float) (++i & 1023) / 4));
+    });
+  uint16_t raw[calib::NUM_CHANNELS] = {};
+  float out[calib::NUM_CHANNELS];
+  bench::run("calib::convert (all channels)", [&]() {
+      raw[0] = ++i & 1023;
+      calib::convert(raw, out);
+      bench::keep(out);
+    });
+
+  bench::run("display::encode", [&]() {
+      ++i;
+      bench::keep(display::encode(i & 4095, i & 127,
+            display::INFO_DATA_LOGGING));
+    });
+  // Just the post to the display thread's mailbox (not started here)
+  bench::run("display::update", [&]() {
+      ++i;
+      display::update(i & 4095, i & 127, display::INFO_DATA_LOGGING);
+    });
+
+  // Formatting into a stream that goes nowhere, a line per 16 values
+  Csv csv(unique_ptr<ofstream>(new ofstream("/dev/null")), {"bench"});
+  auto csv_op = [&]() {
+      if ((++i & 15) == 0)
+        csv << Csv::LINE_BREAK;
+    };
+  bench::run("Csv << uint64_t", [&]() {
+      csv << (uint64_t) i * 1000003;
+      csv_op();
+    });
+  bench::run("Csv << float", [&]() {
+      csv << (float) i / 7;
+      csv_op();
+    });
+  bench::run("Csv << double", [&]() {
+      csv << (double) i / 7;
+      csv_op();
+    });
+  bench::run("Csv << LINE_BREAK", [&]() { csv << Csv::LINE_BREAK; });
+
+  // Checking a TObj1 frame and converting it, per register in read_all
+  uint8_t word_frame[3];
+  uint16_t word = 0x3AF7;
+  auto build_frame = [&](uint16_t w) {
+      const uint8_t pec_data[] = {0xB4, 0x07, 0xB5, (uint8_t) w,
+        (uint8_t) (w >> 8)};
+      word_frame[0] = w;
+      word_frame[1] = w >> 8;
+      word_frame[2] = util::crc8(pec_data, sizeof(pec_data));
+    };
+  build_frame(word);
+  bench::run("ir_temp decode + word_to_F", [&]() {
+      bench::hide(word_frame);
+      uint16_t w;
+      if (ir_temp::decode_word(ir_temp::CVT_BELT, 0x07, word_frame, &w) ==
+          ir_temp::OK)
+        bench::keep(ir_temp::word_to_F(w));
+    });
+
+  // A loop's worth of samples onto a grid a row per loop, 21 columns like a
+  // testing log
+  const unsigned kColumns = 20;
+  Resampler resampler(0, 1000, UINT64_MAX);
+  for (unsigned ch = 0; ch < kColumns; ++ch)
+    resampler.add(ch < 4 ? Resampler::HOLD : Resampler::LINEAR);
+  float row[kColumns];
+  uint64_t sample_ns = 0, row_ns;
+  bench::run("Resampler push + next (20 columns)", [&]() {
+      sample_ns += 1000;
+      for (unsigned ch = 0; ch < kColumns; ++ch)
+        resampler.push(ch, sample_ns, ch);
+      while (resampler.next(row_ns, row))
+        bench::keep(row[kColumns - 1]);
+    });
+
+  return 0;
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <pigpio.h>
+
+#include "daemon_socket.h"
+#include "stats.h"
+
+using namespace std;
+
+const char *usage =
+  "Usage: %s [-h host] [-p port] [-n calls] [-c conns,...] [-s spi_channel]\n"
+  "          [-b spi_baud] [-i i2c_bus] [-a i2c_addr] [-w gpio] [-j]\n"
+  "Round trip latency of each call type through pigpiod's socket, from one\n"
+  "connection and from several at once (each on its own thread).\n"
+  "  -n  calls per connection per call type (default 2000)\n"
+  "  -c  connection counts to run (default 1,2,4)\n"
+  "  -s  MCP3008 chip select for spi_xfer (default 0), -b its baud\n"
+  "  -i  bus and -a address of an MLX90614 for i2c_zip (default 1, 0x5A)\n"
+  "  -w  also time gpio_write on this gpio (it's toggled, so pick a spare)\n"
+  "  -j  print JSON lines instead of a table\n"
+  "Run against the car's daemon (localhost) or pigpiod_standin.\n";
+
+struct Options {
+  const char *host = "localhost";
+  const char *port = daemon_socket::kDefaultPort;
+  int calls = 2000;
+  vector<int> conns = {1, 2, 4};
+  unsigned spi_channel = 0;
+  unsigned spi_baud = 500000;
+  unsigned i2c_bus = 1;
+  unsigned i2c_addr = 0x5A;
+  int write_gpio = -1;
+  bool json = false;
+};
+
+// A connection and the device handles opened on it
+struct Conn {
+  int fd = -1;
+  int spi = -1;
+  int i2c = -1;
+  unsigned toggle = 0;
+};
+
+// One call of a type on a connection, returns false if it failed
+typedef function<bool(Conn &)> Call;
+
+struct CallType {
+  const char *name;
+  Call call;
+};
+
+bool spi_xfer(Conn &c) {
+  // MCP3008 single ended read of channel 0, as adc::get sends it
+  uint8_t buf[3] = {0x01, 0x80, 0x00};
+  return daemon_socket::command(c.fd, PI_CMD_SPIX, c.spi, 0, buf, 3, buf,
+      3) == 3;
+}
+
+bool i2c_zip(Conn &c) {
+  // MLX90614 TObj1 read word, as ir_temp builds it: combined flag on, write
+  // the command, read LSB MSB PEC, stop, end
+  const uint8_t cmd[] = {0x2, 0x7, 0x1, 0x07, 0x6, 0x3, 0x3, 0x0};
+  uint8_t buf[3];
+  return daemon_socket::command(c.fd, PI_CMD_I2CZ, c.i2c, 0, cmd,
+      sizeof(cmd), buf, sizeof(buf)) == 3;
+}
+
+// Times n calls on each of num_conns connections at once, into hist.
+// Returns the wall time and counts failed calls in errors.
+double run(const Options &opts, vector<Conn> &conns, int num_conns,
+    const Call &call, stats::Histogram &hist, atomic<long> &errors) {
+  atomic<int> ready(0);
+  vector<thread> threads;
+  atomic<bool> go(false);
+
+  for (int t = 0; t < num_conns; ++t) {
+    threads.emplace_back([&, t]() {
+        Conn &conn = conns[t];
+        ++ready;
+        while (!go) {}
+        for (int i = 0; i < opts.calls; ++i) {
+          uint64_t call_start = stats::now_ns();
+          bool ok = call(conn);
+          hist.record(stats::now_ns() - call_start);
+          if (!ok)
+            ++errors;
+        }
+      });
+  }
+  while (ready < num_conns) {}
+  uint64_t start = stats::now_ns();
+  go = true;
+  for (thread &t : threads)
+    t.join();
+  return (stats::now_ns() - start) / 1e9;
+}
+
+bool parse(int argc, char **argv, Options &opts) {
+  int opt;
+  while ((opt = getopt(argc, argv, "h:p:n:c:s:b:i:a:w:j")) != -1) {
+    switch (opt) {
+      case 'h': opts.host = optarg; break;
+      case 'p': opts.port = optarg; break;
+      case 'n': opts.calls = atoi(optarg); break;
+      case 'c': {
+        opts.conns.clear();
+        for (char *p = optarg; *p; ) {
+          opts.conns.push_back(strtol(p, &p, 10));
+          if (*p == ',')
+            ++p;
+          else if (*p)
+            return false;
+        }
+        break;
+      }
+      case 's': opts.spi_channel = atoi(optarg); break;
+      case 'b': opts.spi_baud = atoi(optarg); break;
+      case 'i': opts.i2c_bus = atoi(optarg); break;
+      case 'a': opts.i2c_addr = strtol(optarg, nullptr, 0); break;
+      case 'w': opts.write_gpio = atoi(optarg); break;
+      case 'j': opts.json = true; break;
+      default: return false;
+    }
+  }
+  for (int n : opts.conns)
+    if (n <= 0)
+      return false;
+  return opts.calls > 0 && !opts.conns.empty();
+}
+
+int main(int argc, char **argv) {
+  Options opts;
+  if (!parse(argc, argv, opts)) {
+    fprintf(stderr, usage, *argv);
+    return -1;
+  }
+
+  int max_conns = 0;
+  for (int n : opts.conns)
+    max_conns = max(max_conns, n);
+
+  // Every connection opens its own handles, like the driver's modules do
+  vector<Conn> conns(max_conns);
+  uint32_t flags = 0;
+  for (Conn &c : conns) {
+    c.fd = daemon_socket::connect_to(opts.host, opts.port);
+    if (c.fd < 0) {
+      fprintf(stderr, "Can't connect to %s:%s\n", opts.host, opts.port);
+      return 1;
+    }
+    c.spi = daemon_socket::command(c.fd, PI_CMD_SPIO, opts.spi_channel,
+        opts.spi_baud, &flags, 4);
+    c.i2c = daemon_socket::command(c.fd, PI_CMD_I2CO, opts.i2c_bus,
+        opts.i2c_addr, &flags, 4);
+    if (c.spi < 0 || c.i2c < 0)
+      fprintf(stderr, "Warning: spi_open %d, i2c_open %d\n", c.spi, c.i2c);
+  }
+
+  // Ticks and banks are unsigned, only a lost connection fails them
+  vector<CallType> types = {
+    {"get_current_tick", [](Conn &c) {
+        return daemon_socket::command(c.fd, PI_CMD_TICK, 0, 0) != INT32_MIN;
+      }},
+    {"gpio_read", [](Conn &c) {
+        return daemon_socket::command(c.fd, PI_CMD_READ, 24, 0) >= 0;
+      }},
+    {"read_bank_1", [](Conn &c) {
+        return daemon_socket::command(c.fd, PI_CMD_BR1, 0, 0) != INT32_MIN;
+      }},
+    {"spi_xfer (3 bytes)", &spi_xfer},
+    {"i2c_zip (read word)", &i2c_zip},
+  };
+  if (opts.write_gpio >= 0) {
+    unsigned gpio = opts.write_gpio;
+    types.push_back({"gpio_write", [gpio](Conn &c) {
+        return daemon_socket::command(c.fd, PI_CMD_WRITE, gpio,
+            c.toggle ^= 1) >= 0;
+      }});
+  }
+
+  if (!opts.json)
+    printf("%-20s %5s %10s %9s %9s %9s %9s %7s\n", "call", "conns",
+        "calls/s", "p50 us", "p90 us", "p99 us", "max us", "errors");
+  for (const CallType &type : types) {
+    for (int n : opts.conns) {
+      stats::Histogram hist;
+      atomic<long> errors(0);
+      double elapsed = run(opts, conns, n, type.call, hist, errors);
+      double rate = hist.count() / elapsed;
+
+      if (opts.json)
+        printf("{\"tool\":\"pigpio_latency\",\"host\":\"%s\",\"call\":\"%s\","
+            "\"conns\":%d,\"calls\":%lu,\"calls_per_s\":%.0f,"
+            "\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,"
+            "\"max_us\":%.1f,\"errors\":%ld}\n", opts.host, type.name, n,
+            (unsigned long) hist.count(), rate, hist.quantile(0.5) / 1e3,
+            hist.quantile(0.9) / 1e3, hist.quantile(0.99) / 1e3,
+            hist.max() / 1e3, errors.load());
+      else
+        printf("%-20s %5d %10.0f %9.1f %9.1f %9.1f %9.1f %7ld\n", type.name,
+            n, rate, hist.quantile(0.5) / 1e3, hist.quantile(0.9) / 1e3,
+            hist.quantile(0.99) / 1e3, hist.max() / 1e3, errors.load());
+      fflush(stdout);
+    }
+  }
+
+  for (Conn &c : conns) {
+    daemon_socket::command(c.fd, PI_CMD_SPIC, c.spi, 0);
+    daemon_socket::command(c.fd, PI_CMD_I2CC, c.i2c, 0);
+    close(c.fd);
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <pigpio.h>
+#include <pigpiod_if2.h>
+
+#include "daemon_socket.h"
+#include "sim_devices.h"
+#include "sim_pigpio.h"
+
+using namespace std;
+
+const char *usage =
+  "Usage: %s [-p port] [-i i2c_hz]\n"
+  "Answers pigpiod's socket protocol from simulated devices: MCP3008s on\n"
+  "both chip selects, MLX90614s at 0x5A-0x5D and a LIS3DH at 0x18 on i2c\n"
+  "bus 1. Only the gpio, tick, spi and i2c commands pigpio_latency uses are\n"
+  "handled, the rest fail.\n";
+
+// The stand-in's own error, pigpiod has one of its own for unknown commands
+const int kUnknownCommand = -1;
+const unsigned kMaxExt = 512;  // Largest extension (or zip reply) handled
+
+int pi = -1;  // Simulated daemon
+
+// Answers one connection's commands until it closes
+void serve(int fd) {
+  daemon_socket::Header header;
+  char ext[kMaxExt], data[kMaxExt];
+
+  while (daemon_socket::recv_all(fd, &header, sizeof(header))) {
+    if (header.p3 > kMaxExt)
+      break;
+    if (header.p3 && !daemon_socket::recv_all(fd, ext, header.p3))
+      break;
+
+    uint32_t flags = 0;
+    if (header.p3 >= 4)
+      memcpy(&flags, ext, 4);
+
+    int res;
+    bool has_data = false;
+    switch (header.cmd) {
+      case PI_CMD_PIGPV: res = 79; break;
+      case PI_CMD_TICK: res = get_current_tick(pi); break;
+      case PI_CMD_BR1: res = read_bank_1(pi); break;
+      case PI_CMD_READ: res = gpio_read(pi, header.p1); break;
+      case PI_CMD_WRITE: res = gpio_write(pi, header.p1, header.p2); break;
+      case PI_CMD_SPIO: res = spi_open(pi, header.p1, header.p2, flags); break;
+      case PI_CMD_SPIC: res = spi_close(pi, header.p1); break;
+      case PI_CMD_SPIW:
+        res = spi_write(pi, header.p1, ext, header.p3);
+        break;
+      case PI_CMD_SPIX:
+        res = spi_xfer(pi, header.p1, ext, data, header.p3);
+        has_data = true;
+        break;
+      case PI_CMD_I2CO: res = i2c_open(pi, header.p1, header.p2, flags); break;
+      case PI_CMD_I2CC: res = i2c_close(pi, header.p1); break;
+      case PI_CMD_I2CZ:
+        res = i2c_zip(pi, header.p1, ext, header.p3, data, kMaxExt);
+        has_data = true;
+        break;
+      default: res = kUnknownCommand; break;
+    }
+
+    // One send for the reply and its data, as the daemon does
+    char reply[sizeof(header) + kMaxExt];
+    header.p3 = res;
+    memcpy(reply, &header, sizeof(header));
+    size_t len = sizeof(header);
+    if (has_data && res > 0) {
+      memcpy(reply + len, data, res);
+      len += res;
+    }
+    if (!daemon_socket::send_all(fd, reply, len))
+      break;
+  }
+
+  close(fd);
+}
+
+int main(int argc, char **argv) {
+  const char *port = daemon_socket::kDefaultPort;
+  sim::Timing timing;  // The socket is the round trip, not the sim
+  timing.round_trip_us = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "p:i:")) != -1) {
+    switch (opt) {
+      case 'p':
+        port = optarg;
+        break;
+      case 'i':
+        timing.i2c_hz = atoi(optarg);
+        break;
+      default:
+        printf(usage, *argv);
+        return -1;
+    }
+  }
+  sim::set_timing(timing);
+
+  sim::Car car;
+  pi = pigpio_start(nullptr, nullptr);
+
+  int server = daemon_socket::listen_on(port);
+  if (server < 0) {
+    perror("listen");
+    return 1;
+  }
+  printf("Stand-in pigpiod listening on port %s\n", port);
+  fflush(stdout);
+
+  // A thread per connection, like the daemon
+  for (;;) {
+    int fd = accept(server, nullptr, nullptr);
+    if (fd >= 0)
+      thread(&serve, fd).detach();
+  }
+}
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "calib.h"
+#include "csv.h"
+#include "raw_log.h"
+#include "resample.h"
+#include "timebase.h"
+
+using namespace std;
+
+const char *usage =
+  "Usage: %s [-l] [-t] [-g hz] [-p channel=kind,p0,p1,p2,p3]... in.raw "
+  "[out.csv]\n"
+  "  -l  list the session's calibrations and time base and exit\n"
+  "  -t  follow each ADC column and timed value (the temperatures) with the\n"
+  "      time it was read, in us\n"
+  "  -g  resample onto a grid at hz, interpolating ADC columns between their\n"
+  "      read times and holding the rest from theirs\n"
+  "  -p  convert a channel with these calibration parameters instead of the\n"
+  "      recorded ones (same format as -l)\n"
+  "The time base goes to out_time.csv, next to out.csv\n";
+
+// Rows converted per batch
+const size_t kBlockRows = 4096;
+// Records are complete, so rows never wait long on a channel
+const uint64_t kResampleLatencyNs = 1000000000;
+
+// Converts n of a channel's fixed point counts (see RawLogReader::next),
+// whole counts by table
+void convert_counts(calib::Channel ch, const uint16_t *counts, float *values,
+    size_t n) {
+  const unsigned frac_mask = (1 << RawLog::kCountFracBits) - 1;
+  for (size_t i = 0; i < n; ++i)
+    values[i] = counts[i] & frac_mask ?
+      calib::convert(ch, counts[i] / (float) (frac_mask + 1)) :
+      calib::convert(ch, counts[i] >> RawLog::kCountFracBits);
+}
+
+// Whether a column's values carry their own read times
+bool timed(const RawLogReader::Column &column) {
+  return column.type >= 0 || column.type == RawLog::kTimedFloat;
+}
+
+// Time (us) a timed value was read, ones read before the session read 0
+uint64_t value_time(uint64_t time, int32_t offset) {
+  int64_t at = (int64_t) time + offset;
+  return at > 0 ? at : 0;
+}
+
+// Prints a column's calibration in the format -p takes
+void print_params(const RawLogReader::Column &column) {
+  const calib::Params &params = column.params;
+  printf("%-32s -p %d=%d,%g,%g,%g,%g\n", column.name.c_str(), column.type,
+      params.kind, params.p[0], params.p[1], params.p[2], params.p[3]);
+}
+
+// Parses "channel=kind,p0,p1,p2,p3", missing parameters are 0
+bool parse_params(const char *arg, int &ch, calib::Params &params) {
+  int kind;
+  params = {calib::NONE, {}};
+  int n = sscanf(arg, "%d=%d,%f,%f,%f,%f", &ch, &kind, &params.p[0],
+      &params.p[1], &params.p[2], &params.p[3]);
+  if (n < 2 || ch < 0 || ch >= calib::NUM_CHANNELS || kind < calib::NONE ||
+      kind > calib::SUSPENSION)
+    return false;
+
+  params.kind = (calib::Kind) kind;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool list = false, read_times = false;
+  double grid_hz = 0;
+  vector<pair<int, calib::Params>> overrides;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "ltg:p:")) != -1) {
+    switch (opt) {
+      case 'l':
+        list = true;
+        break;
+      case 't':
+        read_times = true;
+        break;
+      case 'g':
+        grid_hz = strtod(optarg, nullptr);
+        if (grid_hz <= 0) {
+          fprintf(stderr, "Bad grid rate: %s\n", optarg);
+          return -1;
+        }
+        break;
+      case 'p': {
+        int ch;
+        calib::Params params;
+        if (!parse_params(optarg, ch, params)) {
+          fprintf(stderr, "Bad calibration: %s\n", optarg);
+          return -1;
+        }
+        overrides.push_back({ch, params});
+        break;
+      }
+      default:
+        printf(usage, *argv);
+        return -1;
+    }
+  }
+
+  if (optind >= argc || argc - optind > 2) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  RawLogReader reader(argv[optind]);
+  if (!reader.ok()) {
+    fprintf(stderr, "Not a raw log: %s\n", argv[optind]);
+    return -1;
+  }
+
+  const vector<RawLogReader::Column> &columns = reader.columns();
+  const timebase::Anchor &start = reader.time_base();
+  if (list) {
+    for (const RawLogReader::Column &column : columns)
+      if (column.type >= 0)
+        print_params(column);
+    if (reader.has_time_base())
+      printf("Started at %" PRId64 "ns wall, %" PRIu64 "ns monotonic, "
+          "tick %" PRIu32 " (+-%" PRIu32 "ns)\n", start.wall_ns,
+          start.mono_ns, start.tick, start.error_ns);
+    return 0;
+  }
+
+  // Load the session's calibrations, then any corrections
+  for (const RawLogReader::Column &column : columns)
+    if (column.type >= 0)
+      calib::set_params((calib::Channel) column.type, column.params);
+  for (const auto &over : overrides)
+    calib::set_params((calib::Channel) over.first, over.second);
+
+  // Output defaults to the input with a csv extension
+  string out_name = argc - optind == 2 ? argv[optind + 1] : argv[optind];
+  if (argc - optind == 1) {
+    size_t dot = out_name.rfind('.');
+    out_name = out_name.substr(0, dot) + ".csv";
+  }
+
+  // Named like the driver's time base of csv logs
+  string time_name = out_name.substr(0, out_name.rfind('.')) + "_time.csv";
+  if (reader.has_time_base() && !timebase::write_csv(time_name.c_str(), start))
+    fprintf(stderr, "Failed to write %s\n", time_name.c_str());
+
+  // Read times are what the grid interpolates between
+  read_times = read_times && !grid_hz;
+  vector<string> time_headers;
+  for (const RawLogReader::Column &column : columns)
+    if (read_times && timed(column))
+      time_headers.push_back(column.name + " Time (us)");
+
+  vector<const char *> headers;
+  unsigned time_header = 0;
+  for (const RawLogReader::Column &column : columns) {
+    headers.push_back(column.name.c_str());
+    if (read_times && timed(column))
+      headers.push_back(time_headers[time_header++].c_str());
+  }
+  Csv csv(out_name.c_str(), headers);
+
+  const unsigned num_counts = reader.num_counts();
+  const unsigned num_floats = reader.num_floats();
+  const unsigned num_timed = reader.num_timed();
+
+  // A block of records, counts are stored by column so each converts in bulk
+  vector<uint64_t> times(kBlockRows);
+  vector<uint16_t> counts(num_counts * kBlockRows);
+  vector<float> values(num_counts * kBlockRows);
+  vector<float> floats(num_floats * kBlockRows);
+  vector<uint16_t> offsets(num_counts * kBlockRows);
+  vector<int32_t> value_offsets(num_timed * kBlockRows);
+  vector<uint16_t> row_counts(num_counts);
+  size_t total = 0;
+
+  // Resampled sessions go through a Resampler, channels in column order after
+  // the time, and start on the grid line at or after the first time every
+  // channel has a sample, so no row starts out NAN
+  unique_ptr<Resampler> resampler;
+  vector<float> grid_values(columns.size());
+  // Timed values repeat until re-read, each is pushed once
+  vector<uint64_t> pushed(num_timed, UINT64_MAX);
+  size_t grid_rows = 0;
+  auto write_grid = [&]() {
+    uint64_t time_ns;
+    while (resampler->next(time_ns, grid_values.data())) {
+      unsigned ch = 0;
+      for (const RawLogReader::Column &column : columns) {
+        if (column.type == RawLog::kTime)
+          csv << time_ns / 1000;
+        else
+          csv << grid_values[ch++];
+      }
+      csv << Csv::LINE_BREAK;
+      ++grid_rows;
+    }
+  };
+
+  for (;;) {
+    size_t rows = 0;
+    while (rows < kBlockRows &&
+        reader.next(times[rows], row_counts.data(),
+          &floats[rows * num_floats], &offsets[rows * num_counts],
+          &value_offsets[rows * num_timed])) {
+      for (unsigned i = 0; i < num_counts; ++i)
+        counts[i * kBlockRows + rows] = row_counts[i];
+      ++rows;
+    }
+    if (rows == 0)
+      break;
+
+    unsigned adc = 0;
+    for (const RawLogReader::Column &column : columns)
+      if (column.type >= 0) {
+        convert_counts((calib::Channel) column.type,
+            &counts[adc * kBlockRows], &values[adc * kBlockRows], rows);
+        ++adc;
+      }
+
+    if (grid_hz) {
+      const uint64_t period_ns = 1e9 / grid_hz;
+      if (!resampler) {
+        // Every record holds every column, so the first has every channel
+        uint64_t first_us = times[0];
+        for (unsigned i = 0; i < num_counts; ++i)
+          first_us = max<uint64_t>(first_us, times[0] + offsets[i]);
+        for (unsigned i = 0; i < num_timed; ++i)
+          first_us = max(first_us, value_time(times[0], value_offsets[i]));
+        uint64_t start_ns = (first_us * 1000 + period_ns - 1) / period_ns *
+          period_ns;
+        resampler.reset(new Resampler(start_ns, period_ns,
+              kResampleLatencyNs));
+        for (const RawLogReader::Column &column : columns)
+          if (column.type != RawLog::kTime)
+            resampler->add(column.type >= 0 ? Resampler::LINEAR :
+                Resampler::HOLD);
+      }
+
+      for (size_t row = 0; row < rows; ++row) {
+        unsigned ch = 0, adc = 0, flt = 0, tmd = 0;
+        for (const RawLogReader::Column &column : columns) {
+          if (column.type == RawLog::kFloat)
+            resampler->push(ch++, times[row] * 1000,
+                floats[row * num_floats + flt++]);
+          else if (column.type == RawLog::kTimedFloat) {
+            unsigned i = tmd++;
+            uint64_t at = value_time(times[row],
+                value_offsets[row * num_timed + i]) * 1000;
+            if (at != pushed[i])
+              resampler->push(ch, at, floats[row * num_floats + flt]);
+            pushed[i] = at;
+            ++ch;
+            ++flt;
+          } else if (column.type >= 0) {
+            unsigned i = adc++;
+            resampler->push(ch++,
+                (times[row] + offsets[row * num_counts + i]) * 1000,
+                values[i * kBlockRows + row]);
+          }
+        }
+        write_grid();
+      }
+
+      total += rows;
+      continue;
+    }
+
+    for (size_t row = 0; row < rows; ++row) {
+      unsigned adc = 0, flt = 0, tmd = 0;
+      for (const RawLogReader::Column &column : columns) {
+        if (column.type == RawLog::kTime)
+          csv << times[row];
+        else if (column.type == RawLog::kTimedFloat && read_times) {
+          csv << floats[row * num_floats + flt++]
+            << value_time(times[row], value_offsets[row * num_timed + tmd]);
+          ++tmd;
+        } else if (RawLog::is_float(column.type))
+          csv << floats[row * num_floats + flt++];
+        else if (read_times) {
+          csv << values[adc * kBlockRows + row]
+            << times[row] + offsets[row * num_counts + adc];
+          ++adc;
+        } else
+          csv << values[adc++ * kBlockRows + row];
+      }
+      csv << Csv::LINE_BREAK;
+    }
+
+    total += rows;
+  }
+
+  if (resampler) {
+    resampler->finish();
+    write_grid();
+    printf("Resampled %zu records to %zu rows at %gHz in %s\n", total,
+        grid_rows, grid_hz, out_name.c_str());
+    // Records are complete, a drop means the grid skipped real samples
+    if (resampler->dropped()) {
+      fprintf(stderr, "Dropped %lu samples resampling\n",
+          resampler->dropped());
+      return -1;
+    }
+    return 0;
+  }
+
+  printf("Converted %zu records to %s\n", total, out_name.c_str());
+  return 0;
+}
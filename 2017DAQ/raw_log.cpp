@@ -0,0 +1,212 @@
+#include "raw_log.h"
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+using namespace std;
+
+namespace {
+const char kMagic[8] = "DAQRAW3";
+const unsigned kVersionPos = 6;  // Digit of kMagic that versions the layout
+const int kPackedBits = 10;      // Whole counts of DAQRAW1 and DAQRAW2
+const int kMaxCount = calib::kNumCounts - 1;
+
+// Bytes of packed counts per record
+unsigned packed_len(unsigned num_counts) {
+  return (num_counts * kPackedBits + 7) / 8;
+}
+
+template <typename T>
+void write_le(ofstream &ofs, T value) {
+  ofs.write((const char *) &value, sizeof(value));  // Pi and x86 are LE
+}
+
+template <typename T>
+bool read_le(ifstream &ifs, T &value) {
+  return (bool) ifs.read((char *) &value, sizeof(value));
+}
+}  // anonymous namespace
+
+// Instantiate special static LINE_BREAK val
+const RawLog::LineBreak_t RawLog::LINE_BREAK;
+
+RawLog::RawLog(unique_ptr<ofstream> ofs, const vector<Column> &columns,
+    const timebase::Anchor &start)
+    : ofs_(move(ofs)) {
+  ofs_->write(kMagic, sizeof(kMagic));
+  write_le(*ofs_, start.wall_ns);
+  write_le(*ofs_, start.mono_ns);
+  write_le(*ofs_, start.tick);
+  write_le(*ofs_, start.error_ns);
+  write_le<uint16_t>(*ofs_, columns.size());
+
+  for (const Column &column : columns) {
+    uint8_t name_len = strlen(column.name);
+    write_le(*ofs_, name_len);
+    ofs_->write(column.name, name_len);
+    write_le<int8_t>(*ofs_, column.type);
+
+    if (is_float(column.type)) {
+      timed_.push_back(column.type == kTimedFloat ?
+          (int) value_offsets_.size() : -1);
+      if (column.type == kTimedFloat)
+        value_offsets_.push_back(0);
+      ++num_floats_;
+    } else if (column.type >= 0) {
+      const calib::Params &params =
+        calib::get_params((calib::Channel) column.type);
+      write_le<uint8_t>(*ofs_, params.kind);
+      for (float p : params.p)
+        write_le(*ofs_, p);
+      ++num_counts_;
+    }
+  }
+
+  counts_.resize(num_counts_);
+  offsets_.resize(num_counts_);
+  floats_.resize(num_floats_);
+}
+
+RawLog::RawLog(const char *filename, const vector<Column> &columns,
+    const timebase::Anchor &start)
+    : RawLog(unique_ptr<ofstream>(new ofstream(filename, ios::binary)),
+        columns, start) {}
+
+RawLog &RawLog::operator<<(uint64_t time) {
+  time_ = time;
+  return *this;
+}
+
+RawLog &RawLog::operator<<(float value) {
+  if (float_pos_ < num_floats_)
+    floats_[float_pos_++] = value;
+  return *this;
+}
+
+RawLog &RawLog::operator<<(Value value) {
+  if (float_pos_ < num_floats_ && timed_[float_pos_] >= 0) {
+    int64_t offset = (int64_t) (value.time - time_);
+    value_offsets_[timed_[float_pos_]] = offset < INT32_MIN ? INT32_MIN :
+      (offset > INT32_MAX ? INT32_MAX : offset);
+  }
+  return *this << value.value;
+}
+
+RawLog &RawLog::operator<<(Count count) {
+  if (count_pos_ < num_counts_) {
+    // Counts read before the record's time (or not timed) read as 0
+    uint64_t offset = count.time > time_ ? count.time - time_ : 0;
+    offsets_[count_pos_] = offset < UINT16_MAX ? offset : UINT16_MAX;
+
+    // Out of range (or NAN) counts clamp, as the ADC would
+    float value = count.count > 0 ? fminf(count.count, kMaxCount) : 0;
+    counts_[count_pos_++] = lrintf(value * (1 << kCountFracBits));
+  }
+  return *this;
+}
+
+RawLog &RawLog::operator<<(const LineBreak_t &) {
+  write_le(*ofs_, time_);
+  ofs_->write((const char *) counts_.data(),
+      counts_.size() * sizeof(uint16_t));
+  ofs_->write((const char *) offsets_.data(),
+      offsets_.size() * sizeof(uint16_t));
+  ofs_->write((const char *) floats_.data(), floats_.size() * sizeof(float));
+  ofs_->write((const char *) value_offsets_.data(),
+      value_offsets_.size() * sizeof(int32_t));
+
+  // Unlogged columns of a short record read back as 0
+  fill(counts_.begin(), counts_.end(), 0);
+  fill(offsets_.begin(), offsets_.end(), 0);
+  fill(floats_.begin(), floats_.end(), 0);
+  fill(value_offsets_.begin(), value_offsets_.end(), 0);
+  count_pos_ = float_pos_ = 0;
+  return *this;
+}
+
+RawLogReader::RawLogReader(const char *filename)
+    : ifs_(filename, ios::binary) {
+  char magic[sizeof(kMagic)];
+  uint16_t num_columns;
+  if (!ifs_.read(magic, sizeof(magic)) ||
+      memcmp(magic, kMagic, kVersionPos) != 0 || magic[kVersionPos + 1])
+    return;
+
+  version_ = magic[kVersionPos] - '0';
+  if (version_ < 1 || version_ > kMagic[kVersionPos] - '0')
+    return;
+  if (version_ >= 2 && (!read_le(ifs_, start_.wall_ns) ||
+        !read_le(ifs_, start_.mono_ns) || !read_le(ifs_, start_.tick) ||
+        !read_le(ifs_, start_.error_ns)))
+    return;
+  if (!read_le(ifs_, num_columns))
+    return;
+
+  for (unsigned i = 0; i < num_columns; ++i) {
+    Column column;
+    uint8_t name_len;
+    int8_t type;
+    if (!read_le(ifs_, name_len))
+      return;
+    column.name.resize(name_len);
+    if (!ifs_.read(&column.name[0], name_len) || !read_le(ifs_, type))
+      return;
+    column.type = type;
+    column.params = {calib::NONE, {}};
+
+    if (RawLog::is_float(type)) {
+      num_timed_ += type == RawLog::kTimedFloat;
+      ++num_floats_;
+    } else if (type >= 0) {
+      uint8_t kind;
+      if (!read_le(ifs_, kind))
+        return;
+      column.params.kind = (calib::Kind) kind;
+      for (float &p : column.params.p)
+        if (!read_le(ifs_, p))
+          return;
+      ++num_counts_;
+    }
+
+    columns_.push_back(column);
+  }
+
+  if (version_ < 3)
+    packed_.resize(packed_len(num_counts_));
+  offsets_.resize(num_counts_);
+  value_offsets_.resize(num_timed_);
+  ok_ = true;
+}
+
+bool RawLogReader::next(uint64_t &time, uint16_t *counts, float *floats,
+    uint16_t *offsets, int32_t *value_offsets) {
+  if (!offsets)
+    offsets = offsets_.data();
+  if (!value_offsets)
+    value_offsets = value_offsets_.data();
+  if (version_ < 2)
+    fill(offsets, offsets + num_counts_, 0);
+
+  if (!ok_ || !read_le(ifs_, time) ||
+      !(version_ >= 3 ?
+        ifs_.read((char *) counts, num_counts_ * sizeof(uint16_t)) :
+        ifs_.read((char *) packed_.data(), packed_.size())) ||
+      (version_ >= 2 &&
+       !ifs_.read((char *) offsets, num_counts_ * sizeof(uint16_t))) ||
+      !ifs_.read((char *) floats, num_floats_ * sizeof(float)) ||
+      !ifs_.read((char *) value_offsets, num_timed_ * sizeof(int32_t)))
+    return false;
+
+  // Whole counts of older sessions, into fixed point
+  if (version_ < 3)
+    for (unsigned i = 0; i < num_counts_; ++i) {
+      unsigned bit = i * kPackedBits;
+      uint32_t bits = packed_[bit / 8];
+      if (bit / 8 + 1 < packed_.size())
+        bits |= packed_[bit / 8 + 1] << 8;
+      counts[i] = ((bits >> (bit % 8)) & 0x3FF) << RawLog::kCountFracBits;
+    }
+
+  return true;
+}
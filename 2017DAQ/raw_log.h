@@ -0,0 +1,139 @@
+#ifndef RAW_LOG_H_
+#define RAW_LOG_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "calib.h"
+#include "timebase.h"
+
+// Binary session log holding raw ADC counts, in fixed point so oversampled
+// channels keep their fraction (see decimate.h), instead of converted values.
+// The session header records every ADC column's calibration so raw2csv can
+// convert a whole session afterwards, with the recorded or corrected
+// calibrations. It also records the session's time base, and when each count
+// (and each timed float) was read.
+//
+// Layout (little endian):
+//  Header: "DAQRAW3\0", the time base anchor (int64 wall ns, uint64 monotonic
+//          ns, uint32 tick, uint32 error ns), uint16 column count, then per
+//          column: uint8 name length, name, int8 type, and for ADC columns
+//          uint8 calib::Kind and 4 float parameters.
+//  Record: uint64 time, a uint16 per ADC column of its count with
+//          kCountFracBits fractional bits, a uint16 per ADC column of the us
+//          its count was read after the record's time (saturating), a
+//          float32 per float or timed float column in column order, then an
+//          int32 per timed float column of the us its value was read after
+//          the record's time (negative if before, saturating).
+// DAQRAW1 and DAQRAW2 sessions pack whole counts, 10 bits each LSB first in
+// column order (padded to a byte), in place of the fixed point counts.
+// DAQRAW1 sessions have neither the time base nor the read times, and only
+// DAQRAW3 sessions have timed floats.
+class RawLog {
+ public:
+  // Type for ending a record
+  static const struct LineBreak_t {} LINE_BREAK;
+
+  // Column types, ADC columns use their calib::Channel
+  static const int kTimedFloat = -3;  // A float read apart from its record
+  static const int kTime = -2;
+  static const int kFloat = -1;
+  struct Column { const char *name; int type; };
+
+  static bool is_float(int type) {
+    return type == kFloat || type == kTimedFloat;
+  }
+
+  // Fractional bits of logged counts. Means of up to decimate::kMaxRatio
+  // reads keep every bit at power of 2 ratios, and 1023 still fits in 16 bits.
+  static const int kCountFracBits = 6;
+
+  // ADC count for the next ADC column, a mean if oversampled, and the time it
+  // was read in the record time's units (us)
+  struct Count { float count; uint64_t time; };
+
+  // Value for the next float column, and the time it was read (us). Plain
+  // floats in timed float columns read as read at the record's time.
+  struct Value { float value; uint64_t time; };
+
+  // Takes ownership of file stream. start is the session's time base.
+  RawLog(std::unique_ptr<std::ofstream> ofs,
+      const std::vector<Column> &columns, const timebase::Anchor &start);
+  RawLog(const char *filename, const std::vector<Column> &columns,
+      const timebase::Anchor &start);
+
+  RawLog() = delete;
+  RawLog(const RawLog &) = delete;
+  RawLog &operator=(const RawLog &) = delete;
+
+  // Values fill their column type in column order, so the order of ADC
+  // columns and of float (and timed float) columns must match the header.
+  // Print LINE_BREAK to write the record.
+  RawLog &operator<<(uint64_t time);
+  RawLog &operator<<(float value);
+  RawLog &operator<<(double value) { return *this << (float) value; }
+  RawLog &operator<<(Count count);
+  RawLog &operator<<(Value value);
+  RawLog &operator<<(const LineBreak_t &);
+
+ private:
+  std::unique_ptr<std::ofstream> ofs_;
+  unsigned num_counts_ = 0, num_floats_ = 0;  // Per record, from the header
+  std::vector<int> timed_;  // Per float, its index among timed floats or -1
+
+  // Current record
+  uint64_t time_ = 0;
+  std::vector<uint16_t> counts_;
+  std::vector<uint16_t> offsets_;
+  std::vector<float> floats_;
+  std::vector<int32_t> value_offsets_;
+  unsigned count_pos_ = 0, float_pos_ = 0;
+};
+
+// Reads back a RawLog session
+class RawLogReader {
+ public:
+  struct Column {
+    std::string name;
+    int type;               // kTime, kFloat, kTimedFloat or calib::Channel
+    calib::Params params;   // Recorded calibration of ADC columns
+  };
+
+  explicit RawLogReader(const char *filename);
+
+  // False if the file could not be opened or is not a RawLog
+  bool ok() const { return ok_; }
+  // False for DAQRAW1 sessions, whose anchor is all 0 and read times 0
+  bool has_time_base() const { return version_ >= 2; }
+  const timebase::Anchor &time_base() const { return start_; }
+  const std::vector<Column> &columns() const { return columns_; }
+  unsigned num_counts() const { return num_counts_; }
+  // Float and timed float columns
+  unsigned num_floats() const { return num_floats_; }
+  unsigned num_timed() const { return num_timed_; }
+
+  // Reads the next record, counts and floats get num_counts()/num_floats()
+  // values in column order, offsets (if not nullptr) the us each count was
+  // read after time, and value_offsets (if not nullptr) the us each timed
+  // float was. Counts are in fixed point with RawLog::kCountFracBits
+  // fractional bits, whatever the session's version. Returns false at the end
+  // of the session.
+  bool next(uint64_t &time, uint16_t *counts, float *floats,
+      uint16_t *offsets = nullptr, int32_t *value_offsets = nullptr);
+
+ private:
+  std::ifstream ifs_;
+  bool ok_ = false;
+  int version_ = 0;
+  timebase::Anchor start_ = {0, 0, 0, 0};
+  std::vector<Column> columns_;
+  unsigned num_counts_ = 0, num_floats_ = 0, num_timed_ = 0;
+  std::vector<uint8_t> packed_;
+  std::vector<uint16_t> offsets_;
+  std::vector<int32_t> value_offsets_;
+};
+
+#endif  // RAW_LOG_H_
@@ -0,0 +1,168 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "calib.h"
+#include "raw_log.h"
+#include "test.h"
+#include "timebase.h"
+
+// Counts as read back, in fixed point
+uint16_t fixed(float count) {
+  return count * (1 << RawLog::kCountFracBits);
+}
+
+template <typename T>
+void write_le(std::ofstream &ofs, T value) {
+  ofs.write((const char *) &value, sizeof(value));
+}
+
+// Writes a session of every count on two channels, then reads it back
+int main(int argc, char **argv) {
+  calib::init();
+  const timebase::Anchor start = {1500000000123456789, 987654321, 0xFFFFFFF0,
+    1234};
+
+  // The battery is read 100i us into each record, so later reads saturate.
+  // Its counts are oversampled means, with a fraction.
+  {
+    RawLog log("raw_log_test.raw", {
+        {"Time", RawLog::kTime},
+        {"Rear HAL", calib::R_HAL},
+        {"Value", RawLog::kFloat},
+        {"Battery", calib::BATTERY},
+      }, start);
+
+    for (int i = 0; i < calib::kNumCounts; ++i) {
+      uint64_t time = (uint64_t) i * 1000;
+      log << time << RawLog::Count{(float) i, time} << i * 0.5f
+        << RawLog::Count{calib::kNumCounts - 1 - i + (i % 4) * 0.25f,
+          time + i * 100}
+        << RawLog::LINE_BREAK;
+    }
+  }
+
+  RawLogReader reader("raw_log_test.raw");
+  test::check("Header read", reader.ok());
+  test::check("Column counts",
+      reader.columns().size() == 4 && reader.num_counts() == 2 &&
+      reader.num_floats() == 1);
+  test::check("Battery calibration recorded",
+      reader.columns()[3].params.p[3] ==
+      calib::get_params(calib::BATTERY).p[3]);
+  const timebase::Anchor &read_start = reader.time_base();
+  test::check("Time base recorded", reader.has_time_base() &&
+      read_start.wall_ns == start.wall_ns &&
+      read_start.mono_ns == start.mono_ns && read_start.tick == start.tick &&
+      read_start.error_ns == start.error_ns);
+
+  uint64_t time;
+  uint16_t counts[2], offsets[2];
+  float value;
+  int rows = 0;
+  bool records = true, read_times = true;
+  while (reader.next(time, counts, &value, offsets)) {
+    uint64_t read_at = rows * 100;
+    records = records && time == (uint64_t) rows * 1000 &&
+      counts[0] == fixed(rows) &&
+      counts[1] == fixed(calib::kNumCounts - 1 - rows + (rows % 4) * 0.25f) &&
+      value == rows * 0.5f;
+    read_times = read_times && offsets[0] == 0 &&
+      offsets[1] == (read_at < UINT16_MAX ? read_at : UINT16_MAX);
+    ++rows;
+  }
+  test::check("Records read back", records);
+  test::check("Read times read back, saturating", read_times);
+  test::check("Every record read", rows == calib::kNumCounts);
+
+  // Out of range counts clamp to the ADC's
+  {
+    RawLog log("raw_log_test.raw", {
+        {"Time", RawLog::kTime},
+        {"Battery", calib::BATTERY},
+        {"Battery", calib::BATTERY},
+        {"Battery", calib::BATTERY},
+      }, start);
+    log << (uint64_t) 0 << RawLog::Count{-1, 0} << RawLog::Count{1e6, 0}
+      << RawLog::Count{NAN, 0} << RawLog::LINE_BREAK;
+  }
+  RawLogReader clamped("raw_log_test.raw");
+  uint16_t clamped_counts[3];
+  test::check("Out of range counts clamp",
+      clamped.next(time, clamped_counts, nullptr) &&
+      clamped_counts[0] == 0 &&
+      clamped_counts[1] == fixed(calib::kNumCounts - 1) &&
+      clamped_counts[2] == 0);
+
+  // Timed floats keep when they were read, before or after their record
+  {
+    RawLog log("raw_log_test.raw", {
+        {"Time", RawLog::kTime},
+        {"Temp", RawLog::kTimedFloat},
+        {"Value", RawLog::kFloat},
+        {"Other temp", RawLog::kTimedFloat},
+      }, start);
+    log << (uint64_t) 100000 << RawLog::Value{70.5f, 25000} << 1.5f
+      << RawLog::Value{80.5f, 100250} << RawLog::LINE_BREAK;
+    log << (uint64_t) 200000 << 71.5f << 2.5f
+      << RawLog::Value{81.5f, 200000 + 3000000000ull} << RawLog::LINE_BREAK;
+  }
+  RawLogReader timed("raw_log_test.raw");
+  float floats[3];
+  int32_t value_offsets[2];
+  test::check("Timed floats counted",
+      timed.ok() && timed.num_floats() == 3 && timed.num_timed() == 2 &&
+      timed.columns()[1].type == RawLog::kTimedFloat);
+  bool timed_records =
+    timed.next(time, nullptr, floats, nullptr, value_offsets) &&
+    floats[0] == 70.5f && floats[1] == 1.5f && floats[2] == 80.5f &&
+    value_offsets[0] == -75000 && value_offsets[1] == 250;
+  timed_records = timed_records &&
+    timed.next(time, nullptr, floats, nullptr, value_offsets) &&
+    floats[0] == 71.5f && value_offsets[0] == 0 &&
+    value_offsets[1] == INT32_MAX && !timed.next(time, nullptr, floats);
+  test::check("Timed floats read back, saturating", timed_records);
+
+  // A DAQRAW2 session, of whole counts packed 10 bits each
+  {
+    std::ofstream ofs("raw_log_test.raw", std::ios::binary);
+    ofs.write("DAQRAW2", 8);
+    write_le(ofs, start.wall_ns);
+    write_le(ofs, start.mono_ns);
+    write_le(ofs, start.tick);
+    write_le(ofs, start.error_ns);
+    write_le<uint16_t>(ofs, 3);
+    const char *names[] = {"Time", "Front brake", "Rear brake"};
+    const int8_t types[] = {RawLog::kTime, calib::F_BRAKE, calib::R_BRAKE};
+    for (int i = 0; i < 3; ++i) {
+      write_le<uint8_t>(ofs, strlen(names[i]));
+      ofs.write(names[i], strlen(names[i]));
+      write_le(ofs, types[i]);
+      if (types[i] >= 0) {
+        write_le<uint8_t>(ofs, calib::LINEAR);
+        for (int p = 0; p < 4; ++p)
+          write_le<float>(ofs, p);
+      }
+    }
+    // Counts 1000 and 517, read 12 and 34 us after the record
+    write_le<uint64_t>(ofs, 5000);
+    uint32_t packed = 1000 | 517 << 10;
+    ofs.write((const char *) &packed, 3);
+    write_le<uint16_t>(ofs, 12);
+    write_le<uint16_t>(ofs, 34);
+  }
+  RawLogReader old("raw_log_test.raw");
+  test::check("DAQRAW2 header read",
+      old.ok() && old.has_time_base() && old.num_counts() == 2 &&
+      old.columns()[2].params.kind == calib::LINEAR);
+  test::check("DAQRAW2 counts read into fixed point",
+      old.next(time, counts, nullptr, offsets) && time == 5000 &&
+      counts[0] == fixed(1000) && counts[1] == fixed(517) &&
+      offsets[0] == 12 && offsets[1] == 34 &&
+      !old.next(time, counts, nullptr, offsets));
+
+  remove("raw_log_test.raw");
+  return test::result();
+}
@@ -0,0 +1,102 @@
+#include "resample.h"
+
+#include <cmath>
+
+#include "util.h"
+
+const unsigned Resampler::kMaxChannels;
+const unsigned Resampler::kDepth;
+
+Resampler::Resampler(uint64_t start_ns, uint64_t period_ns,
+    uint64_t max_latency_ns)
+    : period_ns_(period_ns ? period_ns : 1), max_latency_ns_(max_latency_ns),
+      next_ns_(start_ns) {
+  print_assert("Resampler period must be positive", period_ns > 0);
+}
+
+int Resampler::add(Interp interp) {
+  if (num_channels_ >= kMaxChannels)
+    return -1;
+
+  Channel &channel = channels_[num_channels_];
+  channel.interp = interp;
+  channel.head = channel.size = 0;
+  return num_channels_++;
+}
+
+void Resampler::push(unsigned ch, uint64_t time_ns, float value) {
+  if (ch >= num_channels_)
+    return;
+
+  Channel &channel = channels_[ch];
+  if (channel.size && time_ns < channel.at(channel.size - 1).time) {
+    ++dropped_;
+    return;
+  }
+  // When full, drop the sample after the one the next row starts from, so
+  // that row can still be interpolated (over a longer span)
+  if (channel.size == kDepth) {
+    channel.samples[(channel.head + 1) % kDepth] = channel.at(0);
+    channel.head = (channel.head + 1) % kDepth;
+    --channel.size;
+    ++dropped_;
+  }
+
+  channel.samples[(channel.head + channel.size++) % kDepth] = {time_ns, value};
+  if (time_ns > latest_ns_)
+    latest_ns_ = time_ns;
+  prune(channel, next_ns_);
+}
+
+void Resampler::finish() {
+  finished_ = true;
+}
+
+bool Resampler::next(uint64_t &time_ns, float *values) {
+  if (!num_channels_)
+    return false;
+
+  bool ready = true;
+  for (unsigned i = 0; i < num_channels_; ++i) {
+    const Channel &channel = channels_[i];
+    // A held channel only needs a sample to hold, a linear one the sample
+    // after the row too
+    ready = ready && channel.size && (channel.interp == HOLD ?
+        channel.at(0).time <= next_ns_ :
+        channel.at(channel.size - 1).time >= next_ns_);
+  }
+
+  // Channels behind past the latency bound (or for good) hold their last
+  if (!ready && (latest_ns_ < next_ns_ ||
+        (!finished_ && latest_ns_ - next_ns_ < max_latency_ns_)))
+    return false;
+
+  for (unsigned i = 0; i < num_channels_; ++i) {
+    prune(channels_[i], next_ns_);
+    values[i] = value(channels_[i], next_ns_);
+  }
+  time_ns = next_ns_;
+  next_ns_ += period_ns_;
+  return true;
+}
+
+void Resampler::prune(Channel &channel, uint64_t time) {
+  while (channel.size >= 2 && channel.at(1).time <= time) {
+    channel.head = (channel.head + 1) % kDepth;
+    --channel.size;
+  }
+}
+
+float Resampler::value(const Channel &channel, uint64_t time) const {
+  if (!channel.size || channel.at(0).time > time)
+    return NAN;
+
+  // Pruned to time, so a second sample is past it
+  const Sample &before = channel.at(0);
+  if (channel.interp == HOLD || channel.size < 2)
+    return before.value;
+
+  const Sample &after = channel.at(1);
+  return before.value + (after.value - before.value) *
+    (double) (time - before.time) / (after.time - before.time);
+}
@@ -0,0 +1,76 @@
+#ifndef RESAMPLE_H_
+#define RESAMPLE_H_
+
+#include <cstdint>
+
+// Puts independently timed channels onto a common time grid. Each channel is
+// a stream of (time, value) samples, in time order, at whatever rate it was
+// read: the ADC every loop, the IR temps a few times a second. A grid row is
+// ready once every LINEAR channel has a sample at or past its time and every
+// HOLD channel one at or before it, or once the streams have run max_latency
+// past it, when channels still behind hold their last value. So a slow HOLD
+// channel never holds rows back. Memory is fixed, each channel keeps at most kDepth samples
+// waiting on the grid, dropping the oldest but the one the next row starts
+// from.
+//
+// raw2csv -g is its only user, fed from a raw session's read times. The
+// driver doesn't resample live.
+//
+// Not thread safe, feed and drain it from one thread.
+class Resampler {
+ public:
+  static const unsigned kMaxChannels = 32;
+  static const unsigned kDepth = 64;
+
+  // How a channel's value is taken between its samples
+  enum Interp {
+    HOLD,    // Its last sample (slow sensors, states)
+    LINEAR,  // Between the samples either side
+  };
+
+  // Rows every period_ns from start_ns (all on one clock, e.g. timebase's)
+  Resampler(uint64_t start_ns, uint64_t period_ns, uint64_t max_latency_ns);
+
+  Resampler(const Resampler &) = delete;
+  Resampler &operator=(const Resampler &) = delete;
+
+  // Adds a channel, returns its index, or -1 past kMaxChannels
+  int add(Interp interp);
+  unsigned num_channels() const { return num_channels_; }
+
+  // Feeds a sample. Samples older than the channel's last are dropped.
+  void push(unsigned ch, uint64_t time_ns, float value);
+
+  // Marks the end of the streams, every row up to the last sample is ready
+  void finish();
+
+  // Takes the next ready row, values gets num_channels() values (NAN before a
+  // channel's first sample). Returns false if no row is ready.
+  bool next(uint64_t &time_ns, float *values);
+
+  // Samples dropped to a full channel or out of order
+  unsigned long dropped() const { return dropped_; }
+
+ private:
+  struct Sample { uint64_t time; float value; };
+  struct Channel {
+    Interp interp;
+    Sample samples[kDepth];  // A ring from head
+    unsigned head, size;
+    const Sample &at(unsigned i) const { return samples[(head + i) % kDepth]; }
+  };
+
+  // Drops a channel's samples before the last one at or before time
+  void prune(Channel &channel, uint64_t time);
+  float value(const Channel &channel, uint64_t time) const;
+
+  Channel channels_[kMaxChannels];
+  unsigned num_channels_ = 0;
+  const uint64_t period_ns_, max_latency_ns_;
+  uint64_t next_ns_;          // Time of the next row
+  uint64_t latest_ns_ = 0;    // Latest sample of any channel
+  bool finished_ = false;
+  unsigned long dropped_ = 0;
+};
+
+#endif  // RESAMPLE_H_
@@ -0,0 +1,119 @@
+#include "resample.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "test.h"
+
+// Streams at the rates the car's sensors run at, onto a 100Hz grid
+const uint64_t kMs = 1000000;
+const uint64_t kPeriod = 10 * kMs;
+
+// A ramp of 1 per ms
+float ramp(uint64_t time) {
+  return (float) time / kMs;
+}
+
+int main(int argc, char **argv) {
+  uint64_t time;
+  float values[2];
+
+  // ADC at an uneven ~1kHz, IR temps at 5Hz, fed as they would arrive
+  {
+    Resampler resampler(0, kPeriod, 50 * kMs);
+    int adc = resampler.add(Resampler::LINEAR);
+    int temp = resampler.add(Resampler::HOLD);
+
+    std::vector<uint64_t> row_times;
+    bool linear = true, held = true, nan_first = true;
+    uint64_t adc_time = 300000;
+    for (uint64_t now = 0; now <= 1000 * kMs; now += kMs / 10) {
+      if (now >= adc_time) {
+        resampler.push(adc, adc_time, ramp(adc_time));
+        adc_time += 700000 + adc_time % 600000;  // 0.7-1.3ms apart
+      }
+      if (now % (200 * kMs) == 0)
+        resampler.push(temp, now, now / (200 * kMs));
+
+      while (resampler.next(time, values)) {
+        row_times.push_back(time);
+        if (time < 300000) {
+          nan_first = nan_first && std::isnan(values[0]);
+          continue;
+        }
+        linear = linear && fabs(values[0] - ramp(time)) < 1e-4;
+        held = held && values[1] == time / (200 * kMs);
+      }
+    }
+
+    bool grid = row_times.size() > 90;
+    for (size_t i = 0; i < row_times.size(); ++i)
+      grid = grid && row_times[i] == i * kPeriod;
+    test::check("Rows on the grid", grid);
+    test::check("Linear channel interpolated", linear);
+    test::check("Held channel keeps its last sample", held);
+    test::check("NAN before a channel's first sample", nan_first);
+    test::check("Nothing dropped", resampler.dropped() == 0);
+  }
+
+  // A slow held channel doesn't hold rows back, so a fast linear one never
+  // fills, whatever the latency bound
+  {
+    Resampler resampler(0, kPeriod, 1000 * kMs);
+    int fast = resampler.add(Resampler::LINEAR);
+    int slow = resampler.add(Resampler::HOLD);
+
+    bool linear = true, held = true;
+    unsigned rows = 0;
+    for (uint64_t now = 0; now <= 1000 * kMs; now += kMs) {
+      if (now % (300 * kMs) == 0)
+        resampler.push(slow, now, now / (300 * kMs));
+      resampler.push(fast, now, ramp(now));
+      while (resampler.next(time, values)) {
+        ++rows;
+        linear = linear && fabs(values[0] - ramp(time)) < 1e-4;
+        held = held && values[1] == time / (300 * kMs);
+      }
+    }
+    test::check("Slow held channel drops nothing",
+        resampler.dropped() == 0 && rows == 101);
+    test::check("Fast channel interpolated beside it", linear);
+    test::check("Slow channel held beside it", held);
+  }
+
+  // A channel that stops holds its value once the latency bound passes
+  {
+    const uint64_t kLatency = 100 * kMs;  // Past kDepth fast samples
+    Resampler resampler(0, kPeriod, kLatency);
+    int fast = resampler.add(Resampler::LINEAR);
+    int slow = resampler.add(Resampler::LINEAR);
+    resampler.push(slow, 0, 1);
+    resampler.push(slow, 5 * kMs, 2);
+
+    bool bounded = true, held = true, linear = true;
+    unsigned rows = 0;
+    for (uint64_t now = 0; now <= 500 * kMs; now += kMs) {
+      resampler.push(fast, now, ramp(now));
+      while (resampler.next(time, values)) {
+        ++rows;
+        bounded = bounded && now - time <= kLatency;
+        held = held && (time < 5 * kMs || values[1] == 2);
+        linear = linear && fabs(values[0] - ramp(time)) < 1e-4;
+      }
+    }
+    test::check("Rows wait no longer than the latency bound",
+        bounded && rows > 40);
+    test::check("Stopped channel holds its last sample", held);
+    test::check("Full channels drop samples", resampler.dropped() > 0);
+    test::check("Rows still interpolate after drops", linear);
+
+    resampler.finish();
+    while (resampler.next(time, values))
+      ++rows;
+    test::check("Finish drains the rows up to the last sample",
+        rows == 51 && time == 500 * kMs);
+  }
+
+  return test::result();
+}
@@ -0,0 +1,89 @@
+#include "rt.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace rt {
+namespace {
+bool memory_locked = false;
+}  // anonymous namespace
+
+int set_fifo(int priority) {
+  sched_param param = {};
+  param.sched_priority = priority;
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+int pin_to_cpu(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+int avoid_cpu(int cpu) {
+  cpu_set_t set;
+  int ret = pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret)
+    return ret;
+
+  CPU_CLR(cpu, &set);
+  // With one core there's nowhere else to go
+  if (CPU_COUNT(&set) == 0)
+    return EINVAL;
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+int lock_memory() {
+  // Freed heap stays mapped (and locked) instead of being trimmed or unmapped
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE))
+    return errno;
+  memory_locked = true;
+  return 0;
+}
+
+void prefault_stack(size_t bytes) {
+  // volatile so the writes aren't optimized away
+  volatile char *stack = (volatile char *) alloca(bytes);
+  long page = sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < bytes; i += page)
+    stack[i] = 0;
+}
+
+void prefault(void *buf, size_t len) {
+  volatile char *bytes = (volatile char *) buf;
+  long page = sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < len; i += page)
+    bytes[i] = bytes[i];
+}
+
+void report(const char *name) {
+  int policy;
+  sched_param param;
+  pthread_getschedparam(pthread_self(), &policy, &param);
+
+  cpu_set_t set;
+  pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+  char cpus[64] = "";
+  for (int cpu = 0, len = 0; cpu < CPU_SETSIZE && len < 60; ++cpu)
+    if (CPU_ISSET(cpu, &set))
+      len += snprintf(cpus + len, sizeof(cpus) - len, len ? ",%d" : "%d",
+          cpu);
+
+  fprintf(stderr, "%s: %s priority %d, cpus %s, memory %s\n", name,
+      policy == SCHED_FIFO ? "SCHED_FIFO" :
+      policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER",
+      param.sched_priority, cpus, memory_locked ? "locked" : "unlocked");
+}
+}  // namespace rt
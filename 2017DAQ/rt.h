@@ -0,0 +1,39 @@
+#ifndef RT_H_
+#define RT_H_
+
+#include <cstddef>
+
+// Real-time execution settings for the acquisition thread: SCHED_FIFO,
+// pinning to a core, and locked, prefaulted memory so a page fault never
+// lands mid sample. Each returns 0, or the errno of a refusal, so callers can
+// report what was granted and carry on without it.
+namespace rt {
+const int kNoCpu = -1;
+const size_t kDefaultStackPrefault = 256 * 1024;
+
+// Makes the calling thread SCHED_FIFO at priority (1-99)
+int set_fifo(int priority);
+
+// Pins the calling thread to cpu
+int pin_to_cpu(int cpu);
+
+// Keeps the calling thread (and threads it starts later) off cpu, so cpu is
+// left to a thread pinned there
+int avoid_cpu(int cpu);
+
+// Locks current and future memory in RAM, and keeps freed heap mapped so it
+// doesn't fault again when reused
+int lock_memory();
+
+// Touches bytes of the calling thread's stack so its pages are resident
+void prefault_stack(size_t bytes = kDefaultStackPrefault);
+
+// Touches every page of buf
+void prefault(void *buf, size_t len);
+
+// Prints what the calling thread was granted (policy, priority, cpus, memory
+// lock) to stderr, prefixed with name
+void report(const char *name);
+}  // namespace rt
+
+#endif  // RT_H_
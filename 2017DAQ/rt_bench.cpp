@@ -0,0 +1,125 @@
+#include "rt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const char *usage = "Usage: %s [seconds per run] [load threads] "
+  "[period in us] [rt priority]\n";
+
+const size_t kChurnBytes = 8 << 20;
+
+atomic<bool> loading(false);
+
+// Spins, competing for cpu
+void spin_load(int avoid) {
+  if (avoid != rt::kNoCpu)
+    rt::avoid_cpu(avoid);
+  volatile unsigned long x = 0;
+  while (loading)
+    ++x;
+}
+
+// Allocates, touches and frees large buffers, faulting pages and evicting
+// caches like a logger flushing would
+void churn_load(int avoid) {
+  if (avoid != rt::kNoCpu)
+    rt::avoid_cpu(avoid);
+  while (loading) {
+    char *buf = (char *) malloc(kChurnBytes);
+    memset(buf, 1, kChurnBytes);
+    free(buf);
+  }
+}
+
+double now_us() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Wakes every period_us until seconds pass, recording how late each wake was
+void measure(double seconds, double period_us, vector<double> &late) {
+  timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  double target = next.tv_sec * 1e6 + next.tv_nsec / 1e3;
+  double end = target + seconds * 1e6;
+
+  while (target < end) {
+    target += period_us;
+    next.tv_sec = (time_t) (target / 1e6);
+    next.tv_nsec = (long) ((target - next.tv_sec * 1e6) * 1e3);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    late.push_back(now_us() - target);
+  }
+}
+
+void run(const char *name, double seconds, int loaders, double period_us,
+    int priority, bool real_time) {
+  int cpu = rt::kNoCpu;
+  if (real_time) {
+    // Take the last core, leave the rest to the load
+    cpu = thread::hardware_concurrency() - 1;
+    rt::lock_memory();
+  }
+
+  loading = true;
+  vector<thread> load;
+  for (int i = 0; i < loaders; ++i)
+    load.emplace_back(i % 2 ? churn_load : spin_load, cpu);
+
+  vector<double> late;
+  late.reserve(seconds * 1e6 / period_us + 1);
+  thread sampler([&]() {
+      if (real_time) {
+        int err;
+        if ((err = rt::set_fifo(priority)))
+          fprintf(stderr, "SCHED_FIFO refused: %s\n", strerror(err));
+        if ((err = rt::pin_to_cpu(cpu)))
+          fprintf(stderr, "Pinning refused: %s\n", strerror(err));
+        rt::prefault_stack();
+        rt::prefault(late.data(), late.capacity() * sizeof(double));
+      }
+      rt::report(name);
+      measure(seconds, period_us, late);
+    });
+  sampler.join();
+
+  loading = false;
+  for (thread &t : load)
+    t.join();
+
+  sort(late.begin(), late.end());
+  auto pct = [&](double p) { return late[(size_t) (p * (late.size() - 1))]; };
+  size_t over = late.end() -
+    lower_bound(late.begin(), late.end(), period_us);
+  printf("%-10s wake latency us: p50 %7.1f  p99 %7.1f  p99.9 %7.1f  "
+      "max %8.1f  missed periods %zu/%zu\n", name, pct(0.5), pct(0.99),
+      pct(0.999), late.back(), over, late.size());
+}
+
+int main(int argc, char **argv) {
+  if (argc > 5) {
+    printf(usage, *argv);
+    return -1;
+  }
+
+  double seconds = argc > 1 ? strtod(argv[1], nullptr) : 5;
+  int loaders = argc > 2 ? atoi(argv[2]) : thread::hardware_concurrency() * 2;
+  double period_us = argc > 3 ? strtod(argv[3], nullptr) : 1000;
+  int priority = argc > 4 ? atoi(argv[4]) : 80;
+
+  printf("%u cpus, %d load threads, %.0f us period, %.0f s per run\n",
+      thread::hardware_concurrency(), loaders, period_us, seconds);
+
+  run("default", seconds, loaders, period_us, priority, false);
+  run("real-time", seconds, loaders, period_us, priority, true);
+  return 0;
+}
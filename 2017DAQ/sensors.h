@@ -1,12 +1,15 @@
 #ifndef SENSORS_H_
 #define SENSORS_H_
 
+#include <cstdint>
 #include <functional>
 #include <tuple>
 
 #include "accel.h"
 #include "adc.h"
+#include "calib.h"
 #include "ir_temp.h"
+#include "timebase.h"
 
 namespace sensors {
 // Forwards to setup and tear down of dependencies
@@ -15,8 +18,15 @@ void begin();
 void end();
 void close();
 
+// Refreshes slow sensors (at most one device per call), call once per loop
+void poll();
+
 // ADC
 
+// Count of a channel, averaged over its decimate ratio, for logging
+// unconverted samples. Convert with calib::convert.
+float adc_count(calib::Channel ch);
+
 // Speed in mph
 float front_right_hal();
 float front_left_hal();
@@ -36,6 +46,16 @@ float rear_right_suspension();
 // Battery voltage
 float battery_voltage();
 
+// GPIO EDGE TIMING
+
+// Times the hal and tach pulses on gpios instead of reading their freq to
+// voltage converters through the ADC. Call before begin().
+void set_edge_timing(bool enabled);
+// True if ch (a HAL or the tach) is timed from gpio edges
+bool edge_timed(calib::Channel ch);
+// Value of an edge timed channel, mph for HALs, rpm for the tach
+float edge_value(calib::Channel ch);
+
 // ACCEL
 
 // Triple of (x, y, z) accel reading
@@ -44,20 +64,37 @@ std::tuple<float, float, float> accelXYZ();
 // TEMP
 
 // Temperature in Fahrenheit
-float amb_temp();
-float cvt_temp();
-float rear_rotor_temp();
-float front_left_rotor_temp();
-float front_right_rotor_temp();
+// These are served from a cache, refreshed by poll(). time_ns, if set, gets
+// when the value was read (timebase::now_ns()), which can be a while ago.
+float amb_temp(uint64_t *time_ns = nullptr);
+float cvt_temp(uint64_t *time_ns = nullptr);
+float rear_rotor_temp(uint64_t *time_ns = nullptr);
+float front_left_rotor_temp(uint64_t *time_ns = nullptr);
+float front_right_rotor_temp(uint64_t *time_ns = nullptr);
 
 // GPIO
 
 // true/false states
+// Cached from the pins' edges, no daemon call
 bool is_daq();
 bool is_brake();
 
+// Daemon tick of the brake light's last change, 0 if it hasn't changed
+uint32_t brake_edge_tick();
+
+// Logs every daq switch and brake light edge with its tick, and its time in us
+// since start_tick, to a CSV. nullptr stops logging.
+void log_switch_edges(const char *filename, uint32_t start_tick = 0);
+
+// TIME
+
+// Reads the monotonic clock, wall clock and daemon tick together
+timebase::Anchor time_anchor();
+
 // Attach callback to shutdown button press
 // Removes previously set callback
+// Runs on the daemon's callback thread, so it must only hand off the request
+// (e.g. EventLoop::notify), not block
 void on_shutdown(const std::function<void(void)> &callback);
 }  // namespace sensors
 
@@ -0,0 +1,119 @@
+#include "session_cache.h"
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "csv_load.h"
+#include "log_schema.h"
+
+using namespace std;
+
+namespace session_cache {
+namespace {
+// Values gathered into row order a block at a time
+const size_t kBlockRows = 16384;
+
+uint64_t align(uint64_t offset) {
+  return (offset + kAlign - 1) / kAlign * kAlign;
+}
+
+// How many of acquire::kCsvHeaders the log's columns are, if they're all the
+// driver's
+uint32_t layout_of(const vector<string> &headers) {
+  if (headers.size() != acquire::kTestingStartPos &&
+      headers.size() != acquire::kHeadersLen)
+    return 0;
+  for (size_t i = 0; i < headers.size(); ++i)
+    if (headers[i] != acquire::kCsvHeaders[i])
+      return 0;
+  return headers.size();
+}
+
+// Pads the file out to the next kAlign
+bool pad(FILE *file) {
+  static const char padding[kAlign] = {};
+  long end = ftell(file);
+  size_t len = align(end) - end;
+  return end >= 0 && fwrite(padding, 1, len, file) == len;
+}
+
+// Writes a column's values of rows in order, then pads to kAlign
+template <typename T, typename Value>
+bool write_column(FILE *file, const vector<size_t> &order, Value value) {
+  unique_ptr<T[]> block(new T[kBlockRows]);
+  for (size_t begin = 0; begin < order.size(); begin += kBlockRows) {
+    size_t n = min(kBlockRows, order.size() - begin);
+    for (size_t i = 0; i < n; ++i)
+      block[i] = value(order[begin + i]);
+    if (fwrite(block.get(), sizeof(T), n, file) != n)
+      return false;
+  }
+  return pad(file);
+}
+}  // anonymous namespace
+
+bool write(const csv_load::Table &log, const string &filename,
+    string &error) {
+  if (log.headers.empty()) {
+    error = filename + ": log has no columns";
+    return false;
+  }
+
+  // Rows with a time, in time order. Logs are already, so this is one pass.
+  const double *times = log.columns[0].get();
+  vector<size_t> order;
+  order.reserve(log.rows);
+  for (size_t row = 0; row < log.rows; ++row)
+    if (!isnan(times[row]))
+      order.push_back(row);
+  auto earlier = [times](size_t a, size_t b) { return times[a] < times[b]; };
+  if (!is_sorted(order.begin(), order.end(), earlier))
+    stable_sort(order.begin(), order.end(), earlier);
+
+  Header header = {};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.columns = log.headers.size();
+  header.layout = layout_of(log.headers);
+  header.rows = order.size();
+
+  vector<Column> directory(header.columns);
+  uint64_t offset = align(sizeof(Header) + header.columns * sizeof(Column));
+  for (size_t i = 0; i < header.columns; ++i) {
+    Column &column = directory[i];
+    const string &name = i ? log.headers[i] : "Time (us)";
+    strncpy(column.name, name.c_str(), kNameLen - 1);
+    column.type = i ? kFloat : kInt64;
+    column.offset = offset;
+    offset = align(offset + header.rows *
+        (i ? sizeof(float) : sizeof(int64_t)));
+  }
+
+  string temp = filename + ".tmp";
+  FILE *file = fopen(temp.c_str(), "wb");
+  bool ok = file &&
+    fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(directory.data(), sizeof(Column), header.columns, file) ==
+      header.columns &&
+    pad(file);
+  ok = ok && write_column<int64_t>(file, order, [times](size_t row) {
+        return (int64_t) llround(times[row]);
+      });
+  for (size_t i = 1; ok && i < header.columns; ++i) {
+    const double *values = log.columns[i].get();
+    ok = write_column<float>(file, order, [values](size_t row) {
+          return (float) values[row];
+        });
+  }
+
+  if (file && fclose(file) != 0)
+    ok = false;
+  if (!ok || rename(temp.c_str(), filename.c_str()) != 0) {
+    error = filename + ": " + strerror(errno);
+    remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+}  // namespace session_cache
@@ -0,0 +1,204 @@
+#ifndef SESSION_CACHE_H_
+#define SESSION_CACHE_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A log converted once (make_cache) into columns analysis can map and scan
+// as they are. RECORD_0001.csv has RECORD_0001.cache beside it:
+//   Header, then a Column entry per column, then each column's values at a
+//   kAlign aligned offset, all little endian.
+// The first column is the time in us (the first column of every log, whatever
+// the driver's header says), int64 and sorted. The rest are floats, NAN where
+// the log had no value.
+//
+// Reading is header only: Reader maps the file and hands out spans straight
+// into it, nothing is copied or decoded. Writing links session_cache.o.
+namespace csv_load {
+struct Table;
+}  // namespace csv_load
+
+namespace session_cache {
+const char kMagic[8] = {'D', 'A', 'Q', 'C', 'A', 'C', 'H', '1'};
+const uint64_t kAlign = 4096;  // A page, so columns map and prefetch apart
+const size_t kNameLen = 48;
+
+enum Type : uint32_t {
+  kInt64 = 1,
+  kFloat = 2,
+};
+
+struct Header {
+  char magic[8];
+  uint32_t columns;
+  // Leading acquire::kCsvHeaders columns it has (kTestingStartPos or
+  // kHeadersLen), 0 for logs that aren't the driver's, e.g. merged ones
+  uint32_t layout;
+  uint64_t rows;
+  uint64_t reserved[5];
+};
+static_assert(sizeof(Header) == 64, "Header is a cache line");
+
+struct Column {
+  char name[kNameLen];  // Null terminated, cut short if it had to be
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t offset;      // From the start of the file, kAlign aligned
+};
+static_assert(sizeof(Column) == 64, "Column is a cache line");
+
+template <typename T> struct TypeOf;
+template <> struct TypeOf<int64_t> { static const Type value = kInt64; };
+template <> struct TypeOf<float> { static const Type value = kFloat; };
+
+// A column's values, in place
+template <typename T>
+struct Span {
+  const T *data = nullptr;
+  size_t size = 0;
+
+  const T *begin() const { return data; }
+  const T *end() const { return data + size; }
+  const T &operator[](size_t i) const { return data[i]; }
+  bool empty() const { return size == 0; }
+};
+
+// A log's cache, "RECORD_0001.csv" has "RECORD_0001.cache"
+inline std::string cache_filename(const std::string &log) {
+  return log.substr(0, log.rfind('.')) + ".cache";
+}
+
+// Writes a loaded log as a cache, sorting its rows by time and dropping any
+// without one. False with why in error if it couldn't. The cache appears
+// whole or not at all, it's written aside and renamed into place.
+bool write(const csv_load::Table &log, const std::string &filename,
+    std::string &error);
+
+class Reader {
+ public:
+  Reader() = default;
+  ~Reader() { close(); }
+
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
+  // Maps a cache, false with why in error if it isn't one, or is cut short
+  bool open(const std::string &filename, std::string &error);
+  void close();
+
+  size_t rows() const { return header_ ? header_->rows : 0; }
+  size_t columns() const { return header_ ? header_->columns : 0; }
+  unsigned layout() const { return header_ ? header_->layout : 0; }
+  const char *name(size_t i) const { return directory_[i].name; }
+  Type type(size_t i) const { return (Type) directory_[i].type; }
+  // Index of the column with this name, -1 if there's none
+  int find(const char *name) const;
+
+  // Column i's values, empty if they aren't Ts
+  template <typename T>
+  Span<T> column(size_t i) const;
+  Span<int64_t> times() const { return column<int64_t>(0); }
+
+  // Rows [first, second) from from_us up to to_us, by binary search
+  std::pair<size_t, size_t> range(int64_t from_us, int64_t to_us) const;
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+  const Header *header_ = nullptr;
+  const Column *directory_ = nullptr;
+};
+
+inline bool Reader::open(const std::string &filename, std::string &error) {
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    error = filename + ": " + strerror(errno);
+    if (fd >= 0)
+      ::close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void *data = size >= sizeof(Header) ?
+    mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    error = filename + ": not a cache";
+    return false;
+  }
+  data_ = (const char *) data;
+  size_ = size;
+
+  // Everything the spans point at has to be in the file
+  const Header *header = (const Header *) data_;
+  bool ok = memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+    header->columns > 0 &&
+    header->columns <= (size - sizeof(Header)) / sizeof(Column);
+  const Column *directory = (const Column *) (header + 1);
+  for (uint32_t i = 0; ok && i < header->columns; ++i) {
+    const Column &column = directory[i];
+    size_t width = column.type == kInt64 ? sizeof(int64_t) : sizeof(float);
+    ok = (column.type == kInt64 || column.type == kFloat) &&
+      memchr(column.name, '\0', kNameLen) && column.offset % kAlign == 0 &&
+      column.offset <= size && header->rows <= (size - column.offset) / width;
+  }
+  ok = ok && directory[0].type == kInt64;
+  if (!ok) {
+    error = filename + ": not a cache, or cut short";
+    close();
+    return false;
+  }
+
+  header_ = header;
+  directory_ = directory;
+  return true;
+}
+
+inline void Reader::close() {
+  if (data_)
+    munmap((void *) data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+  header_ = nullptr;
+  directory_ = nullptr;
+}
+
+inline int Reader::find(const char *name) const {
+  for (size_t i = 0; i < columns(); ++i)
+    if (strcmp(directory_[i].name, name) == 0)
+      return i;
+  return -1;
+}
+
+template <typename T>
+inline Span<T> Reader::column(size_t i) const {
+  Span<T> span;
+  if (i < columns() && directory_[i].type == TypeOf<T>::value) {
+    span.data = (const T *) (data_ + directory_[i].offset);
+    span.size = rows();
+  }
+  return span;
+}
+
+inline std::pair<size_t, size_t> Reader::range(int64_t from_us,
+    int64_t to_us) const {
+  Span<int64_t> t = times();
+  size_t first = std::lower_bound(t.begin(), t.end(), from_us) - t.begin();
+  size_t last = std::lower_bound(t.begin() + first, t.end(), to_us) -
+    t.begin();
+  return {first, last};
+}
+}  // namespace session_cache
+
+#endif  // SESSION_CACHE_H_
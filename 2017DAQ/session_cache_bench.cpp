@@ -0,0 +1,135 @@
+#include "bench.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "csv_load.h"
+#include "log_schema.h"
+#include "session_cache.h"
+#include "stats.h"
+
+using namespace std;
+
+const char *usage = "Usage: %s [MB of cache]\n";
+
+const char *kFilename = "/tmp/session_cache_bench.cache";
+const int kScans = 10;  // Repeat scans, the best counts
+
+// Sums values in 8 lanes, so the compiler can keep them in vector registers
+template <typename T>
+double scan(const T *values, size_t n) {
+  T lanes[8] = {};
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    for (int lane = 0; lane < 8; ++lane)
+      lanes[lane] += values[i + lane];
+  double sum = 0;
+  for (; i < n; ++i)
+    sum += values[i];
+  for (T lane : lanes)
+    sum += lane;
+  return sum;
+}
+
+// Every column of the cache
+double scan_all(const session_cache::Reader &reader) {
+  session_cache::Span<int64_t> times = reader.times();
+  double sum = scan(times.data, times.size);
+  for (size_t c = 1; c < reader.columns(); ++c) {
+    session_cache::Span<float> column = reader.column<float>(c);
+    sum += scan(column.data, column.size);
+  }
+  return sum;
+}
+
+// Best rate of kScans runs of op over bytes, in GB/s
+template <typename Op>
+double best_rate(double bytes, Op op) {
+  double best = 0;
+  for (int i = 0; i < kScans; ++i) {
+    uint64_t start = stats::now_ns();
+    bench::keep(op());
+    best = max(best, bytes / ((stats::now_ns() - start) / 1e9) / 1e9);
+  }
+  return best;
+}
+
+// A testing mode session's cache, its first scan (faulting the mapping in),
+// and repeat scans against the same bytes scanned from the heap, the most
+// memory bandwidth a scan gets. Then lookups.
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    printf(usage, *argv);
+    return -1;
+  }
+  double mb = argc > 1 ? strtod(argv[1], nullptr) : 128;
+
+  // A row is a time and a float per column
+  size_t row_bytes = sizeof(int64_t) + (acquire::kHeadersLen - 1) *
+    sizeof(float);
+  size_t rows = mb * 1e6 / row_bytes;
+  csv_load::Table table;
+  table.rows = rows;
+  for (unsigned c = 0; c < acquire::kHeadersLen; ++c) {
+    table.headers.push_back(acquire::kCsvHeaders[c]);
+    table.columns.emplace_back(new double[rows]);
+    for (size_t r = 0; r < rows; ++r)
+      table.columns[c][r] = c ? sin(r * 0.001 + c) * 100 : r * 500.0;
+  }
+  string error;
+  if (!session_cache::write(table, kFilename, error)) {
+    fprintf(stderr, "Failed to write %s\n", error.c_str());
+    return -1;
+  }
+  table.columns.clear();
+  double bytes = rows * row_bytes;
+  printf("%.1f MB cache, %zu rows of %u columns\n", bytes / 1e6, rows,
+      acquire::kHeadersLen);
+
+  session_cache::Reader reader;
+  uint64_t start = stats::now_ns();
+  if (!reader.open(kFilename, error)) {
+    fprintf(stderr, "Failed to open %s\n", error.c_str());
+    return -1;
+  }
+  double open_us = (stats::now_ns() - start) / 1e3;
+  start = stats::now_ns();
+  bench::keep(scan_all(reader));
+  double first = bytes / ((stats::now_ns() - start) / 1e9) / 1e9;
+  double cache = best_rate(bytes, [&]() { return scan_all(reader); });
+
+  // The same bytes on the heap
+  size_t floats = rows * row_bytes / sizeof(float);
+  unique_ptr<float[]> heap(new float[floats]);
+  for (size_t i = 0; i < floats; ++i)
+    heap[i] = i;
+  double memory = best_rate(bytes, [&]() {
+        return scan(heap.get(), floats);
+      });
+  heap.reset();
+
+  printf("open      %8.1f us\n", open_us);
+  printf("scan      %8.2f GB/s first, %.2f GB/s repeat\n", first, cache);
+  printf("heap scan %8.2f GB/s, cache at %.0f%% of it\n", memory,
+      cache / memory * 100);
+
+  // A second's rows at a time (500us rows), anywhere in the session
+  unsigned i = 0;
+  int64_t span = rows * 500;
+  bench::run("Reader::range (1s)", [&]() {
+      int64_t from = (++i * 7919ULL * 500) % span;
+      bench::keep(reader.range(from, from + 1000000));
+    });
+  bench::run("Reader::open", [&]() {
+      session_cache::Reader reopened;
+      bench::keep(reopened.open(kFilename, error));
+    });
+
+  reader.close();
+  remove(kFilename);
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include "session_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "csv.h"
+#include "csv_load.h"
+#include "log_schema.h"
+#include "test.h"
+
+using namespace std;
+
+const char *kLog = "session_cache_test.csv";
+const unsigned kRows = 5000;
+const int64_t kPeriodUs = 1000;
+
+bool same(float a, float b) {
+  return a == b || (isnan(a) && isnan(b));
+}
+
+// Loads and converts the log, false if either fails
+bool convert(const string &cache) {
+  csv_load::Table table;
+  string error;
+  return csv_load::load(kLog, table, error) >= 0 &&
+    session_cache::write(table, cache, error);
+}
+
+int main(int argc, char **argv) {
+  string cache = session_cache::cache_filename(kLog);
+  test::check("Cache sits beside its log", cache == "session_cache_test.cache");
+
+  // A testing mode log, a row every ms, c * 10000 + r in column c of row r,
+  // with two rows out of order and one without a time
+  mt19937 rng(2018);
+  vector<int64_t> times;
+  {
+    Csv csv(kLog, vector<const char *>(acquire::kCsvHeaders,
+          acquire::kCsvHeaders + acquire::kHeadersLen));
+    for (unsigned row = 0; row < kRows; ++row) {
+      int64_t time = row * kPeriodUs;
+      if (row == 100 || row == 101)
+        time = (201 - row) * kPeriodUs + 500;  // Before their neighbours
+      if (row == 300) {
+        csv << "";
+      } else {
+        csv << time;
+        times.push_back(time);
+      }
+      for (unsigned c = 1; c < acquire::kHeadersLen; ++c) {
+        if (c == 5 && row % 7 == 0)
+          csv << NAN;
+        else
+          csv << c * 10000 + row;
+      }
+      csv << Csv::LINE_BREAK;
+    }
+  }
+  test::check("Converts", convert(cache));
+
+  session_cache::Reader reader;
+  string error;
+  test::check("Opens", reader.open(cache, error));
+  test::check("Schema from the driver's headers",
+      reader.layout() == acquire::kHeadersLen &&
+      reader.columns() == acquire::kHeadersLen &&
+      reader.find("Time (us)") == 0 &&
+      reader.find("Steering Angle") == 13 && reader.find("Speed") == -1);
+  test::check("Rows without a time dropped", reader.rows() == kRows - 1);
+
+  session_cache::Span<int64_t> t = reader.times();
+  test::check("Times sorted",
+      is_sorted(t.begin(), t.end()) && t.size == kRows - 1);
+  sort(times.begin(), times.end());
+  test::check("Times kept", equal(t.begin(), t.end(), times.begin()));
+
+  // Rows moved with their times
+  bool values = true;
+  for (unsigned c = 1; c < reader.columns(); ++c) {
+    session_cache::Span<float> column = reader.column<float>(c);
+    for (size_t i = 0; i < column.size; ++i) {
+      int64_t time = t[i];
+      unsigned row = time % kPeriodUs ? 201 - time / kPeriodUs : time /
+        kPeriodUs;
+      float expected = c == 5 && row % 7 == 0 ? NAN : c * 10000 + row;
+      values = values && same(column[i], expected);
+    }
+  }
+  test::check("Values follow their rows", values);
+
+  bool aligned = true;
+  for (unsigned c = 0; c < reader.columns(); ++c) {
+    const void *data = c ? (const void *) reader.column<float>(c).data :
+      (const void *) reader.times().data;
+    aligned = aligned && (uintptr_t) data % session_cache::kAlign == 0;
+  }
+  test::check("Columns aligned", aligned);
+  test::check("Wrong type gives an empty span",
+      reader.column<float>(0).empty() && reader.column<int64_t>(1).empty() &&
+      reader.column<float>(reader.columns()).empty());
+
+  // Ranges against a scan
+  uniform_int_distribution<int64_t> time(-kPeriodUs, kRows * kPeriodUs * 1.1);
+  bool ranges = true;
+  for (int i = 0; i < 1000; ++i) {
+    int64_t from = time(rng), to = time(rng);
+    size_t first = 0, last = 0;
+    for (size_t r = 0; r < t.size; ++r) {
+      first += t[r] < from;
+      last += t[r] < to;
+    }
+    pair<size_t, size_t> range = reader.range(from, to);
+    ranges = ranges && range.first == first &&
+      range.second == max(first, last);
+  }
+  test::check("Range lookups match a scan", ranges);
+  reader.close();
+
+  // A log that isn't the driver's is cached without a layout
+  {
+    Csv csv(kLog, {"Time (us)", "Node", "0: Rear HAL"});
+    csv << 5 << 0 << 1.5 << Csv::LINE_BREAK;
+  }
+  test::check("Other logs convert",
+      convert(cache) && reader.open(cache, error));
+  test::check("Other logs have no layout",
+      reader.layout() == 0 && reader.rows() == 1 &&
+      string(reader.name(2)) == "0: Rear HAL" &&
+      reader.column<float>(2)[0] == 1.5f);
+  reader.close();
+
+  // Cut short, or not a cache at all
+  truncate(cache.c_str(), session_cache::kAlign + 4);
+  test::check("Cut short cache refused", !reader.open(cache, error));
+  test::check("Log refused as a cache", !reader.open(kLog, error));
+  test::check("Missing cache refused",
+      !reader.open("/nonexistent.cache", error) && !error.empty());
+
+  remove(kLog);
+  remove(cache.c_str());
+  return test::result();
+}
@@ -0,0 +1,200 @@
+#include "sim_devices.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <pigpio.h>
+
+#include "util.h"
+
+using namespace std;
+
+namespace sim {
+namespace {
+// Temperature in Kelvin to MLX90614 RAM word (0.02K resolution)
+uint16_t kelvin_to_word(double k) {
+  return (uint16_t) (k / 0.02 + 0.5);
+}
+}  // anonymous namespace
+
+void Mlx90614::set_temps_K(double amb, double obj1, double obj2) {
+  ta_ = kelvin_to_word(amb);
+  tobj1_ = kelvin_to_word(obj1);
+  tobj2_ = kelvin_to_word(obj2);
+}
+
+bool Mlx90614::write(const uint8_t *buf, unsigned len) {
+  if (len != 1)
+    return false;
+  command_ = buf[0];
+  return true;
+}
+
+bool Mlx90614::read(uint8_t *buf, unsigned len) {
+  uint16_t word;
+  switch (command_) {
+    case 0x06: word = ta_; break;
+    case 0x07: word = tobj1_; break;
+    case 0x08: word = tobj2_; break;
+    default: return false;
+  }
+  if (len != 3)
+    return false;
+
+  buf[0] = word & 0xFF;
+  buf[1] = word >> 8;
+  // PEC from the bitwise reference, independent of the table the driver uses
+  buf[2] = util::crc8((uint64_t) ((addr_ << 1) | 0) << 32 |
+                      (uint64_t) command_           << 24 |
+                      (uint64_t) ((addr_ << 1) | 1) << 16 |
+                      (uint64_t) buf[0]             <<  8 |
+                      (uint64_t) buf[1]);
+  return true;
+}
+
+void Lis3dh::set_g(double x, double y, double z) {
+  lock_guard<mutex> lock(mutex_);
+  const double g[] = {x, y, z};
+  for (int i = 0; i < 3; ++i) {
+    // Left justified 16-bit, 8192 counts per g at +/- 4g
+    int16_t word = (int16_t) lround(max(-4.0, min(g[i], 4.0 - 1 / 8192.0)) *
+        8192);
+    regs_[0x28 + 2 * i] = word & 0xFF;
+    regs_[0x29 + 2 * i] = (uint16_t) word >> 8;
+  }
+}
+
+bool Lis3dh::write(const uint8_t *buf, unsigned len) {
+  if (len < 1)
+    return false;
+  lock_guard<mutex> lock(mutex_);
+  increment_ = buf[0] & 0x80;
+  addr_ = buf[0] & 0x7F;
+  for (unsigned i = 1; i < len; ++i)
+    regs_[(addr_ + i - 1) & 0x3F] = buf[i];
+  return true;
+}
+
+bool Lis3dh::read(uint8_t *buf, unsigned len) {
+  lock_guard<mutex> lock(mutex_);
+  for (unsigned i = 0; i < len; ++i)
+    buf[i] = regs_[(addr_ + (increment_ ? i : 0)) & 0x3F];
+  return true;
+}
+
+void Mcp3008::set_noise(double counts) {
+  lock_guard<mutex> lock(mutex_);
+  noise_ = counts;
+}
+
+void Mcp3008::set_input(unsigned ch, double counts) {
+  lock_guard<mutex> lock(mutex_);
+  inputs_[ch & 0x7] = counts;
+}
+
+void Mcp3008::xfer(uint8_t *buf, unsigned len) {
+  // Start bit in byte 0, then single/diff and channel in the top of byte 1
+  if (len < 3 || !(buf[0] & 0x01) || !(buf[1] & 0x80))
+    return;
+
+  double sample;
+  {
+    lock_guard<mutex> lock(mutex_);
+    sample = inputs_[(buf[1] >> 4) & 0x7] + noise_ * gauss_(rng_);
+  }
+  long count = lround(sample);
+  count = count < 0 ? 0 : (count > 1023 ? 1023 : count);
+
+  // Null bit (bit 2 of byte 1) reads 0, then the 10-bit result
+  buf[0] = 0;
+  buf[1] = (count >> 8) & 0x3;
+  buf[2] = count & 0xFF;
+}
+
+EdgeGenerator::EdgeGenerator(unsigned gpio)
+    : gpio_(gpio), thread_(&EdgeGenerator::run, this) {}
+
+EdgeGenerator::~EdgeGenerator() {
+  running_ = false;
+  thread_.join();
+}
+
+void EdgeGenerator::set_hz(double hz) {
+  hz_ = hz;
+}
+
+void EdgeGenerator::run() {
+  // Ticks are kept unwrapped (64-bit) here, and wrap when delivered
+  int64_t base = tick();
+  double next = 0;  // Next rising edge, us after base
+  bool pulsing = false;
+
+  while (running_) {
+    double hz = hz_;
+    int64_t now = base + (uint32_t) (tick() - (uint32_t) base);
+    if (hz <= 0) {
+      pulsing = false;
+      wait_us(1000);
+      continue;
+    }
+    if (!pulsing) {
+      // Restart the wave from now
+      base = now;
+      next = 0;
+      pulsing = true;
+    }
+
+    double period = 1e6 / hz;
+    double due = base + next;
+    if (due > now) {
+      wait_us(due - now);
+      continue;
+    }
+
+    inject_edge(gpio_, PI_HIGH, (uint32_t) llround(due));
+    inject_edge(gpio_, PI_LOW, (uint32_t) llround(due + period / 2));
+    next += period;
+
+    // Keep base recent so the unwrapping above stays in range
+    if (next > 1e9) {
+      base += (int64_t) next;
+      next -= (int64_t) next;
+    }
+  }
+}
+const uint8_t Car::kIrAddrs[4] = {0x5A, 0x5B, 0x5C, 0x5D};
+const uint8_t Car::kAccelAddr;
+const unsigned Car::kDaqSwitchPin;
+
+Car::Car() {
+  for (int cs = 0; cs < 2; ++cs) {
+    adcs[cs].set_noise(0.5);
+    for (unsigned ch = 0; ch < 8; ++ch)
+      adcs[cs].set_input(ch, 512);
+    attach_spi(cs, &adcs[cs]);
+  }
+  for (unsigned i = 0; i < 4; ++i) {
+    ir_temps[i].set_temps_K(300, 350, 350);
+    attach_ir_temp(i, true);
+  }
+  accel.set_g(0, 0, 1);
+  attach_i2c(1, kAccelAddr, &accel);
+}
+
+Car::~Car() {
+  for (int cs = 0; cs < 2; ++cs)
+    attach_spi(cs, nullptr);
+  for (unsigned i = 0; i < 4; ++i)
+    attach_ir_temp(i, false);
+  attach_i2c(1, kAccelAddr, nullptr);
+}
+
+void Car::set_daq(bool on) {
+  inject_edge(kDaqSwitchPin, on, tick());
+}
+
+void Car::attach_ir_temp(unsigned i, bool attached) {
+  attach_i2c(1, kIrAddrs[i], attached ? &ir_temps[i] : nullptr);
+}
+}  // namespace sim
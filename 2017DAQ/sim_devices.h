@@ -0,0 +1,115 @@
+#ifndef SIM_DEVICES_H_
+#define SIM_DEVICES_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "sim_pigpio.h"
+
+// Models of the devices on the car, for attaching to sim_pigpio
+namespace sim {
+// MLX90614 IR thermometer. Answers SMBus read word on its RAM temperature
+// registers with a correct PEC.
+class Mlx90614 : public I2cDevice {
+ public:
+  Mlx90614(uint8_t addr) : addr_(addr) {}
+
+  // Sets the temperatures reported, in Kelvin
+  void set_temps_K(double amb, double obj1, double obj2);
+
+  bool write(const uint8_t *buf, unsigned len) override;
+  bool read(uint8_t *buf, unsigned len) override;
+
+ private:
+  const uint8_t addr_;
+  uint8_t command_ = 0;
+  std::atomic<uint16_t> ta_{0}, tobj1_{0}, tobj2_{0};
+};
+// LIS3DH accelerometer at +/- 4g. Registers are written and read by address
+// (MSB of the address set to auto increment), the axes read as set.
+class Lis3dh : public I2cDevice {
+ public:
+  // Sets the acceleration reported, in g
+  void set_g(double x, double y, double z);
+
+  bool write(const uint8_t *buf, unsigned len) override;
+  bool read(uint8_t *buf, unsigned len) override;
+
+ private:
+  std::mutex mutex_;  // GUARDS everything below
+  uint8_t regs_[0x40] = {};
+  uint8_t addr_ = 0;
+  bool increment_ = false;
+};
+
+// MCP3008 10-bit ADC. Each conversion samples its channel's input plus
+// gaussian noise, then quantizes to a count.
+class Mcp3008 : public SpiDevice {
+ public:
+  // Sets the noise standard deviation, in counts
+  void set_noise(double counts);
+  // Sets a channel's input, in (fractional) counts
+  void set_input(unsigned ch, double counts);
+
+  void xfer(uint8_t *buf, unsigned len) override;
+
+ private:
+  std::mutex mutex_;  // GUARDS everything below
+  double noise_ = 0;
+  double inputs_[8] = {};
+  std::mt19937 rng_;
+  std::normal_distribution<double> gauss_;
+};
+// Square wave on a gpio, e.g. a hall sensor or the tach. Edges are delivered
+// from the generator's own thread, stamped with the tick they were due at
+// like the daemon stamps sampled edges.
+class EdgeGenerator {
+ public:
+  explicit EdgeGenerator(unsigned gpio);
+  ~EdgeGenerator();
+
+  // Sets the pulse frequency, 0 stops the pulses
+  void set_hz(double hz);
+
+ private:
+  void run();
+
+  const unsigned gpio_;
+  std::atomic<double> hz_{0};
+  std::atomic<bool> running_{true};
+  std::thread thread_;
+};
+
+// The car's devices, attached where the driver looks for them: an MCP3008 on
+// each chip select, the four MLX90614s and the LIS3DH on i2c bus 1. Inputs
+// start mid scale with a little noise, temperatures at 300K ambient and 350K
+// object, and the car level at 1g.
+class Car {
+ public:
+  static const uint8_t kIrAddrs[4];
+  static const uint8_t kAccelAddr = 0x18;
+  static const unsigned kDaqSwitchPin = 24;
+
+  Car();
+  ~Car();  // Detaches the devices
+
+  Car(const Car &) = delete;
+  Car &operator=(const Car &) = delete;
+
+  // Flips the daq switch, as an edge now
+  void set_daq(bool on);
+  // Attaches or detaches an IR thermometer, e.g. the front right rotor
+  // sensor, whose presence puts the driver in testing mode
+  void attach_ir_temp(unsigned i, bool attached);
+
+  Mcp3008 adcs[2];
+  Mlx90614 ir_temps[4] = {{kIrAddrs[0]}, {kIrAddrs[1]}, {kIrAddrs[2]},
+    {kIrAddrs[3]}};
+  Lis3dh accel;
+};
+}  // namespace sim
+
+#endif  // SIM_DEVICES_H_
@@ -0,0 +1,623 @@
+#include "sim_pigpio.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <pigpiod_if2.h>
+
+using namespace std;
+
+namespace sim {
+namespace {
+struct I2cHandle { unsigned bus, addr; bool open; };
+
+struct SpiHandle { unsigned channel, baud; bool open; };
+
+// A notification pipe, reports go to fd (its write end) for the gpios in bits
+struct Notify { int fd; uint32_t bits; uint16_t seqno; };
+
+// A callback registered through callback or callback_ex
+struct Callback {
+  unsigned gpio, edge;
+  CBFunc_t f;
+  CBFuncEx_t f_ex;
+  void *userdata;
+};
+
+// A simulated I2C bus, carrying one transfer at a time
+struct I2cBus {
+  mutex wire;       // Held for the duration of a transfer
+  unsigned hz = 0;  // 0 for the hardware bus clock
+};
+
+mutex state_mutex;  // GUARDS everything below
+Timing timing;
+Counters count;
+map<pair<unsigned, unsigned>, I2cDevice *> i2c_devices;  // (bus, addr) keys
+map<unsigned, unique_ptr<I2cBus>> i2c_buses;
+vector<I2cHandle> i2c_handles;
+SpiDevice *spi_devices[3] = {};
+vector<SpiHandle> spi_handles;
+mutex spi_wire;  // Held for the duration of an SPI transfer
+map<unsigned, Callback> callbacks;  // By callback id
+unsigned next_callback = 0;
+uint32_t tick_offset = 0;
+uint32_t gpio_levels = 0;
+vector<vector<unsigned>> scripts;  // Stored scripts as (gpio, level) writes
+map<unsigned, Notify> notifies;  // By handle
+unsigned next_notify = 0;
+char pipe_format[64];
+int next_pi = 0;
+
+I2cDevice *find_i2c(unsigned bus, unsigned addr) {
+  auto it = i2c_devices.find(make_pair(bus, addr));
+  return it == i2c_devices.end() ? nullptr : it->second;
+}
+
+// Caller must hold state_mutex
+I2cBus &get_bus(unsigned bus) {
+  unique_ptr<I2cBus> &b = i2c_buses[bus];
+  if (!b)
+    b.reset(new I2cBus);
+  return *b;
+}
+
+// Charges a daemon round trip
+void charge() {
+  double us;
+  {
+    lock_guard<mutex> lock(state_mutex);
+    ++count.calls;
+    us = timing.round_trip_us;
+  }
+  wait_us(us);
+}
+
+// Charges a daemon round trip plus i2c_bytes on a bus, waiting for the bus
+// if another transfer is on it
+void charge_i2c(unsigned bus, unsigned i2c_bytes) {
+  charge();
+
+  I2cBus *b;
+  double us;
+  {
+    lock_guard<mutex> lock(state_mutex);
+    ++count.i2c_transactions;
+    count.i2c_bytes += i2c_bytes;
+    b = &get_bus(bus);
+    us = i2c_bytes * 9 * 1e6 / (b->hz ? b->hz : timing.i2c_hz);
+  }
+
+  lock_guard<mutex> wire_lock(b->wire);
+  wait_us(us);
+}
+
+// Interprets a zip command sequence against the devices on a bus. The
+// hardware and bit-banged command sets only differ in codes 2 and 3 (combined
+// flag vs start and stop), which make no difference here.
+// Returns bytes read or a pigpio error.
+int zip(unsigned bus, unsigned addr, const char *inBuf, unsigned inLen,
+    char *outBuf, unsigned outLen) {
+  const uint8_t *in = (const uint8_t *) inBuf;
+  unsigned pos = 0, count = 0, wire_bytes = 0;
+  bool escape = false;
+  int status = 0;
+
+  // Reads a command parameter, 16-bit if escaped.
+  auto param = [&]() -> unsigned {
+    unsigned p = in[pos++];
+    if (escape)
+      p |= in[pos++] << 8;
+    escape = false;
+    return p;
+  };
+  auto device = [&]() {
+    lock_guard<mutex> lock(state_mutex);
+    return find_i2c(bus, addr);
+  };
+
+  while (pos < inLen && status == 0) {
+    switch (in[pos++]) {
+      case 0:  // End
+        pos = inLen;
+        break;
+      case 1:  // Escape
+        escape = true;
+        break;
+      case 2:  // Combined on / Start
+      case 3:  // Combined off / Stop
+        break;
+      case 4:  // Address
+        addr = param();
+        break;
+      case 5:  // Flags
+        param();
+        break;
+      case 6: {  // Read
+        unsigned len = param();
+        I2cDevice *dev = device();
+        wire_bytes += 1 + len;
+        if (count + len > outLen || !dev ||
+            !dev->read((uint8_t *) outBuf + count, len))
+          status = PI_I2C_READ_FAILED;
+        else
+          count += len;
+        break;
+      }
+      case 7: {  // Write
+        unsigned len = param();
+        I2cDevice *dev = device();
+        wire_bytes += 1 + len;
+        if (!dev || !dev->write(in + pos, len))
+          status = PI_I2C_WRITE_FAILED;
+        pos += len;
+        break;
+      }
+      default:
+        status = PI_BAD_HANDLE;
+        break;
+    }
+  }
+
+  charge_i2c(bus, wire_bytes);
+  return status < 0 ? status : count;
+}
+}  // anonymous namespace
+
+void attach_i2c(unsigned bus, unsigned addr, I2cDevice *dev) {
+  lock_guard<mutex> lock(state_mutex);
+  if (dev)
+    i2c_devices[make_pair(bus, addr)] = dev;
+  else
+    i2c_devices.erase(make_pair(bus, addr));
+}
+
+void attach_spi(unsigned channel, SpiDevice *dev) {
+  lock_guard<mutex> lock(state_mutex);
+  if (channel < 3)
+    spi_devices[channel] = dev;
+}
+
+void inject_edge(unsigned gpio, unsigned level, uint32_t tick) {
+  vector<Callback> matched;
+  {
+    lock_guard<mutex> lock(state_mutex);
+    if (level)
+      gpio_levels |= 1u << gpio;
+    else
+      gpio_levels &= ~(1u << gpio);
+
+    // A full pipe loses the report, like the daemon's
+    for (auto &n : notifies) {
+      Notify &notify = n.second;
+      if (!((notify.bits >> gpio) & 1))
+        continue;
+      gpioReport_t report = {notify.seqno++, 0, tick, gpio_levels};
+      if (write(notify.fd, &report, sizeof(report)) < 0) {}
+    }
+
+    for (const auto &cb : callbacks) {
+      unsigned edge = cb.second.edge;
+      if (cb.second.gpio == gpio && (edge == EITHER_EDGE ||
+          (edge == RISING_EDGE) == (level == PI_HIGH)))
+        matched.push_back(cb.second);
+    }
+  }
+
+  // Run without the lock, callbacks may call back into the daemon
+  for (const Callback &cb : matched) {
+    if (cb.f_ex)
+      cb.f_ex(0, gpio, level, tick, cb.userdata);
+    else
+      cb.f(0, gpio, level, tick);
+  }
+}
+
+const char *pipe_path_format() {
+  lock_guard<mutex> lock(state_mutex);
+  if (!pipe_format[0])
+    snprintf(pipe_format, sizeof(pipe_format), "/tmp/sim_pigpio_%d_%%d",
+        (int) getpid());
+  return pipe_format;
+}
+
+void set_tick_offset(uint32_t offset) {
+  lock_guard<mutex> lock(state_mutex);
+  tick_offset = offset;
+}
+
+uint32_t levels() {
+  lock_guard<mutex> lock(state_mutex);
+  return gpio_levels;
+}
+
+uint32_t tick() {
+  uint32_t offset;
+  {
+    lock_guard<mutex> lock(state_mutex);
+    offset = tick_offset;
+  }
+  auto us = chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t) us + offset;
+}
+
+void set_timing(const Timing &t) {
+  lock_guard<mutex> lock(state_mutex);
+  timing = t;
+}
+
+Counters counters() {
+  lock_guard<mutex> lock(state_mutex);
+  return count;
+}
+
+void reset_counters() {
+  lock_guard<mutex> lock(state_mutex);
+  count = Counters();
+}
+
+void wait_us(double us) {
+  if (us <= 0)
+    return;
+
+  // Default timer slack (50us) would swamp short round trips
+  static thread_local bool slack_set = false;
+  if (!slack_set) {
+    prctl(PR_SET_TIMERSLACK, 1);
+    slack_set = true;
+  }
+
+  this_thread::sleep_for(chrono::duration<double, micro>(us));
+}
+}  // namespace sim
+
+using namespace sim;
+
+// pigpiod_if2 API, as much of it as the driver modules use.
+
+double time_time(void) {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+void time_sleep(double seconds) {
+  if (seconds <= 0)
+    return;
+  struct timespec ts;
+  ts.tv_sec = (time_t) seconds;
+  ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+  while (nanosleep(&ts, &ts) == -1) {}
+}
+
+char *pigpio_error(int errnum) {
+  static char buf[32];
+  snprintf(buf, sizeof(buf), "sim error %d", errnum);
+  return buf;
+}
+
+pthread_t *start_thread(gpioThreadFunc_t thread_func, void *userdata) {
+  pthread_t *pth = new pthread_t;
+  if (pthread_create(pth, nullptr, thread_func, userdata)) {
+    delete pth;
+    return nullptr;
+  }
+  return pth;
+}
+
+void stop_thread(pthread_t *pth) {
+  if (pth) {
+    pthread_cancel(*pth);
+    pthread_join(*pth, nullptr);
+    delete pth;
+  }
+}
+
+int pigpio_start(const char *, const char *) {
+  lock_guard<mutex> lock(state_mutex);
+  return next_pi++;
+}
+
+void pigpio_stop(int) {}
+
+int set_mode(int, unsigned, unsigned) {
+  charge();
+  return 0;
+}
+
+int set_pull_up_down(int, unsigned, unsigned) {
+  charge();
+  return 0;
+}
+
+int set_glitch_filter(int, unsigned, unsigned) {
+  charge();
+  return 0;
+}
+
+int set_watchdog(int, unsigned, unsigned) {
+  charge();
+  return 0;
+}
+
+int gpio_read(int, unsigned gpio) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  return (gpio_levels >> gpio) & 1;
+}
+
+uint32_t read_bank_1(int) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  return gpio_levels;
+}
+
+int gpio_write(int, unsigned gpio, unsigned level) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  if (level)
+    gpio_levels |= 1u << gpio;
+  else
+    gpio_levels &= ~(1u << gpio);
+  return 0;
+}
+
+int set_bank_1(int, uint32_t bits) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  gpio_levels |= bits;
+  return 0;
+}
+
+int clear_bank_1(int, uint32_t bits) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  gpio_levels &= ~bits;
+  return 0;
+}
+
+// Scripts are limited to gpio writes ("w gpio level"), and run to completion
+// inside run_script
+int store_script(int, char *script) {
+  charge();
+  vector<unsigned> writes;
+  char cmd[8];
+  unsigned gpio, level;
+  int n;
+  for (const char *p = script; sscanf(p, " %7s %u %u%n", cmd, &gpio, &level,
+        &n) == 3; p += n) {
+    if (strcmp(cmd, "w") != 0 && strcmp(cmd, "W") != 0)
+      return PI_BAD_SCRIPT;
+    writes.push_back(gpio);
+    writes.push_back(level);
+  }
+
+  lock_guard<mutex> lock(state_mutex);
+  scripts.push_back(writes);
+  return scripts.size() - 1;
+}
+
+int script_status(int, unsigned script_id, uint32_t *) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  return script_id < scripts.size() ? PI_SCRIPT_HALTED : PI_BAD_SCRIPT_ID;
+}
+
+int run_script(int, unsigned script_id, unsigned, uint32_t *) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  if (script_id >= scripts.size())
+    return PI_BAD_SCRIPT_ID;
+  const vector<unsigned> &writes = scripts[script_id];
+  for (size_t i = 0; i < writes.size(); i += 2) {
+    if (writes[i + 1])
+      gpio_levels |= 1u << writes[i];
+    else
+      gpio_levels &= ~(1u << writes[i]);
+  }
+  return 0;
+}
+
+int delete_script(int, unsigned script_id) {
+  charge();
+  return 0;
+}
+
+// The pipe is a fifo at pipe_path_format(). The sim holds it open read-write,
+// so opening it doesn't block, and closing that is the reader's end of file.
+int notify_open(int) {
+  const char *format = pipe_path_format();
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  unsigned handle = next_notify++;
+  char path[80];
+  snprintf(path, sizeof(path), format, handle);
+  unlink(path);
+  if (mkfifo(path, 0600) != 0)
+    return PI_BAD_HANDLE;
+  int fd = open(path, O_RDWR | O_NONBLOCK);
+  if (fd < 0)
+    return PI_BAD_HANDLE;
+  notifies[handle] = {fd, 0, 0};
+  return handle;
+}
+
+int notify_begin(int, unsigned handle, uint32_t bits) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  auto it = notifies.find(handle);
+  if (it == notifies.end())
+    return PI_BAD_HANDLE;
+  it->second.bits = bits;
+  return 0;
+}
+
+int notify_pause(int pi, unsigned handle) {
+  return notify_begin(pi, handle, 0);
+}
+
+int notify_close(int, unsigned handle) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  auto it = notifies.find(handle);
+  if (it == notifies.end())
+    return PI_BAD_HANDLE;
+  close(it->second.fd);
+  notifies.erase(it);
+
+  char path[80];
+  snprintf(path, sizeof(path), pipe_format, handle);
+  unlink(path);
+  return 0;
+}
+
+uint32_t get_current_tick(int) {
+  charge();
+  return sim::tick();
+}
+
+int callback(int, unsigned user_gpio, unsigned edge, CBFunc_t f) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  callbacks[next_callback] = {user_gpio, edge, f, nullptr, nullptr};
+  return next_callback++;
+}
+
+int callback_ex(int, unsigned user_gpio, unsigned edge, CBFuncEx_t f,
+    void *userdata) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  callbacks[next_callback] = {user_gpio, edge, nullptr, f, userdata};
+  return next_callback++;
+}
+
+int callback_cancel(unsigned callback_id) {
+  lock_guard<mutex> lock(state_mutex);
+  return callbacks.erase(callback_id) ? 0 : pigif_callback_not_found;
+}
+
+int i2c_open(int, unsigned i2c_bus, unsigned i2c_addr, unsigned) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  i2c_handles.push_back({i2c_bus, i2c_addr, true});
+  return i2c_handles.size() - 1;
+}
+
+int i2c_close(int, unsigned handle) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  if (handle >= i2c_handles.size() || !i2c_handles[handle].open)
+    return PI_BAD_HANDLE;
+  i2c_handles[handle].open = false;
+  return 0;
+}
+
+int i2c_write_byte_data(int, unsigned handle, unsigned i2c_reg,
+    unsigned bVal) {
+  unsigned bus, addr;
+  {
+    lock_guard<mutex> lock(state_mutex);
+    if (handle >= i2c_handles.size() || !i2c_handles[handle].open)
+      return PI_BAD_HANDLE;
+    bus = i2c_handles[handle].bus;
+    addr = i2c_handles[handle].addr;
+  }
+
+  const char cmd[] = {0x7, 0x2, (char) i2c_reg, (char) bVal, 0x0};
+  int ret = zip(bus, addr, cmd, sizeof(cmd), nullptr, 0);
+  return ret < 0 ? ret : 0;
+}
+
+int i2c_zip(int, unsigned handle, char *inBuf, unsigned inLen, char *outBuf,
+    unsigned outLen) {
+  unsigned bus, addr;
+  {
+    lock_guard<mutex> lock(state_mutex);
+    if (handle >= i2c_handles.size() || !i2c_handles[handle].open)
+      return PI_BAD_HANDLE;
+    bus = i2c_handles[handle].bus;
+    addr = i2c_handles[handle].addr;
+  }
+
+  return zip(bus, addr, inBuf, inLen, outBuf, outLen);
+}
+
+int bb_i2c_open(int, unsigned SDA, unsigned, unsigned baud) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  get_bus(kBitBangedBus + SDA).hz = baud;
+  return 0;
+}
+
+int bb_i2c_close(int, unsigned) {
+  charge();
+  return 0;
+}
+
+int bb_i2c_zip(int, unsigned SDA, char *inBuf, unsigned inLen, char *outBuf,
+    unsigned outLen) {
+  // The address comes from the command sequence
+  return zip(kBitBangedBus + SDA, 0, inBuf, inLen, outBuf, outLen);
+}
+
+int spi_open(int, unsigned spi_channel, unsigned baud, unsigned) {
+  charge();
+  if (spi_channel >= 3 || baud == 0)
+    return PI_BAD_SPI_CHANNEL;
+  lock_guard<mutex> lock(state_mutex);
+  spi_handles.push_back({spi_channel, baud, true});
+  return spi_handles.size() - 1;
+}
+
+int spi_close(int, unsigned handle) {
+  charge();
+  lock_guard<mutex> lock(state_mutex);
+  if (handle >= spi_handles.size() || !spi_handles[handle].open)
+    return PI_BAD_HANDLE;
+  spi_handles[handle].open = false;
+  return 0;
+}
+
+int spi_write(int pi, unsigned handle, char *buf, unsigned count) {
+  vector<char> rx(count);
+  return spi_xfer(pi, handle, buf, rx.data(), count);
+}
+
+int spi_xfer(int, unsigned handle, char *txBuf, char *rxBuf, unsigned count) {
+  charge();
+
+  SpiDevice *dev;
+  double us;
+  {
+    lock_guard<mutex> lock(state_mutex);
+    if (handle >= spi_handles.size() || !spi_handles[handle].open)
+      return PI_BAD_HANDLE;
+    dev = spi_devices[spi_handles[handle].channel];
+    us = count * 8 * 1e6 / spi_handles[handle].baud;
+    ++sim::count.spi_transfers;
+  }
+
+  lock_guard<mutex> wire_lock(spi_wire);
+  if (rxBuf != txBuf)
+    memcpy(rxBuf, txBuf, count);
+  if (dev)
+    dev->xfer((uint8_t *) rxBuf, count);
+  else
+    memset(rxBuf, 0xFF, count);  // Nothing drives MISO, it floats high
+  wait_us(us);
+  return count;
+}
@@ -0,0 +1,81 @@
+#ifndef SIM_PIGPIO_H_
+#define SIM_PIGPIO_H_
+
+#include <cstdint>
+
+// In-process stand-in for the pigpio daemon interface (libpigpiod_if2).
+// Link sim_pigpio.o in place of -lpigpiod_if2 to run the driver modules
+// against simulated devices, e.g. for benchmarks on a machine without a Pi.
+namespace sim {
+// A simulated I2C slave. Each call is one segment of a transaction, i.e. the
+// bytes between a (repeated) start and the next start or stop.
+// Return false to NAK the segment.
+class I2cDevice {
+ public:
+  virtual ~I2cDevice() {}
+  virtual bool write(const uint8_t *buf, unsigned len) = 0;
+  virtual bool read(uint8_t *buf, unsigned len) = 0;
+};
+
+// Attaches dev at addr on bus, replacing whatever was there. nullptr detaches.
+// Does not take ownership.
+// Bit-banged buses are numbered kBitBangedBus + their SDA gpio.
+const unsigned kBitBangedBus = 100;
+void attach_i2c(unsigned bus, unsigned addr, I2cDevice *dev);
+
+// A simulated SPI slave. Each call is one transfer with its chip select held,
+// buf holds the bytes clocked out and receives the bytes clocked in.
+class SpiDevice {
+ public:
+  virtual ~SpiDevice() {}
+  virtual void xfer(uint8_t *buf, unsigned len) = 0;
+};
+
+// Attaches dev to a chip select of the main SPI bus. nullptr detaches.
+// Does not take ownership.
+void attach_spi(unsigned channel, SpiDevice *dev);
+
+// Sets gpio's level, as an edge at tick: delivers it to the callbacks
+// registered on the gpio (on the calling thread, in place of the daemon's
+// callback thread) and reports it down the notification pipes watching it.
+void inject_edge(unsigned gpio, unsigned level, uint32_t tick);
+
+// Levels of the gpios, as written through the daemon (gpio_write, bank writes
+// and scripts) or injected, a bit per gpio
+uint32_t levels();
+
+// Path format (with a %d for the handle) of notification pipes. The daemon's
+// are /dev/pigpioN, see gpio_capture::set_pipe_format.
+const char *pipe_path_format();
+
+// Offset added to get_current_tick, e.g. to run across its 32-bit wrap
+void set_tick_offset(uint32_t offset);
+// The tick get_current_tick returns, without charging a round trip
+uint32_t tick();
+
+// Costs charged to each simulated daemon call. The caller blocks for them, the
+// way it would wait on the socket for a round trip and bus transfer.
+// Round trips of different callers overlap, while each I2C bus carries one
+// transfer at a time.
+struct Timing {
+  double round_trip_us = 0;   // Socket round trip to pigpiod
+  unsigned i2c_hz = 100000;   // Hardware bus clock, 9 clocks per byte incl ACK
+};                            // (bit-banged buses run at their open baud)
+                              // SPI runs at its open baud
+void set_timing(const Timing &timing);
+
+// Counts of simulated daemon activity since the last reset
+struct Counters {
+  unsigned long calls = 0;              // Every daemon round trip
+  unsigned long i2c_transactions = 0;   // Calls that touched an I2C bus
+  unsigned long i2c_bytes = 0;          // Bytes on the wire incl. addresses
+  unsigned long spi_transfers = 0;      // spi_xfer calls
+};
+Counters counters();
+void reset_counters();
+
+// Blocks the calling thread for us microseconds
+void wait_us(double us);
+}  // namespace sim
+
+#endif  // SIM_PIGPIO_H_
@@ -0,0 +1,94 @@
+#include "stats.h"
+
+#include <cstring>
+#include <mutex>
+
+using namespace std;
+
+namespace stats {
+namespace {
+struct Entry {
+  const char *name;
+  Histogram hist;
+};
+
+// Fixed memory, entries are never removed
+Entry entries[kMaxHistograms];
+Histogram overflow;
+atomic<unsigned> num_entries(0);
+mutex registry_mutex;  // GUARDS adding entries
+
+// Counter and clock at startup, ns_per_tick() is their rate since
+const uint64_t start_ticks = ticks();
+const uint64_t start_ns = now_ns();
+}  // anonymous namespace
+
+double ns_per_tick() {
+  uint64_t ns = now_ns() - start_ns, elapsed = ticks() - start_ticks;
+  return elapsed ? (double) ns / elapsed : 1;
+}
+
+uint64_t bucket_floor(unsigned bucket) {
+  if (bucket < kSubBuckets)
+    return bucket;
+  unsigned shift = bucket / kSubBuckets - 1;
+  return (uint64_t) (kSubBuckets + bucket % kSubBuckets) << shift;
+}
+
+uint64_t Histogram::count() const {
+  uint64_t total = 0;
+  for (const auto &count : counts_)
+    total += count.load(memory_order_relaxed);
+  return total;
+}
+
+uint64_t Histogram::quantile(double q) const {
+  uint64_t total = count();
+  if (total == 0)
+    return 0;
+
+  uint64_t target = (uint64_t) (q * (total - 1)) + 1, seen = 0;
+  for (unsigned b = 0; b < kNumBuckets; ++b) {
+    seen += counts_[b].load(memory_order_relaxed);
+    if (seen >= target)
+      return bucket_floor(b);
+  }
+  return max();
+}
+
+void Histogram::reset() {
+  for (auto &count : counts_)
+    count.store(0, memory_order_relaxed);
+  max_.store(0, memory_order_relaxed);
+}
+
+Histogram &histogram(const char *name) {
+  lock_guard<mutex> lock(registry_mutex);
+  unsigned n = num_entries;
+  for (unsigned i = 0; i < n; ++i)
+    if (strcmp(entries[i].name, name) == 0)
+      return entries[i].hist;
+
+  if (n == kMaxHistograms)
+    return overflow;
+  entries[n].name = name;
+  num_entries = n + 1;
+  return entries[n].hist;
+}
+
+void report(FILE *out, bool reset) {
+  unsigned n = num_entries;
+  double us_per_tick = ns_per_tick() / 1e3;
+  fprintf(out, "%-20s %10s %10s %10s %10s\n", "latency (us)", "count", "p50",
+      "p99", "max");
+  for (unsigned i = 0; i < n; ++i) {
+    Histogram &hist = entries[i].hist;
+    fprintf(out, "%-20s %10llu %10.1f %10.1f %10.1f\n", entries[i].name,
+        (unsigned long long) hist.count(), hist.quantile(0.5) * us_per_tick,
+        hist.quantile(0.99) * us_per_tick, hist.max() * us_per_tick);
+    if (reset)
+      hist.reset();
+  }
+  fflush(out);
+}
+}  // namespace stats
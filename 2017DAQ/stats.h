@@ -0,0 +1,123 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Latency instrumentation. STATS_SCOPE("name") times the rest of its scope
+// into a named histogram. Scopes only compile in when DAQ_STATS is defined
+// (make STATS=1), otherwise they cost nothing.
+//
+// Histograms are log-linear (HDR style): 16 linear sub-buckets per power of
+// two, so any value is recorded within 1/16 (~6%) of itself, in fixed memory.
+//
+// Scopes time in ticks of the CPU's counter, which reads in a fraction of
+// clock_gettime's time, and report() scales them to ns.
+namespace stats {
+const unsigned kSubBucketBits = 4;
+const unsigned kSubBuckets = 1 << kSubBucketBits;
+const unsigned kMaxExponent = 40;  // Up to ~18 minutes in ns
+const unsigned kNumBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+const unsigned kMaxHistograms = 32;
+
+inline uint64_t now_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Counter user space can read directly, now_ns() on CPUs without one (ARMv6,
+// as Raspbian builds, and ARMv7 cores that may lack the generic timer)
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t t;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#elif defined(__arm__) && __ARM_ARCH >= 8
+  uint32_t lo, hi;
+  __asm__ __volatile__("mrrc p15, 1, %0, %1, c14" : "=r"(lo), "=r"(hi));
+  return (uint64_t) hi << 32 | lo;
+#else
+  return now_ns();
+#endif
+}
+
+// ns per tick, measured between startup and now
+double ns_per_tick();
+
+// Bucket of a value, values past the top land in the last bucket
+inline unsigned bucket(uint64_t value) {
+  if (value < kSubBuckets)
+    return value;
+  unsigned msb = 63 - __builtin_clzll(value);
+  if (msb > kMaxExponent)
+    return kNumBuckets - 1;
+  unsigned shift = msb - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+}
+
+// Smallest value of a bucket
+uint64_t bucket_floor(unsigned bucket);
+
+// Thread safe, recording is a relaxed atomic add (plus a compare for max)
+class Histogram {
+ public:
+  void record(uint64_t value) {
+    counts_[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value,
+          std::memory_order_relaxed)) {}
+  }
+
+  uint64_t count() const;
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  // Value at quantile q (0-1), the floor of the bucket it's in
+  uint64_t quantile(double q) const;
+  void reset();
+
+ private:
+  std::atomic<uint32_t> counts_[kNumBuckets] = {};
+  std::atomic<uint64_t> max_{0};
+};
+
+// Histogram registered under name, created on first use. Past
+// kMaxHistograms, names share an overflow histogram.
+Histogram &histogram(const char *name);
+
+// Prints count, p50, p99 and max (in us, from ticks) of every histogram to
+// out, then resets them if reset is set
+void report(FILE *out, bool reset = true);
+
+// Records the ticks from construction to destruction
+class Scope {
+ public:
+  explicit Scope(Histogram &hist) : hist_(hist), start_(ticks()) {}
+  ~Scope() { hist_.record(ticks() - start_); }
+
+ private:
+  Histogram &hist_;
+  const uint64_t start_;
+};
+}  // namespace stats
+
+#define STATS_CAT_(a, b) a##b
+#define STATS_CAT(a, b) STATS_CAT_(a, b)
+
+#ifdef DAQ_STATS
+#define STATS_SCOPE(name) \
+  static stats::Histogram &STATS_CAT(stats_hist_, __LINE__) = \
+    stats::histogram(name); \
+  stats::Scope STATS_CAT(stats_scope_, __LINE__)( \
+      STATS_CAT(stats_hist_, __LINE__))
+#else
+#define STATS_SCOPE(name) do {} while (0)
+#endif  // DAQ_STATS
+
+#endif  // STATS_H_
@@ -0,0 +1,78 @@
+// Scopes are always on here, whatever the build's STATS setting
+#define DAQ_STATS
+#include "stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const char *usage = "Usage: %s [iterations]\n";
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    printf(usage, *argv);
+    return -1;
+  }
+  int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  // Quantiles must land within a sub-bucket (1/16) of the exact value
+  stats::Histogram hist;
+  vector<uint64_t> values;
+  mt19937_64 rng(1);
+  lognormal_distribution<double> latency(10, 1.5);  // ~22us median, long tail
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t v = (uint64_t) latency(rng);
+    values.push_back(v);
+    hist.record(v);
+  }
+  sort(values.begin(), values.end());
+
+  bool ok = hist.max() == values.back();
+  for (double q : {0.5, 0.9, 0.99, 0.999}) {
+    uint64_t exact = values[(size_t) (q * (values.size() - 1))];
+    uint64_t got = hist.quantile(q);
+    double err = fabs((double) got - exact) / exact;
+    printf("q%-6g exact %10llu ns  histogram %10llu ns  error %5.2f%%\n", q,
+        (unsigned long long) exact, (unsigned long long) got, err * 100);
+    ok = ok && err <= 1.0 / stats::kSubBuckets;
+  }
+  printf("%lu bytes per histogram\n", (unsigned long) sizeof(hist));
+
+  // Cost of a scope, less the loop it sits in
+  uint64_t start = stats::now_ns();
+  for (int i = 0; i < iterations; ++i) {
+    STATS_SCOPE("bench.scope");
+    __asm__ __volatile__("" ::: "memory");
+  }
+  uint64_t scoped = stats::now_ns() - start;
+
+  start = stats::now_ns();
+  for (int i = 0; i < iterations; ++i)
+    __asm__ __volatile__("" ::: "memory");
+  uint64_t bare = stats::now_ns() - start;
+
+  printf("STATS_SCOPE overhead: %.1f ns\n",
+      (double) (scoped - bare) / iterations);
+
+  // Scopes count ticks, which must scale back to the clock's ns
+  stats::Histogram slept;
+  {
+    stats::Scope scope(slept);
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+  double slept_ms = slept.max() * stats::ns_per_tick() / 1e6;
+  printf("10 ms sleep scoped as %.3f ms (%.4f ns per tick)\n", slept_ms,
+      stats::ns_per_tick());
+  ok = ok && slept_ms >= 10 && slept_ms < 20;
+  stats::report(stdout);
+
+  printf(ok ? "ok\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <cstdio>
+
+// Test harness. Each check prints a line, what it checked and ok or FAILED,
+// and counts failures. A test ends with return test::result(), so it exits
+// non-zero on any failure, NDEBUG or not.
+namespace test {
+inline int &failures() {
+  static int failures = 0;
+  return failures;
+}
+
+inline bool check(const char *what, bool ok) {
+  printf("%-52s %s\n", what, ok ? "ok" : "FAILED");
+  failures() += !ok;
+  return ok;
+}
+
+inline int result() {
+  return failures() ? 1 : 0;
+}
+}  // namespace test
+
+#endif  // TEST_H_
@@ -0,0 +1,54 @@
+#include "timebase.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+namespace timebase {
+namespace {
+// Round trips tried for an anchor, scheduling can stretch any one of them
+const int kAnchorTries = 5;
+
+int64_t realtime_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+}  // anonymous namespace
+
+Anchor anchor(int pi, uint32_t (*read_tick)(int pi)) {
+  Anchor best = {0, 0, 0, UINT32_MAX};
+  for (int i = 0; i < kAnchorTries; ++i) {
+    uint64_t before = now_ns();
+    int64_t wall = realtime_ns();
+    uint32_t tick = read_tick(pi);
+    uint64_t after = now_ns();
+
+    uint64_t error = (after - before) / 2;
+    if (error < best.error_ns)
+      best = {wall + (int64_t) error, before + error, tick, (uint32_t) error};
+  }
+  return best;
+}
+
+bool write_csv(const char *filename, const Anchor &a) {
+  FILE *file = fopen(filename, "w");
+  if (!file)
+    return false;
+
+  fprintf(file, "Wall Time (ns),Monotonic Time (ns),Tick (us),Error (ns)\n"
+      "%" PRId64 ",%" PRIu64 ",%" PRIu32 ",%" PRIu32 "\n", a.wall_ns,
+      a.mono_ns, a.tick, a.error_ns);
+  return fclose(file) == 0;
+}
+
+bool read_csv(const char *filename, Anchor &a) {
+  FILE *file = fopen(filename, "r");
+  if (!file)
+    return false;
+
+  bool ok = fscanf(file, "%*[^\n]\n%" SCNd64 ",%" SCNu64 ",%" SCNu32 ",%" SCNu32,
+      &a.wall_ns, &a.mono_ns, &a.tick, &a.error_ns) == 4;
+  fclose(file);
+  return ok;
+}
+}  // namespace timebase
@@ -0,0 +1,67 @@
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <cstdint>
+#include <ctime>
+
+// Session time base. Samples are stamped with CLOCK_MONOTONIC_RAW, which
+// never jumps or slews under NTP the way the wall clock does. Gpio edges are
+// stamped by the daemon with its 32-bit 1us tick. An Anchor reads all three
+// clocks together once per session, which puts the tick on the monotonic
+// time axis and ties that axis to wall time.
+namespace timebase {
+inline uint64_t now_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// The same instant on each clock
+struct Anchor {
+  int64_t wall_ns;    // CLOCK_REALTIME, ns since the epoch, 0 if unknown
+  uint64_t mono_ns;   // CLOCK_MONOTONIC_RAW
+  uint32_t tick;      // Daemon tick
+  uint32_t error_ns;  // Half the round trip the tick was read in
+};
+
+// Reads the tick with read_tick(pi) (get_current_tick, so post processing
+// doesn't need the daemon library), keeping the fastest of a few round trips
+Anchor anchor(int pi, uint32_t (*read_tick)(int pi));
+
+// Wall time of a monotonic time
+inline int64_t wall_ns(const Anchor &a, uint64_t mono_ns) {
+  return a.wall_ns + (int64_t) (mono_ns - a.mono_ns);
+}
+
+// Extends the tick, which wraps every ~71.6 minutes, to a signed 64-bit count
+// of us since a reference tick. Successive ticks must be less than 2^31us
+// (~35.8 minutes) apart, either way. Not thread safe.
+class TickUnwrapper {
+ public:
+  explicit TickUnwrapper(uint32_t reference) : last_(reference) {}
+
+  int64_t unwrap(uint32_t tick) {
+    elapsed_ += (int32_t) (tick - last_);
+    last_ = tick;
+    return elapsed_;
+  }
+
+ private:
+  uint32_t last_;
+  int64_t elapsed_ = 0;
+};
+
+// Monotonic time of a tick, through an anchor. The tick and the monotonic
+// clock run off different oscillators, so this drifts by their difference
+// (parts per million) with distance from the anchor.
+inline uint64_t tick_to_mono_ns(const Anchor &a, int64_t us_since_anchor) {
+  return a.mono_ns + us_since_anchor * 1000;
+}
+
+// Writes an anchor to a one row CSV, returns false if it couldn't be written
+bool write_csv(const char *filename, const Anchor &a);
+// Reads one back, false if it couldn't be read
+bool read_csv(const char *filename, Anchor &a);
+}  // namespace timebase
+
+#endif  // TIMEBASE_H_
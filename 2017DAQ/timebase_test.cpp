@@ -0,0 +1,58 @@
+#include "timebase.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <pigpiod_if2.h>
+
+#include "sim_pigpio.h"
+#include "test.h"
+
+// Runs against sim_pigpio, whose tick follows the steady clock
+const int64_t kToleranceNs = 2000000;
+
+int64_t realtime_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  // Ticks fed directly, across the wrap and back
+  {
+    timebase::TickUnwrapper ticks(0xFFFFFF00);
+    test::check("Reference unwraps to 0", ticks.unwrap(0xFFFFFF00) == 0);
+    test::check("Forward across the wrap", ticks.unwrap(0x100) == 0x200);
+    test::check("Back across the wrap", ticks.unwrap(0xFFFFFE00) == -0x100);
+
+    // A session hours long, a tick every ~30 minutes
+    const uint32_t kStep = 1800000000;
+    uint32_t tick = 0xFFFFFF00;
+    bool ok = true;
+    timebase::TickUnwrapper session(tick);
+    for (int i = 0; i < 10; ++i)
+      ok = ok && session.unwrap(tick += kStep) == (int64_t) kStep * (i + 1);
+    test::check("Five hours of ticks, wrapping four times", ok);
+  }
+
+  // Anchored through the simulated daemon, a second before the wrap
+  sim::set_tick_offset(-sim::tick() - 1000000);
+  int pi = pigpio_start(nullptr, nullptr);
+  timebase::Anchor start = timebase::anchor(pi, get_current_tick);
+  printf("  anchored to +-%uns\n", start.error_ns);
+  test::check("Wall time of the anchor",
+      llabs(timebase::wall_ns(start, timebase::now_ns()) - realtime_ns()) <
+      kToleranceNs);
+
+  time_sleep(1.5);
+  timebase::TickUnwrapper ticks(start.tick);
+  uint64_t mono = timebase::now_ns();
+  int64_t us = ticks.unwrap(get_current_tick(pi));
+  int64_t error = (int64_t) (timebase::tick_to_mono_ns(start, us) - mono);
+  printf("  tick after the wrap maps %+.1fus off\n", error / 1e3);
+  test::check("Tick after the wrap on the monotonic clock",
+      us > 1000000 && llabs(error) < kToleranceNs);
+
+  pigpio_stop(pi);
+  return test::result();
+}
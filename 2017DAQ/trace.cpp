@@ -0,0 +1,115 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace trace {
+namespace {
+struct Span {
+  uint64_t start_ns;
+  uint64_t end_ns;
+  const char *name;
+};
+
+struct Ring {
+  atomic<uint64_t> head{0};  // Spans ever recorded, the next one's slot
+  atomic<const char *> name{nullptr};
+  long tid = syscall(SYS_gettid);
+  Span spans[kRingSize];
+};
+
+// Rings are claimed by index, and published once built. They're never freed,
+// since a dump can come after their thread exits.
+atomic<Ring *> rings[kMaxThreads];
+atomic<unsigned> num_claimed{0};
+thread_local Ring *ring = nullptr;
+thread_local bool untraced = false;  // Came after kMaxThreads
+
+// The calling thread's ring, built on first use (the only allocation)
+Ring *this_ring() {
+  if (ring || untraced)
+    return ring;
+
+  unsigned i = num_claimed.fetch_add(1);
+  if (i >= kMaxThreads) {
+    untraced = true;
+    fprintf(stderr, "\n[%s:%d] Error: More than %u threads traced\n",
+        __FILE__, __LINE__, kMaxThreads);
+    return nullptr;
+  }
+  ring = new Ring();
+  rings[i].store(ring, memory_order_release);
+  return ring;
+}
+
+void write_span(FILE *out, bool &first, long tid, const Span &span) {
+  fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%ld,"
+      "\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",", span.name, tid,
+      span.start_ns / 1e3, (span.end_ns - span.start_ns) / 1e3);
+  first = false;
+}
+}  // anonymous namespace
+
+void record(const char *name, uint64_t start_ns, uint64_t end_ns) {
+  Ring *r = this_ring();
+  if (!r)
+    return;
+
+  uint64_t head = r->head.load(memory_order_relaxed);
+  r->spans[head & (kRingSize - 1)] = {start_ns, end_ns, name};
+  r->head.store(head + 1, memory_order_release);
+}
+
+void set_thread_name(const char *name) {
+  if (Ring *r = this_ring())
+    r->name = name;
+}
+
+long dump(const char *filename) {
+  FILE *out = fopen(filename, "w");
+  if (!out)
+    return -1;
+
+  // Copied out first, so a live ring can only overwrite the copy's oldest
+  unique_ptr<Span[]> copy(new Span[kRingSize]);
+  long written = 0;
+  bool first = true;
+
+  fprintf(out, "{\"traceEvents\":[");
+  unsigned num_rings = min(num_claimed.load(), kMaxThreads);
+  for (unsigned i = 0; i < num_rings; ++i) {
+    const Ring *r = rings[i].load(memory_order_acquire);
+    if (!r)
+      continue;  // Claimed, not yet built
+
+    const char *name = r->name;
+    fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+        "\"tid\":%ld,\"args\":{\"name\":\"%s\"}}", first ? "" : ",", r->tid,
+        name ? name : "unnamed");
+    first = false;
+
+    uint64_t head = r->head.load(memory_order_acquire);
+    uint64_t begin = head > kRingSize ? head - kRingSize : 0;
+    for (uint64_t s = begin; s < head; ++s)
+      copy[s - begin] = r->spans[s & (kRingSize - 1)];
+
+    // Slots the writer reached while copying (and the one it may be
+    // writing) hold newer spans, or torn ones
+    uint64_t now_head = r->head.load(memory_order_acquire);
+    uint64_t valid = now_head + 1 > kRingSize ? now_head + 1 - kRingSize : 0;
+    for (uint64_t s = max(begin, valid); s < head; ++s, ++written)
+      write_span(out, first, r->tid, copy[s - begin]);
+  }
+  fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+  if (fclose(out) != 0)
+    return -1;
+  return written;
+}
+}  // namespace trace
@@ -0,0 +1,53 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <cstdint>
+
+#include "stats.h"
+
+// Timeline tracing. TRACE_SCOPE("name") records the span of the rest of its
+// scope onto the calling thread's ring, and dump() writes every ring out as
+// Chrome trace-event JSON (open it in Perfetto or chrome://tracing). Like
+// STATS_SCOPE, scopes only compile in when DAQ_TRACE is defined (make
+// TRACE=1).
+//
+// Each thread gets its own ring, which only that thread writes, so recording
+// is lock-free: two clock reads, a store and a release. Rings keep the last
+// kRingSize spans per thread, the oldest are overwritten (and dumps leave out
+// a full ring's oldest, it may be mid-write).
+namespace trace {
+const unsigned kRingSize = 1 << 16;  // Spans per thread, a power of two
+const unsigned kMaxThreads = 16;     // Later threads aren't traced
+
+// Records a span on the calling thread's ring
+void record(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+// Names the calling thread in the trace, name must outlive the trace
+void set_thread_name(const char *name);
+
+// Writes the rings as Chrome trace-event JSON, returns the number of spans
+// written, or -1 if filename couldn't be opened. Rings keep recording while
+// this runs, spans overwritten mid-dump are left out.
+long dump(const char *filename);
+
+class Scope {
+ public:
+  explicit Scope(const char *name) : name_(name), start_(stats::now_ns()) {}
+  ~Scope() { record(name_, start_, stats::now_ns()); }
+
+ private:
+  const char *name_;
+  const uint64_t start_;
+};
+}  // namespace trace
+
+#ifdef DAQ_TRACE
+#define TRACE_SCOPE(name) \
+  trace::Scope STATS_CAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD(name) trace::set_thread_name(name)
+#else
+#define TRACE_SCOPE(name) do {} while (0)
+#define TRACE_THREAD(name) do {} while (0)
+#endif  // DAQ_TRACE
+
+#endif  // TRACE_H_
@@ -0,0 +1,74 @@
+// Scopes are always on here, whatever the build's TRACE setting
+#define DAQ_TRACE
+#include "trace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+const char *kTraceFile = "trace_test.json";
+
+// Records from several threads (one wrapping its ring, one live during the
+// dump), then checks what the dump holds. Doesn't need the daemon.
+int main(int argc, char **argv) {
+  TRACE_THREAD("main");
+
+  thread wrapping([]() {
+      TRACE_THREAD("wrapping");
+      for (unsigned i = 0; i < 2 * trace::kRingSize; ++i) {
+        TRACE_SCOPE("wrapped");
+      }
+    });
+  thread nested([]() {
+      TRACE_THREAD("nested");
+      for (int i = 0; i < 100; ++i) {
+        TRACE_SCOPE("outer");
+        TRACE_SCOPE("inner");
+      }
+    });
+  wrapping.join();
+  nested.join();
+
+  // Keeps recording through the dump
+  atomic<bool> running{true};
+  atomic<long> live_spans{0};
+  thread live([&]() {
+      TRACE_THREAD("live");
+      while (running) {
+        TRACE_SCOPE("live");
+        ++live_spans;
+      }
+    });
+  while (live_spans < 1000) {}
+
+  uint64_t start = stats::now_ns();
+  long written = trace::dump(kTraceFile);
+  double dump_ms = (stats::now_ns() - start) / 1e6;
+  running = false;
+  live.join();
+
+  // One span per line
+  ifstream in(kTraceFile);
+  string line;
+  long spans = 0, wrapped = 0, names = 0;
+  while (getline(in, line)) {
+    spans += line.find("\"ph\":\"X\"") != string::npos;
+    wrapped += line.find("\"name\":\"wrapped\"") != string::npos;
+    names += line.find("\"thread_name\"") != string::npos;
+  }
+
+  // A full ring's oldest slot could be mid-write, so dumps leave it out
+  long fixed = trace::kRingSize - 1 + 200;
+  printf("Dumped %ld spans (%ld live) from %ld threads in %.1f ms\n", written,
+      written - fixed, names, dump_ms);
+
+  bool ok = written == spans && wrapped == trace::kRingSize - 1 &&
+    written > fixed && written <= fixed + trace::kRingSize && names == 4;
+  printf(ok ? "ok\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
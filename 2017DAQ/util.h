@@ -2,6 +2,7 @@
 #define UTIL_H_
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <pigpiod_if2.h>
@@ -59,6 +60,42 @@ inline uint8_t crc8(uint64_t data) {
   // Remainder is MSB of data
   return data >> 56;
 }
+
+namespace internal {
+// One bit of MSB CRC-8 (poly 0x07) long division.
+constexpr uint8_t crc8_shift(uint8_t crc) {
+  return (crc & 0x80) ? (uint8_t) ((crc << 1) ^ 0x07) : (uint8_t) (crc << 1);
+}
+
+// Remainder of a single byte, i.e. 8 shifts (C++11 constexpr needs recursion).
+constexpr uint8_t crc8_entry(uint8_t crc, int bits = 8) {
+  return bits == 0 ? crc : crc8_entry(crc8_shift(crc), bits - 1);
+}
+}  // namespace internal
+
+// Byte-wise remainder table for MSB CRC-8 with polynomial 0x07, generated at
+// compile time.
+#define UTIL_CRC8_T4(i) internal::crc8_entry(i), internal::crc8_entry(i + 1),\
+    internal::crc8_entry(i + 2), internal::crc8_entry(i + 3)
+#define UTIL_CRC8_T16(i) UTIL_CRC8_T4(i), UTIL_CRC8_T4(i + 4),\
+    UTIL_CRC8_T4(i + 8), UTIL_CRC8_T4(i + 12)
+#define UTIL_CRC8_T64(i) UTIL_CRC8_T16(i), UTIL_CRC8_T16(i + 16),\
+    UTIL_CRC8_T16(i + 32), UTIL_CRC8_T16(i + 48)
+constexpr uint8_t kCrc8Table[256] = {
+  UTIL_CRC8_T64(0), UTIL_CRC8_T64(64), UTIL_CRC8_T64(128), UTIL_CRC8_T64(192),
+};
+#undef UTIL_CRC8_T64
+#undef UTIL_CRC8_T16
+#undef UTIL_CRC8_T4
+
+// Preforms MSB CRC-8 with polynomial 0x07 over len bytes, one table lookup per
+// byte. Pass the result of a previous call as crc to continue a running
+// checksum across buffers.
+inline uint8_t crc8(const uint8_t *bytes, size_t len, uint8_t crc = 0) {
+  for (size_t i = 0; i < len; ++i)
+    crc = kCrc8Table[crc ^ bytes[i]];
+  return crc;
+}
 }  // namespace util
 
 #endif  // UTIL_H_